@@ -0,0 +1,191 @@
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+#include "animation.h"
+
+
+static void animation_clear(animation_t *animation) {
+    frame_buffer_t *frames = animation->frames;
+
+    ws2812_pixel_t *pixels = frame_buffer_begin(frames, false);
+    memset(pixels, 0, frames->count * sizeof(ws2812_pixel_t));
+    frame_buffer_show(frames);
+}
+
+// Program or overlay to draw, NULL if there is nothing to draw
+static const animation_program_t *animation_current(animation_t *animation) {
+    if (animation->overlay)
+        return animation->overlay;
+
+    if (animation->state == ANIMATION_RUNNING)
+        return animation->program;
+
+    return NULL;
+}
+
+static void animation_handle(animation_t *animation, const animation_command_t *command) {
+    TickType_t now = xTaskGetTickCount();
+
+    switch (command->type) {
+        case ANIMATION_COMMAND_START:
+            if (animation->state == ANIMATION_RUNNING)
+                return;
+
+            animation->state = ANIMATION_RUNNING;
+            animation->frame = 0;
+            break;
+
+        case ANIMATION_COMMAND_STOP:
+            animation->state = ANIMATION_STOPPED;
+            if (!animation->overlay)
+                animation_clear(animation);
+            return;
+
+        case ANIMATION_COMMAND_PAUSE:
+            if (animation->state == ANIMATION_RUNNING)
+                animation->state = ANIMATION_PAUSED;
+            return;
+
+        case ANIMATION_COMMAND_RESUME:
+            if (animation->state != ANIMATION_PAUSED)
+                return;
+
+            animation->state = ANIMATION_RUNNING;
+            break;
+
+        case ANIMATION_COMMAND_PREEMPT:
+            animation->overlay = command->overlay;
+            animation->overlay_frame = 0;
+            break;
+    }
+
+    // first frame of what changed is drawn right away
+    animation->next_frame_time = now;
+}
+
+static void animation_draw(animation_t *animation, const animation_program_t *program) {
+    bool overlay = (program == animation->overlay);
+    uint32_t *frame = overlay ? &animation->overlay_frame : &animation->frame;
+
+    ws2812_pixel_t *pixels = frame_buffer_begin(animation->frames, false);
+    bool more = program->render(pixels, (*frame)++, program->context);
+    frame_buffer_show(animation->frames);
+
+    TickType_t now = xTaskGetTickCount();
+    TickType_t frame_ticks = program->frame_ms / portTICK_PERIOD_MS;
+    if (!frame_ticks)
+        frame_ticks = 1;
+
+    animation->next_frame_time += frame_ticks;
+    // a late frame moves the schedule instead of being caught up with
+    if ((int32_t)(animation->next_frame_time - now) < 0)
+        animation->next_frame_time = now;
+
+    if (overlay && !more) {
+        animation->overlay = NULL;
+
+        // give the output back in the state the program left it in
+        switch (animation->state) {
+            case ANIMATION_STOPPED:
+                animation_clear(animation);
+                break;
+            case ANIMATION_PAUSED:
+                pixels = frame_buffer_begin(animation->frames, false);
+                animation->program->render(pixels, animation->frame, animation->program->context);
+                frame_buffer_show(animation->frames);
+                break;
+            case ANIMATION_RUNNING:
+                animation->next_frame_time = now;
+                break;
+        }
+    }
+}
+
+static void animation_task(void *_args) {
+    animation_t *animation = _args;
+
+    while (1) {
+        const animation_program_t *program = animation_current(animation);
+
+        TickType_t timeout = portMAX_DELAY;
+        if (program) {
+            int32_t ticks = animation->next_frame_time - xTaskGetTickCount();
+            timeout = (ticks > 0) ? ticks : 0;
+        }
+
+        animation_command_t command;
+        if (xQueueReceive(animation->commands, &command, timeout) == pdTRUE) {
+            animation_handle(animation, &command);
+            continue;
+        }
+
+        animation_draw(animation, program);
+    }
+}
+
+static int animation_send(animation_t *animation, animation_command_type_t type, const animation_program_t *overlay) {
+    animation_command_t command = {
+        .type = type,
+        .overlay = overlay,
+    };
+
+    // not initialised yet
+    if (!animation->commands)
+        return -1;
+
+    if (xQueueSend(animation->commands, &command,
+                   ANIMATION_SEND_TIMEOUT_MS / portTICK_PERIOD_MS) != pdTRUE)
+        return -1;
+
+    return 0;
+}
+
+int animation_init(animation_t *animation, frame_buffer_t *frames,
+                   const animation_program_t *program,
+                   const char *name, UBaseType_t priority) {
+    animation->frames = frames;
+    animation->program = program;
+    animation->overlay = NULL;
+    animation->state = ANIMATION_STOPPED;
+    animation->frame = 0;
+    animation->overlay_frame = 0;
+    animation->next_frame_time = 0;
+
+    animation->commands = xQueueCreateStatic(ANIMATION_QUEUE_SIZE, sizeof(animation_command_t),
+                                             animation->command_storage, &animation->command_buffer);
+    if (!animation->commands)
+        return -1;
+
+    animation_clear(animation);
+
+    if (!xTaskCreateStatic(animation_task, name, ANIMATION_TASK_STACK, animation, priority,
+                           animation->stack, &animation->task_buffer))
+        return -1;
+
+    return 0;
+}
+
+int animation_start(animation_t *animation) {
+    return animation_send(animation, ANIMATION_COMMAND_START, NULL);
+}
+
+int animation_stop(animation_t *animation) {
+    return animation_send(animation, ANIMATION_COMMAND_STOP, NULL);
+}
+
+int animation_pause(animation_t *animation) {
+    return animation_send(animation, ANIMATION_COMMAND_PAUSE, NULL);
+}
+
+int animation_resume(animation_t *animation) {
+    return animation_send(animation, ANIMATION_COMMAND_RESUME, NULL);
+}
+
+int animation_preempt(animation_t *animation, const animation_program_t *overlay) {
+    if (!overlay || !overlay->render)
+        return -1;
+
+    return animation_send(animation, ANIMATION_COMMAND_PREEMPT, overlay);
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <frame_buffer/frame_buffer.h>
+
+/*
+ * One renderer task per output, created once in animation_init() and
+ * controlled with commands sent through a queue. The task and the
+ * queue live in animation_t, so nothing is taken from the heap; list
+ * static_alloc in EXTRA_COMPONENTS to enable static allocation.
+ *
+ * The task sleeps on the queue between frames, so a command takes
+ * effect before the next frame starts: at most the time it takes to
+ * render one frame after it was sent.
+ *
+ * Overlays (e.g. identify) preempt the program for as long as they
+ * run. The renderer draws them in place of the program and goes back
+ * to the program once an overlay is done, so nothing else ever
+ * draws on the output.
+ */
+
+// Commands waiting to be handled
+#ifndef ANIMATION_QUEUE_SIZE
+#define ANIMATION_QUEUE_SIZE 4
+#endif
+
+// Stack size of the renderer task in words
+#ifndef ANIMATION_TASK_STACK
+#define ANIMATION_TASK_STACK 256
+#endif
+
+// How long a command may wait for room in the queue
+#ifndef ANIMATION_SEND_TIMEOUT_MS
+#define ANIMATION_SEND_TIMEOUT_MS 100
+#endif
+
+/**
+    Draws one frame. Every pixel of the frame is drawn, the buffer
+    holds an older frame.
+
+    @param pixels Frame to draw.
+    @param frame Number of the frame since the program (overlay) started.
+    @param context Context of the program.
+    @return false if this is the last frame (of an overlay).
+*/
+typedef bool (*animation_render_fn)(ws2812_pixel_t *pixels, uint32_t frame, void *context);
+
+typedef struct {
+    animation_render_fn render;
+    uint16_t frame_ms;          // time between frames
+    void *context;
+} animation_program_t;
+
+typedef enum {
+    ANIMATION_STOPPED = 0,      // output is cleared
+    ANIMATION_RUNNING,
+    ANIMATION_PAUSED,           // last frame stays on the output
+} animation_state_t;
+
+// Commands sent to the renderer task, used by animation.c only
+typedef enum {
+    ANIMATION_COMMAND_START,
+    ANIMATION_COMMAND_STOP,
+    ANIMATION_COMMAND_PAUSE,
+    ANIMATION_COMMAND_RESUME,
+    ANIMATION_COMMAND_PREEMPT,
+} animation_command_type_t;
+
+typedef struct {
+    animation_command_type_t type;
+    const animation_program_t *overlay;
+} animation_command_t;
+
+typedef struct {
+    frame_buffer_t *frames;
+    const animation_program_t *program;
+    const animation_program_t *overlay;     // NULL if there is none
+
+    QueueHandle_t commands;
+    volatile animation_state_t state;
+    uint32_t frame;
+    uint32_t overlay_frame;
+    TickType_t next_frame_time;
+
+    StaticQueue_t command_buffer;
+    uint8_t command_storage[ANIMATION_QUEUE_SIZE * sizeof(animation_command_t)];
+    StaticTask_t task_buffer;
+    StackType_t stack[ANIMATION_TASK_STACK];
+} animation_t;
+
+/**
+    Creates the renderer task of an output.
+
+    @param animation Animation to initialize.
+    @param frames Output, which is cleared.
+    @param program Program to run.
+    @param name Name of the renderer task.
+    @param priority Priority of the task.
+    @return A negative integer if this method fails.
+*/
+int animation_init(animation_t *animation, frame_buffer_t *frames,
+                   const animation_program_t *program,
+                   const char *name, UBaseType_t priority);
+
+/**
+    Runs the program from its first frame, unless it is running already.
+
+    @return A negative integer if this method fails.
+*/
+int animation_start(animation_t *animation);
+
+/**
+    Stops the program and clears the output.
+
+    @return A negative integer if this method fails.
+*/
+int animation_stop(animation_t *animation);
+
+/**
+    Freezes the program on its current frame.
+
+    @return A negative integer if this method fails.
+*/
+int animation_pause(animation_t *animation);
+
+/**
+    Continues the paused program.
+
+    @return A negative integer if this method fails.
+*/
+int animation_resume(animation_t *animation);
+
+/**
+    Runs an overlay in place of the program until the overlay is done.
+    An overlay started while another one runs replaces it.
+
+    @param animation Animation.
+    @param overlay Overlay to run, it is not copied.
+    @return A negative integer if this method fails.
+*/
+int animation_preempt(animation_t *animation, const animation_program_t *overlay);
+
+/**
+    State of the program as of the last handled command.
+*/
+static inline animation_state_t animation_state(animation_t *animation) {
+    return animation->state;
+}
@@ -0,0 +1,9 @@
+# Component makefile for animation
+
+# expected anyone using this component includes it as 'animation/animation.h'
+INC_DIRS += $(animation_ROOT)..
+
+# args for passing into compile rule generation
+animation_SRC_DIR = $(animation_ROOT)
+
+$(eval $(call component_compile_rules,animation))
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <espressif/esp_system.h>
+#include <espressif/esp_sta.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "boot_profile.h"
+
+#define BOOT_PROFILE_MAGIC 0xB0075EED
+
+// RTC user memory is addressed in 4 byte blocks and starts at block 64
+#define RTC_BLOCK(offset) (64 + (offset) / 4)
+
+#define WIFI_POLL_INTERVAL_MS 10
+
+#define MAX_ASYNC 4
+
+
+typedef struct {
+    char name[BOOT_PROFILE_NAME_LEN];
+    uint32_t time;
+} boot_mark_t;
+
+typedef struct {
+    uint32_t magic;
+    uint8_t count;
+    bool complete;
+    uint16_t reserved;
+    boot_mark_t marks[BOOT_PROFILE_MAX_MARKS];
+} boot_profile_t;
+
+typedef struct {
+    const char *name;
+    void (*init)();
+} boot_async_t;
+
+
+static boot_profile_t profile;
+static boot_async_t async_jobs[MAX_ASYNC];
+
+
+static void profile_save_header() {
+    sdk_system_rtc_mem_write(RTC_BLOCK(0), &profile, offsetof(boot_profile_t, marks));
+}
+
+static void profile_print(const boot_profile_t *p) {
+    uint32_t last = 0;
+    for (int i = 0; i < p->count; i++) {
+        const boot_mark_t *mark = &p->marks[i];
+        printf("  %-*s %7u us %+8d us\n",
+               BOOT_PROFILE_NAME_LEN, mark->name, mark->time, (int)(mark->time - last));
+        last = mark->time;
+    }
+}
+
+void boot_profile_init() {
+    boot_profile_t previous;
+    if (sdk_system_rtc_mem_read(RTC_BLOCK(0), &previous, sizeof(previous)) &&
+            previous.magic == BOOT_PROFILE_MAGIC && !previous.complete &&
+            previous.count <= BOOT_PROFILE_MAX_MARKS) {
+        printf("Boot profile: previous boot did not complete\n");
+        profile_print(&previous);
+    }
+
+    memset(&profile, 0, sizeof(profile));
+    profile.magic = BOOT_PROFILE_MAGIC;
+    profile_save_header();
+
+    boot_profile_mark("start");
+}
+
+void boot_profile_mark(const char *name) {
+    uint32_t now = sdk_system_get_time();
+
+    taskENTER_CRITICAL();
+
+    if (profile.count < BOOT_PROFILE_MAX_MARKS) {
+        uint8_t index = profile.count++;
+        boot_mark_t *mark = &profile.marks[index];
+        strncpy(mark->name, name, sizeof(mark->name) - 1);
+        mark->time = now;
+
+        sdk_system_rtc_mem_write(RTC_BLOCK(offsetof(boot_profile_t, marks) + index * sizeof(*mark)),
+                                 mark, sizeof(*mark));
+        profile_save_header();
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+void boot_profile_dump() {
+    printf("Boot profile:\n");
+    profile_print(&profile);
+}
+
+static void boot_profile_wifi_task(void *_args) {
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) {
+        vTaskDelay(WIFI_POLL_INTERVAL_MS / portTICK_PERIOD_MS);
+    }
+
+    boot_profile_mark("got IP");
+
+    taskENTER_CRITICAL();
+    profile.complete = true;
+    profile_save_header();
+    taskEXIT_CRITICAL();
+
+    boot_profile_dump();
+
+    vTaskDelete(NULL);
+}
+
+void boot_profile_watch_wifi() {
+    xTaskCreate(boot_profile_wifi_task, "Boot profile", 256, NULL, 1, NULL);
+}
+
+static void boot_profile_async_task(void *_args) {
+    boot_async_t *job = _args;
+
+    job->init();
+    boot_profile_mark(job->name);
+
+    job->init = NULL;
+    vTaskDelete(NULL);
+}
+
+int boot_profile_async(const char *name, void (*init)(), uint16_t stack_depth) {
+    for (int i = 0; i < MAX_ASYNC; i++) {
+        boot_async_t *job = &async_jobs[i];
+        if (job->init)
+            continue;
+
+        job->name = name;
+        job->init = init;
+        if (xTaskCreate(boot_profile_async_task, name, stack_depth, job, 2, NULL) != pdPASS) {
+            job->init = NULL;
+            return -1;
+        }
+        return 0;
+    }
+
+    return -1;
+}
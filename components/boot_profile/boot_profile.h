@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Boot profiler: records how long each phase of user_init and the
+ * time until the device gets an IP address take.
+ *
+ * Marks are kept in RTC memory, so they survive a watchdog or
+ * software reset. If a boot hangs and the device resets, the next
+ * boot reports the phase where the previous one got stuck.
+ *
+ * Times are microseconds of system time, which starts counting
+ * when the SDK starts, shortly after power-on.
+ */
+
+// Maximum number of marks recorded per boot
+#define BOOT_PROFILE_MAX_MARKS 16
+#define BOOT_PROFILE_NAME_LEN 12
+
+/**
+    Starts a new profile. Call it first thing in user_init.
+    Reports the previous boot if it did not complete.
+*/
+void boot_profile_init();
+
+/**
+    Records the end of a boot phase.
+
+    @param name Name of the phase that just finished, truncated to
+           BOOT_PROFILE_NAME_LEN - 1 characters.
+*/
+void boot_profile_mark(const char *name);
+
+/**
+    Waits in background until the station gets an IP address, marks
+    it and prints the boot breakdown.
+*/
+void boot_profile_watch_wifi();
+
+/**
+    Runs an init function in its own task, so it runs while WiFi
+    associates instead of delaying it. Marks the phase when the
+    function returns.
+
+    Characteristics the init function sets up may be used by the
+    HomeKit server before it returns, their setters have to check.
+
+    @param name Name of the phase.
+    @param init Init function.
+    @param stack_depth Stack of the task in words, whatever init and
+           everything it calls need.
+    @return A negative integer if this method fails.
+*/
+int boot_profile_async(const char *name, void (*init)(), uint16_t stack_depth);
+
+/**
+    Prints all recorded phases with their durations.
+*/
+void boot_profile_dump();
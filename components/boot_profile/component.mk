@@ -0,0 +1,9 @@
+# Component makefile for boot_profile
+
+# expected anyone using this component includes it as 'boot_profile/boot_profile.h'
+INC_DIRS += $(boot_profile_ROOT)..
+
+# args for passing into compile rule generation
+boot_profile_SRC_DIR = $(boot_profile_ROOT)
+
+$(eval $(call component_compile_rules,boot_profile))
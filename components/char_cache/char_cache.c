@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <espressif/esp_system.h>
+#include <homekit/homekit.h>
+#include <static_alloc/static_alloc.h>
+
+#include "char_cache.h"
+
+
+static char_cache_t *caches = NULL;
+STATIC_TASK(commit, 512);
+static TaskHandle_t commit_task_handle = NULL;
+
+
+static int entry_index(const char_cache_t *cache, const homekit_characteristic_t *ch) {
+    for (int i = 0; i < CHAR_CACHE_MAX_ENTRIES; i++) {
+        if (cache->entries[i] == ch)
+            return i;
+    }
+    return -1;
+}
+
+// Characteristics get their slot on the first write
+static int entry_add(char_cache_t *cache, homekit_characteristic_t *ch) {
+    int index = entry_index(cache, ch);
+    if (index >= 0)
+        return index;
+
+    for (int i = 0; i < CHAR_CACHE_MAX_ENTRIES; i++) {
+        if (!cache->entries[i]) {
+            cache->entries[i] = ch;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Caches are listed on their first write or update, call in a critical section
+static void cache_register(char_cache_t *cache, uint32_t now) {
+    if (cache->registered)
+        return;
+
+    cache->since = now;
+    cache->next = caches;
+    caches = cache;
+    cache->registered = true;
+}
+
+void char_cache_changed(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
+    char_cache_t *cache = context;
+    if (cache->updating == ch)
+        return;
+
+    uint32_t now = sdk_system_get_time();
+
+    taskENTER_CRITICAL();
+    int index = entry_add(cache, ch);
+    if (index >= 0) {
+        if (!cache->dirty)
+            cache->first_write = now;
+        cache->dirty |= 1 << index;
+        cache->writes++;
+    }
+
+    cache_register(cache, now);
+    taskEXIT_CRITICAL();
+
+    if (index < 0) {
+        printf("char_cache: too many characteristics\n");
+        return;
+    }
+
+    if (commit_task_handle)
+        xTaskNotifyGive(commit_task_handle);
+}
+
+bool char_cache_dirty(const char_cache_t *cache, const homekit_characteristic_t *ch) {
+    int index = entry_index(cache, ch);
+    return index >= 0 && (cache->committing & (1 << index));
+}
+
+static void histogram_add(char_cache_histogram_t *histogram, uint32_t us) {
+    int bucket = 0;
+    while (bucket < CHAR_CACHE_HISTOGRAM_BUCKETS - 1 && (us >> (bucket + 1)))
+        bucket++;
+
+    if (histogram->buckets[bucket] < UINT16_MAX)
+        histogram->buckets[bucket]++;
+    if (us > histogram->max_us)
+        histogram->max_us = us;
+}
+
+uint32_t char_cache_percentile(const char_cache_histogram_t *histogram, uint8_t percent) {
+    uint32_t total = 0;
+    for (int i = 0; i < CHAR_CACHE_HISTOGRAM_BUCKETS; i++) {
+        total += histogram->buckets[i];
+    }
+    if (!total)
+        return 0;
+
+    uint32_t rank = (total * percent + 99) / 100;
+    uint32_t count = 0;
+    for (int i = 0; i < CHAR_CACHE_HISTOGRAM_BUCKETS - 1; i++) {
+        count += histogram->buckets[i];
+        if (count >= rank) {
+            uint32_t bound = 2 << i;
+            return (bound < histogram->max_us) ? bound : histogram->max_us;
+        }
+    }
+    return histogram->max_us;
+}
+
+void char_cache_update(char_cache_t *cache, homekit_characteristic_t *ch, homekit_value_t value) {
+    uint32_t start = sdk_system_get_time();
+
+    taskENTER_CRITICAL();
+    cache_register(cache, start);
+    taskEXIT_CRITICAL();
+
+    cache->updating = ch;
+    ch->value = value;
+    homekit_characteristic_notify(ch, value);
+    cache->updating = NULL;
+
+    histogram_add(&cache->notify_time, sdk_system_get_time() - start);
+    cache->notifies++;
+}
+
+// Events per second since the cache's first write
+static uint32_t rate(const char_cache_t *cache, uint32_t count, uint32_t now) {
+    uint32_t elapsed_ms = (now - cache->since) / 1000;
+    return elapsed_ms ? (uint64_t)count * 1000 / elapsed_ms : 0;
+}
+
+void char_cache_stats_dump() {
+    uint32_t now = sdk_system_get_time();
+
+    for (char_cache_t *cache = caches; cache; cache = cache->next) {
+        printf("char_cache %p: %u writes, %u commits, %u notifies\n",
+               cache, cache->writes, cache->commits, cache->notifies);
+        printf("    %u writes/s, %u commits/s, %u notifies/s\n",
+               rate(cache, cache->writes, now), rate(cache, cache->commits, now),
+               rate(cache, cache->notifies, now));
+        printf("    batch wait p50 %uus, p99 %uus, max %uus\n",
+               char_cache_percentile(&cache->batch_wait, 50),
+               char_cache_percentile(&cache->batch_wait, 99),
+               cache->batch_wait.max_us);
+        printf("    commit time p50 %uus, p99 %uus, max %uus\n",
+               char_cache_percentile(&cache->commit_time, 50),
+               char_cache_percentile(&cache->commit_time, 99),
+               cache->commit_time.max_us);
+        printf("    notify time p50 %uus, p99 %uus, max %uus\n",
+               char_cache_percentile(&cache->notify_time, 50),
+               char_cache_percentile(&cache->notify_time, 99),
+               cache->notify_time.max_us);
+    }
+}
+
+static void char_cache_commit_task(void *_args) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Let the rest of the request arrive
+        vTaskDelay(CHAR_CACHE_COMMIT_DELAY_MS / portTICK_PERIOD_MS);
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        for (char_cache_t *cache = caches; cache; cache = cache->next) {
+            taskENTER_CRITICAL();
+            cache->committing = cache->dirty;
+            cache->dirty = 0;
+            uint32_t first_write = cache->first_write;
+            taskEXIT_CRITICAL();
+
+            if (!cache->committing)
+                continue;
+
+            uint32_t start = sdk_system_get_time();
+            histogram_add(&cache->batch_wait, start - first_write);
+
+            cache->commit(cache);
+            cache->committing = 0;
+            cache->commits++;
+
+            histogram_add(&cache->commit_time, sdk_system_get_time() - start);
+
+            if (CHAR_CACHE_DUMP_EVERY && !(cache->commits % CHAR_CACHE_DUMP_EVERY))
+                char_cache_stats_dump();
+        }
+    }
+}
+
+int char_cache_init() {
+    commit_task_handle = STATIC_TASK_CREATE(commit, char_cache_commit_task, "Commit", NULL, 1);
+    if (!commit_task_handle)
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <homekit/types.h>
+
+/*
+ * Write-back cache for characteristic values.
+ *
+ * Characteristics that use the cache have no getter or setter, so
+ * controllers read their values straight from RAM. A write only marks
+ * the characteristic dirty; the cache's commit function applies all
+ * dirty characteristics to hardware shortly after, from the commit
+ * task. Home app sends hue, saturation and brightness of a color in
+ * one request, and they end up in a single hardware update.
+ *
+ *     void light_commit(char_cache_t *cache);
+ *     char_cache_t light_cache = CHAR_CACHE_(light_commit);
+ *
+ *     homekit_characteristic_t hue = HOMEKIT_CHARACTERISTIC_(
+ *         HUE, 0, .callback=CHAR_CACHE_CALLBACK(light_cache)
+ *     );
+ */
+
+// Maximum number of characteristics per cache
+#define CHAR_CACHE_MAX_ENTRIES 8
+
+// How long the commit task waits for more writes of the same request
+#ifndef CHAR_CACHE_COMMIT_DELAY_MS
+#define CHAR_CACHE_COMMIT_DELAY_MS 20
+#endif
+
+// Print latency statistics of all caches every this many commits,
+// 0 to only print them on request
+#ifndef CHAR_CACHE_DUMP_EVERY
+#define CHAR_CACHE_DUMP_EVERY 0
+#endif
+
+// Latencies are counted in power of two buckets of microseconds,
+// the last bucket takes everything above 2^20us (about 1s)
+#define CHAR_CACHE_HISTOGRAM_BUCKETS 21
+
+typedef struct {
+    uint16_t buckets[CHAR_CACHE_HISTOGRAM_BUCKETS];
+    uint32_t max_us;
+} char_cache_histogram_t;
+
+typedef struct _char_cache char_cache_t;
+
+/**
+    Applies values of dirty characteristics to hardware.
+    Use char_cache_dirty() to find out which ones changed.
+*/
+typedef void (*char_cache_commit_fn)(char_cache_t *cache);
+
+struct _char_cache {
+    char_cache_commit_fn commit;
+    void *context;
+
+    uint32_t writes;            // characteristic writes
+    uint32_t commits;           // hardware updates
+    uint32_t notifies;          // hardware side changes sent to controllers
+    uint32_t since;             // time of the first write or update, rates count from it
+
+    // From the first write of a batch until its commit started, i.e.
+    // CHAR_CACHE_COMMIT_DELAY_MS plus the wait for the commit task
+    char_cache_histogram_t batch_wait;
+    // From the start of a commit until it returned, i.e. until the
+    // hardware was updated
+    char_cache_histogram_t commit_time;
+    // Time to notify controllers of a hardware side change
+    char_cache_histogram_t notify_time;
+
+    // internal
+    homekit_characteristic_t *entries[CHAR_CACHE_MAX_ENTRIES];
+    volatile uint8_t dirty;
+    uint8_t committing;
+    uint32_t first_write;
+    homekit_characteristic_t *updating;
+    bool registered;
+    char_cache_t *next;
+};
+
+#define CHAR_CACHE_(commit_fn, ...) \
+    { .commit = commit_fn, ##__VA_ARGS__ }
+
+#define CHAR_CACHE_CALLBACK(cache) \
+    HOMEKIT_CHARACTERISTIC_CALLBACK(char_cache_changed, .context=&(cache))
+
+void char_cache_changed(homekit_characteristic_t *ch, homekit_value_t value, void *context);
+
+/**
+    Starts the commit task.
+
+    @return A negative integer if this method fails.
+*/
+int char_cache_init();
+
+/**
+    Tells whether the characteristic changed since the last commit.
+    Only valid inside the commit function.
+*/
+bool char_cache_dirty(const char_cache_t *cache, const homekit_characteristic_t *ch);
+
+/**
+    Stores a value that changed on the hardware side, e.g. when a
+    button was pressed, and notifies controllers. The value is not
+    committed back to hardware.
+*/
+void char_cache_update(char_cache_t *cache, homekit_characteristic_t *ch, homekit_value_t value);
+
+/**
+    Returns an upper bound of the given percentile of a histogram
+    in microseconds, 0 if it is empty.
+*/
+uint32_t char_cache_percentile(const char_cache_histogram_t *histogram, uint8_t percent);
+
+/**
+    Prints throughput and p50/p99 latencies of all caches. Write to
+    hardware latency is batch wait plus commit time.
+*/
+void char_cache_stats_dump();
@@ -0,0 +1,9 @@
+# Component makefile for char_cache
+
+# expected anyone using this component includes it as 'char_cache/char_cache.h'
+INC_DIRS += $(char_cache_ROOT)..
+
+# args for passing into compile rule generation
+char_cache_SRC_DIR = $(char_cache_ROOT)
+
+$(eval $(call component_compile_rules,char_cache))
@@ -0,0 +1,18 @@
+# Component makefile for fixmath
+
+# expected anyone using this component includes it as 'fixmath/fixmath.h'
+INC_DIRS += $(fixmath_ROOT)..
+
+# args for passing into compile rule generation
+fixmath_SRC_DIR = $(fixmath_ROOT)
+
+# Set to 1 to build fixmath_bench(), which compares against libm
+FIXMATH_BENCH ?= 0
+
+fixmath_CFLAGS = $(CFLAGS) -DFIXMATH_BENCH=$(FIXMATH_BENCH)
+
+ifeq ($(FIXMATH_BENCH),1)
+LIBS += m
+endif
+
+$(eval $(call component_compile_rules,fixmath))
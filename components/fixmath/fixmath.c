@@ -0,0 +1,93 @@
+#include "fixmath.h"
+
+// sin() of 0 to 90 degrees scaled to 0..65535
+static const uint16_t sin_table[91] = {
+        0,  1144,  2287,  3430,  4571,  5712,  6850,  7987,
+     9121, 10252, 11380, 12505, 13625, 14742, 15854, 16962,
+    18064, 19161, 20251, 21336, 22414, 23486, 24550, 25607,
+    26655, 27696, 28729, 29752, 30767, 31772, 32767, 33753,
+    34728, 35693, 36647, 37589, 38521, 39440, 40347, 41243,
+    42125, 42995, 43851, 44695, 45524, 46340, 47142, 47929,
+    48702, 49460, 50203, 50930, 51642, 52339, 53019, 53683,
+    54331, 54962, 55577, 56174, 56755, 57318, 57864, 58392,
+    58902, 59395, 59869, 60325, 60763, 61182, 61583, 61965,
+    62327, 62671, 62996, 63302, 63588, 63855, 64103, 64331,
+    64539, 64728, 64897, 65047, 65176, 65286, 65375, 65445,
+    65495, 65525, 65535,
+};
+
+
+// sin() of 0 to 90 degrees
+static q16_t sin_quarter(q16_t degrees) {
+    uint32_t index = degrees >> 16;
+    uint32_t fraction = degrees & 0xFFFF;
+
+    int32_t value = sin_table[index];
+    if (fraction)
+        value += ((int32_t)(sin_table[index + 1] - value) * (int32_t)fraction) >> 16;
+
+    // from 65535 to 65536 scale
+    return value + (value >> 15);
+}
+
+q16_t q16_sin(q16_t degrees) {
+    degrees = q16_mod(degrees, Q16(360));
+
+    if (degrees < Q16(90))
+        return sin_quarter(degrees);
+    if (degrees < Q16(180))
+        return sin_quarter(Q16(180) - degrees);
+    if (degrees < Q16(270))
+        return -sin_quarter(degrees - Q16(180));
+
+    return -sin_quarter(Q16(360) - degrees);
+}
+
+q16_t q16_cos(q16_t degrees) {
+    return q16_sin(q16_mod(degrees, Q16(360)) + Q16(90));
+}
+
+uint32_t isqrt32(uint32_t x) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > x)
+        bit >>= 2;
+
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+q16_t q16_sqrt(q16_t x) {
+    if (x <= 0)
+        return 0;
+
+    // sqrt(x / 2^16) * 2^16 = sqrt(x * 2^16)
+    uint64_t value = (uint64_t)x << 16;
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > value)
+        bit >>= 2;
+
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return root;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Fixed-point math for code that would otherwise pull in libm and
+ * soft-float routines. The lx106 has no FPU, so every float multiply,
+ * compare and conversion is a library call.
+ *
+ * q16_t is a signed Q16.16 number: 16 integer bits and 16 fraction
+ * bits, covering -32768 to 32767.99998. Angles are in degrees, the
+ * unit HomeKit uses for hue.
+ */
+
+typedef int32_t q16_t;
+
+#define Q16_ONE 0x10000
+
+// Converts a constant to Q16.16 at compile time. Use q16_from_float()
+// for values only known at run time.
+#define Q16(x) ((q16_t)((x) * 65536.0 + ((x) >= 0 ? 0.5 : -0.5)))
+
+static inline q16_t q16_from_int(int32_t x) {
+    return x * Q16_ONE;
+}
+
+// Rounds towards negative infinity
+static inline int32_t q16_to_int(q16_t x) {
+    return x >> 16;
+}
+
+static inline int32_t q16_round(q16_t x) {
+    return (x + Q16_ONE / 2) >> 16;
+}
+
+// For values coming from HomeKit, which are floats
+static inline q16_t q16_from_float(float x) {
+    return (q16_t)(x * 65536.0f);
+}
+
+static inline float q16_to_float(q16_t x) {
+    return x / 65536.0f;
+}
+
+static inline q16_t q16_mul(q16_t a, q16_t b) {
+    return ((int64_t)a * b) >> 16;
+}
+
+static inline q16_t q16_div(q16_t a, q16_t b) {
+    return ((int64_t)a << 16) / b;
+}
+
+// Remainder that is never negative, e.g. to wrap angles into 0 to 360
+static inline q16_t q16_mod(q16_t a, q16_t m) {
+    a %= m;
+    return (a < 0) ? a + m : a;
+}
+
+static inline q16_t q16_clamp(q16_t x, q16_t min, q16_t max) {
+    return (x < min) ? min : (x > max) ? max : x;
+}
+
+static inline q16_t q16_add_sat(q16_t a, q16_t b) {
+    int64_t sum = (int64_t)a + b;
+    return (sum > INT32_MAX) ? INT32_MAX : (sum < INT32_MIN) ? INT32_MIN : sum;
+}
+
+static inline q16_t q16_sub_sat(q16_t a, q16_t b) {
+    int64_t difference = (int64_t)a - b;
+    return (difference > INT32_MAX) ? INT32_MAX : (difference < INT32_MIN) ? INT32_MIN : difference;
+}
+
+// Point between a and b, t goes from 0 (a) to Q16_ONE (b)
+static inline q16_t q16_lerp(q16_t a, q16_t b, q16_t t) {
+    return a + q16_mul(b - a, t);
+}
+
+static inline uint8_t u8_add_sat(uint8_t a, uint8_t b) {
+    uint16_t sum = a + b;
+    return (sum > 255) ? 255 : sum;
+}
+
+static inline uint8_t u8_sub_sat(uint8_t a, uint8_t b) {
+    return (a > b) ? a - b : 0;
+}
+
+// Point between a and b, t goes from 0 (a) to 255 (b)
+static inline uint8_t u8_lerp(uint8_t a, uint8_t b, uint8_t t) {
+    int32_t delta = ((int32_t)b - a) * t;
+    return a + (delta + (delta < 0 ? -127 : 127)) / 255;
+}
+
+/**
+    Sine of an angle in degrees, from a 1 degree table with linear
+    interpolation. The error is below 0.0001.
+*/
+q16_t q16_sin(q16_t degrees);
+
+q16_t q16_cos(q16_t degrees);
+
+/**
+    Integer square root, rounded down.
+*/
+uint32_t isqrt32(uint32_t x);
+
+/**
+    Square root of a non-negative number, 0 for negative ones.
+*/
+q16_t q16_sqrt(q16_t x);
+
+/**
+    Prints cycles per call of these functions next to their libm
+    counterparts when built with FIXMATH_BENCH=1, which links libm.
+    Does nothing otherwise, so it can be called unconditionally.
+*/
+void fixmath_bench();
@@ -0,0 +1,58 @@
+#include <stdio.h>
+
+#include "fixmath.h"
+
+#if FIXMATH_BENCH
+
+#include <math.h>
+
+#define BENCH_CALLS 1000
+
+// Keeps the compiler from dropping the measured calls
+static volatile q16_t q16_sink;
+static volatile float float_sink;
+
+
+static inline uint32_t ccount() {
+    uint32_t value;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (value));
+    return value;
+}
+
+#define BENCH(label, expression) do { \
+        uint32_t start = ccount(); \
+        for (int i = 0; i < BENCH_CALLS; i++) { \
+            expression; \
+        } \
+        printf("%-12s %8u\n", label, (ccount() - start) / BENCH_CALLS); \
+    } while (0)
+
+void fixmath_bench() {
+    // volatile inputs, so the loops are not folded into constants
+    volatile float f = 47.3f;
+    volatile q16_t q = Q16(47.3);
+
+    printf("%-12s %8s\n", "function", "cycles");
+
+    BENCH("cos", float_sink = cos(f * 3.14159f / 180));
+    BENCH("q16_cos", q16_sink = q16_cos(q));
+
+    BENCH("sqrt", float_sink = sqrt(f));
+    BENCH("q16_sqrt", q16_sink = q16_sqrt(q));
+
+    BENCH("float mul", float_sink = f * f);
+    BENCH("q16_mul", q16_sink = q16_mul(q, q));
+
+    BENCH("float div", float_sink = f / (f + 1));
+    BENCH("q16_div", q16_sink = q16_div(q, q + Q16_ONE));
+
+    BENCH("floor", float_sink = floor(f * 2.55f));
+    BENCH("int scale", q16_sink = q16_to_int(q) * 255 / 100);
+}
+
+#else
+
+void fixmath_bench() {
+}
+
+#endif
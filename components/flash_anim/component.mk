@@ -0,0 +1,16 @@
+# Component makefile for flash_anim
+
+# expected anyone using this component includes it as 'flash_anim/flash_anim.h'
+INC_DIRS += $(flash_anim_ROOT)..
+
+# args for passing into compile rule generation
+flash_anim_SRC_DIR = $(flash_anim_ROOT)
+
+# Flash address of the animation made with flash_anim.py, by default
+# past the two 1MB OTA slots of a 4MB flash
+FLASH_ANIM_ADDR ?= 0x200000
+
+flash_anim_CFLAGS = $(CFLAGS) \
+	-DFLASH_ANIM_ADDR='$(FLASH_ANIM_ADDR)'
+
+$(eval $(call component_compile_rules,flash_anim))
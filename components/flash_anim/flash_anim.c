@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+#include <spiflash.h>
+#include <espressif/esp_system.h>
+
+#include "flash_anim.h"
+
+#ifndef FLASH_ANIM_ADDR
+#error FLASH_ANIM_ADDR is not defined
+#endif
+
+#define OP_MASK 0xC0
+#define OP_SKIP 0x00
+#define OP_RUN 0x40
+#define OP_LITERAL 0x80
+#define OP_LENGTH_MASK 0x3F
+
+
+static void anim_rewind(flash_anim_t *anim) {
+    anim->frame = 0;
+    anim->position = anim->addr + sizeof(flash_anim_header_t);
+    anim->window_pos = anim->window_len = 0;
+
+    // first frame is coded against a black one
+    memset(anim->pixels, 0, anim->header.pixels * sizeof(ws2812_pixel_t));
+}
+
+// Next byte of the animation, -1 past its end or on a read error
+static int anim_read(flash_anim_t *anim) {
+    if (anim->window_pos == anim->window_len) {
+        uint32_t end = anim->addr + sizeof(flash_anim_header_t) + anim->header.size;
+        if (anim->position >= end)
+            return -1;
+
+        // reads are whole words
+        uint32_t size = end - anim->position;
+        if (size > FLASH_ANIM_WINDOW)
+            size = FLASH_ANIM_WINDOW;
+        if (!spiflash_read(anim->position, anim->window, (size + 3) & ~3))
+            return -1;
+
+        anim->position += size;
+        anim->window_pos = 0;
+        anim->window_len = size;
+    }
+
+    return anim->window[anim->window_pos++];
+}
+
+static bool anim_read_pixel(flash_anim_t *anim, ws2812_pixel_t *pixel) {
+    int red = anim_read(anim);
+    int green = anim_read(anim);
+    int blue = anim_read(anim);
+    if (blue < 0)
+        return false;
+
+    pixel->red = red;
+    pixel->green = green;
+    pixel->blue = blue;
+    pixel->white = 0;
+
+    return true;
+}
+
+static bool anim_decode(flash_anim_t *anim) {
+    int low = anim_read(anim);
+    int high = anim_read(anim);
+    if (high < 0)
+        return false;
+
+    // every byte of the frame is accounted for, so a corrupt frame
+    // does not go unnoticed
+    uint32_t left = low | (high << 8);
+    uint32_t start = anim->position - anim->window_len + anim->window_pos;
+
+    uint16_t index = 0;
+    while (index < anim->header.pixels) {
+        int op = anim_read(anim);
+        if (op < 0)
+            return false;
+
+        uint16_t count = (op & OP_LENGTH_MASK) + 1;
+        if (index + count > anim->header.pixels)
+            return false;
+
+        switch (op & OP_MASK) {
+            case OP_SKIP:
+                break;
+
+            case OP_RUN: {
+                ws2812_pixel_t color;
+                if (!anim_read_pixel(anim, &color))
+                    return false;
+                for (int i = 0; i < count; i++)
+                    anim->pixels[index + i] = color;
+                break;
+            }
+
+            case OP_LITERAL:
+                for (int i = 0; i < count; i++) {
+                    if (!anim_read_pixel(anim, &anim->pixels[index + i]))
+                        return false;
+                }
+                break;
+
+            default:
+                return false;
+        }
+
+        index += count;
+    }
+
+    uint32_t end = anim->position - anim->window_len + anim->window_pos;
+    return end - start == left;
+}
+
+int flash_anim_open(flash_anim_t *anim, uint16_t pixels) {
+    uint32_t addr = FLASH_ANIM_ADDR;
+    if (!spiflash_read(addr, (uint8_t *)&anim->header, sizeof(anim->header)))
+        return -1;
+
+    flash_anim_header_t *header = &anim->header;
+    if (header->magic != FLASH_ANIM_MAGIC || header->version != FLASH_ANIM_VERSION)
+        return -1;
+    if (header->pixels != pixels || !header->frames || !header->frame_ms)
+        return -1;
+
+    anim->pixels = malloc(pixels * sizeof(ws2812_pixel_t));
+    if (!anim->pixels)
+        return -1;
+
+    anim->addr = addr;
+    anim->decoded = 0;
+    anim->total_us = 0;
+    anim->max_us = 0;
+    anim->corrupt = 0;
+    anim_rewind(anim);
+
+    return 0;
+}
+
+bool flash_anim_render(ws2812_pixel_t *pixels, uint32_t _frame, void *context) {
+    flash_anim_t *anim = context;
+    uint32_t start = sdk_system_get_time();
+
+    if (anim->frame == anim->header.frames)
+        anim_rewind(anim);
+
+    if (anim_decode(anim)) {
+        anim->frame++;
+    } else {
+        // starts over rather than show garbage
+        anim->corrupt++;
+        anim_rewind(anim);
+    }
+
+    memcpy(pixels, anim->pixels, anim->header.pixels * sizeof(ws2812_pixel_t));
+
+    uint32_t time = sdk_system_get_time() - start;
+    anim->decoded++;
+    anim->total_us += time;
+    if (time > anim->max_us)
+        anim->max_us = time;
+
+    return true;
+}
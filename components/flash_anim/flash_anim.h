@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ws2812_i2s/ws2812_i2s.h>
+
+/*
+ * Plays animations pre-rendered on the host (see flash_anim.py) from
+ * flash, so effects too expensive to run live cost a decoder per frame.
+ *
+ * Each frame is coded as changes to the previous one (the first frame
+ * to a black one) in runs of up to 64 pixels:
+ *
+ *   00nnnnnn                   n+1 pixels did not change
+ *   01nnnnnn r g b             n+1 pixels of one color
+ *   10nnnnnn r g b ...         n+1 pixels of their own colors
+ *
+ * preceded by the frame's length in bytes. Frames are read from flash
+ * through a FLASH_ANIM_WINDOW bytes window, RAM used is that plus one
+ * decoded frame.
+ *
+ * The animation is at FLASH_ANIM_ADDR, set in component.mk.
+ *
+ * All numbers in the file are little endian.
+ */
+
+#ifndef FLASH_ANIM_WINDOW
+#define FLASH_ANIM_WINDOW 128
+#endif
+
+#define FLASH_ANIM_MAGIC 0x4D4E4146     // "FANM"
+#define FLASH_ANIM_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t frame_ms;          // time between frames
+    uint16_t pixels;            // pixels per frame
+    uint16_t reserved2;
+    uint32_t frames;
+    uint32_t size;              // bytes of frames following the header
+} flash_anim_header_t;
+
+typedef struct {
+    uint32_t addr;
+    flash_anim_header_t header;
+
+    uint32_t frame;             // index of the next frame
+    uint32_t position;          // flash address of the next byte to read
+    ws2812_pixel_t *pixels;     // last decoded frame
+
+    uint8_t window[FLASH_ANIM_WINDOW] __attribute__((aligned(4)));
+    uint16_t window_pos;
+    uint16_t window_len;
+
+    uint32_t decoded;           // frames decoded
+    uint32_t total_us;          // time spent decoding
+    uint32_t max_us;
+    uint32_t corrupt;           // frames that could not be decoded
+} flash_anim_t;
+
+/**
+    Checks the animation in flash and gets ready to play it.
+
+    @param anim Player to initialize.
+    @param pixels Number of pixels of the strip, has to match the animation.
+    @return A negative integer if this method fails.
+*/
+int flash_anim_open(flash_anim_t *anim, uint16_t pixels);
+
+/**
+    Decodes the next frame, after the last one the animation starts
+    over. Matches animation_render_fn, with the player as context.
+
+    @param pixels Buffer for the frame.
+    @param frame Not used, frames are played in order.
+    @param context Player.
+    @return true
+*/
+bool flash_anim_render(ws2812_pixel_t *pixels, uint32_t frame, void *context);
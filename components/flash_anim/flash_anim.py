@@ -0,0 +1,308 @@
+#!/usr/bin/env python
+"""
+Pre-renders animations for flash_anim and shows what is in such files.
+
+Usage:
+    flash_anim.py encode fire [--width W] [--height H] [--brightness B]
+                              [--fps N] [--seconds S] [--seed N] OUTPUT
+    flash_anim.py encode rainbow [--width W] [--height H] [--fps N]
+                                 [--seconds S] OUTPUT
+    flash_anim.py encode raw --pixels N --input FILE [--fps N] OUTPUT
+    flash_anim.py info FILE
+
+fire is the fire of the fireplace example, rendered the same way on a
+grid of columns going up and down in turn. rainbow is a rainbow moving
+along the strip. raw takes frames of N pixels of 3 bytes (red, green,
+blue) each, one after another, e.g. captured from another renderer.
+
+Encoded frames are decoded again and compared before the file is
+written. info prints size of frames and how well they compressed.
+
+Files are written to the device with 'make flash-anim' of the example.
+"""
+from __future__ import division, print_function
+
+import argparse
+import random
+import struct
+import sys
+
+MAGIC = 0x4D4E4146
+VERSION = 1
+HEADER = struct.Struct('<IBxHHxxII')
+
+OP_SKIP = 0x00
+OP_RUN = 0x40
+OP_LITERAL = 0x80
+MAX_COUNT = 64
+
+BLACK = (0, 0, 0)
+
+
+def encode_frame(frame, previous):
+    """Codes frame as changes to previous, both lists of (r, g, b)."""
+    data = bytearray()
+    count = len(frame)
+
+    def run_length(i):
+        n = 1
+        while i + n < count and n < MAX_COUNT and frame[i + n] == frame[i]:
+            n += 1
+        return n
+
+    i = 0
+    while i < count:
+        if frame[i] == previous[i]:
+            n = 1
+            while i + n < count and n < MAX_COUNT and frame[i + n] == previous[i + n]:
+                n += 1
+            data.append(OP_SKIP | (n - 1))
+        elif run_length(i) >= 2:
+            n = run_length(i)
+            data.append(OP_RUN | (n - 1))
+            data.extend(frame[i])
+        else:
+            # literal ends where skipping or a run is cheaper
+            n = 1
+            while (i + n < count and n < MAX_COUNT and
+                   frame[i + n] != previous[i + n] and run_length(i + n) < 3):
+                n += 1
+            data.append(OP_LITERAL | (n - 1))
+            for pixel in frame[i:i + n]:
+                data.extend(pixel)
+        i += n
+
+    if len(data) > 0xFFFF:
+        raise ValueError('frame of %d bytes does not fit' % len(data))
+
+    return struct.pack('<H', len(data)) + bytes(data)
+
+
+def decode(data):
+    """Returns header fields and frames of an encoded file."""
+    magic, version, frame_ms, pixels, frames, size = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('not a flash_anim file')
+    if HEADER.size + size != len(data):
+        raise ValueError('file is %d bytes, header says %d' % (len(data), HEADER.size + size))
+
+    position = HEADER.size
+    current = [BLACK] * pixels
+    decoded = []
+    sizes = []
+    for _ in range(frames):
+        length, = struct.unpack_from('<H', data, position)
+        position += 2
+        end = position + length
+
+        current = list(current)
+        index = 0
+        while index < pixels:
+            op = data[position]
+            n = (op & 0x3F) + 1
+            position += 1
+            if index + n > pixels:
+                raise ValueError('frame %d goes past the last pixel' % len(decoded))
+
+            if op & 0xC0 == OP_RUN:
+                color = tuple(data[position:position + 3])
+                position += 3
+                current[index:index + n] = [color] * n
+            elif op & 0xC0 == OP_LITERAL:
+                for k in range(n):
+                    current[index + k] = tuple(data[position:position + 3])
+                    position += 3
+            elif op & 0xC0 != OP_SKIP:
+                raise ValueError('bad op %02x in frame %d' % (op, len(decoded)))
+            index += n
+
+        if position != end:
+            raise ValueError('frame %d is %d bytes, not %d' % (len(decoded), length - (end - position), length))
+
+        decoded.append(current)
+        sizes.append(length + 2)
+
+    return frame_ms, pixels, decoded, sizes
+
+
+def encode(frames, pixels, frame_ms):
+    body = bytearray()
+    previous = [BLACK] * pixels
+    for frame in frames:
+        body.extend(encode_frame(frame, previous))
+        previous = frame
+
+    data = HEADER.pack(MAGIC, VERSION, frame_ms, pixels, len(frames), len(body)) + bytes(body)
+
+    # check the file decodes to what was rendered
+    _, _, decoded, _ = decode(bytearray(data))
+    if decoded != [list(frame) for frame in frames]:
+        raise ValueError('decoded frames do not match')
+
+    return data
+
+
+def palette(stops):
+    """Same 256 colors palette_build() makes of the stops."""
+    def mix(a, b, amount):
+        # C division rounds towards zero
+        change = (b - a) * (amount + 1)
+        return a + (change >> 8 if change >= 0 else -(-change >> 8))
+
+    colors = []
+    s = 0
+    for i in range(256):
+        while s < len(stops) - 1 and stops[s + 1][0] <= i:
+            s += 1
+
+        if i <= stops[s][0] or s == len(stops) - 1:
+            color = stops[s][1]
+        else:
+            (lo, a), (hi, b) = stops[s], stops[s + 1]
+            amount = (i - lo) * 255 // (hi - lo)
+            color = 0
+            for shift in (16, 8, 0):
+                color |= mix((a >> shift) & 0xFF, (b >> shift) & 0xFF, amount) << shift
+
+        colors.append(((color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF))
+    return colors
+
+
+FIRE_STOPS = [(0, 0x000000), (80, 0xff0000), (160, 0xffff00), (240, 0xffffff)]
+RAINBOW_STOPS = [(0, 0xff0000), (85, 0x00ff00), (170, 0x0000ff), (255, 0xff0000)]
+
+COOLING = 55
+
+
+def grid_index(width, height, x, y):
+    # columns going up and down in turn, like the fireplace
+    return x * height + (height - y - 1 if x & 1 else y)
+
+
+def render_fire(args):
+    width, height = args.width, args.height
+    colors = palette(FIRE_STOPS)
+    rng = random.Random(args.seed)
+    stack = [[0] * height for _ in range(width)]
+
+    hot = 256 * args.brightness // 100
+    maxhot = hot * height
+
+    for _ in range(int(args.seconds * args.fps)):
+        for i in range(width):
+            for j in range(height):
+                cooling = rng.randrange(COOLING)
+                stack[i][j] = 0 if stack[i][j] < cooling else stack[i][j] - cooling
+
+            if stack[i][0] < hot:
+                stack[i][0] = hot + rng.randrange(max(maxhot - hot, 1))
+
+        for i in range(width):
+            for j in range(height - 1, 0, -1):
+                heat = stack[i][j] + stack[i][j - 1]
+                if i > 0:
+                    heat += stack[i - 1][j - 1]
+                if i < width - 1:
+                    heat += stack[i + 1][j - 1]
+                stack[i][j] = heat // 6
+
+        frame = [BLACK] * (width * height)
+        for i in range(width):
+            for j in range(height):
+                frame[grid_index(width, height, i, j)] = colors[(stack[i][j] // height * 2) & 0xFF]
+        yield frame
+
+
+def render_rainbow(args):
+    count = args.width * args.height
+    colors = palette(RAINBOW_STOPS)
+    for step in range(int(args.seconds * args.fps)):
+        yield [colors[(i * 256 // count + step) & 0xFF] for i in range(count)]
+
+
+def read_raw(args):
+    frame_size = args.pixels * 3
+    data = bytearray(args.input.read())
+    if len(data) % frame_size:
+        raise ValueError('%d bytes is not a whole number of frames' % len(data))
+
+    for start in range(0, len(data), frame_size):
+        chunk = data[start:start + frame_size]
+        yield [tuple(chunk[i:i + 3]) for i in range(0, frame_size, 3)]
+
+
+def encode_command(args):
+    if args.effect == 'raw':
+        pixels = args.pixels
+        frames = list(read_raw(args))
+    else:
+        pixels = args.width * args.height
+        frames = list({'fire': render_fire, 'rainbow': render_rainbow}[args.effect](args))
+
+    if not frames:
+        raise ValueError('no frames')
+
+    data = encode(frames, pixels, 1000 // args.fps)
+    args.output.write(data)
+
+    print('%d frames of %d pixels, %d bytes (%.1f%% of raw)' % (
+        len(frames), pixels, len(data), 100 * (len(data) - HEADER.size) / (len(frames) * pixels * 3)))
+
+
+def info_command(args):
+    frame_ms, pixels, frames, sizes = decode(bytearray(args.file.read()))
+    raw = pixels * 3
+    total = sum(sizes)
+
+    print('frames:      %d of %d pixels, %d ms apart (%.1f s)' % (
+        len(frames), pixels, frame_ms, len(frames) * frame_ms / 1000))
+    print('size:        %d bytes, %.1f%% of %d raw' % (
+        HEADER.size + total, 100 * total / (raw * len(frames)), raw * len(frames)))
+    print('frame bytes: %d min, %d avg, %d max (raw %d)' % (
+        min(sizes), total // len(sizes), max(sizes), raw))
+    print('bandwidth:   %d bytes/s from flash' % (total * 1000 // (frame_ms * len(frames))))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Pre-renders animations for flash_anim.')
+    commands = parser.add_subparsers(dest='command')
+
+    encode_parser = commands.add_parser('encode')
+    encode_parser.add_argument('effect', choices=['fire', 'rainbow', 'raw'])
+    encode_parser.add_argument('--width', type=int, default=6)
+    encode_parser.add_argument('--height', type=int, default=10)
+    encode_parser.add_argument('--pixels', type=int)
+    encode_parser.add_argument('--brightness', type=int, default=50)
+    encode_parser.add_argument('--fps', type=int, default=17)
+    encode_parser.add_argument('--seconds', type=float, default=60)
+    encode_parser.add_argument('--seed', type=int, default=0)
+    encode_parser.add_argument('--input', type=argparse.FileType('rb'))
+    encode_parser.add_argument('output', type=argparse.FileType('wb'))
+
+    info_parser = commands.add_parser('info')
+    info_parser.add_argument('file', type=argparse.FileType('rb'))
+
+    args = parser.parse_args()
+    if args.command == 'encode':
+        if args.effect == 'raw' and (not args.pixels or not args.input):
+            parser.error('raw needs --pixels and --input')
+        if args.effect != 'raw' and args.input:
+            parser.error('only raw takes --input')
+        if args.effect == 'fire' and not 0 < args.brightness <= 100:
+            parser.error('--brightness goes from 1 to 100')
+        encode_command(args)
+    elif args.command == 'info':
+        info_command(args)
+    else:
+        parser.print_help()
+        return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    try:
+        sys.exit(main())
+    except ValueError as e:
+        print('error: %s' % e, file=sys.stderr)
+        sys.exit(1)
@@ -0,0 +1,9 @@
+# Component makefile for frame_buffer
+
+# expected anyone using this component includes it as 'frame_buffer/frame_buffer.h'
+INC_DIRS += $(frame_buffer_ROOT)..
+
+# args for passing into compile rule generation
+frame_buffer_SRC_DIR = $(frame_buffer_ROOT)
+
+$(eval $(call component_compile_rules,frame_buffer))
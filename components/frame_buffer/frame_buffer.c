@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <espressif/esp_system.h>
+
+#include "frame_buffer.h"
+
+// Every bit takes 1.25us on the wire, a frame ends with 50us of low level
+#define BIT_NS 1250
+#define RESET_US 50
+
+
+int frame_buffer_init(frame_buffer_t *frames, uint16_t count, pixeltype_t type, ws2812_pixel_t *buffer) {
+    if (!count)
+        return -1;
+
+    if (!buffer) {
+        buffer = malloc(2 * count * sizeof(ws2812_pixel_t));
+        if (!buffer)
+            return -1;
+    }
+
+    frames->lock = xSemaphoreCreateMutexStatic(&frames->lock_buffer);
+    if (!frames->lock)
+        return -1;
+
+    memset(buffer, 0, 2 * count * sizeof(ws2812_pixel_t));
+    frames->buffers[0] = buffer;
+    frames->buffers[1] = buffer + count;
+    frames->count = count;
+    frames->type = type;
+    frames->back = 0;
+    frames->back_current = false;
+    frames->limit = NULL;
+
+    // type is the DMA size of a pixel (4 bytes per color byte), not
+    // what goes on the wire
+    uint32_t pixel_bits = type == PIXEL_RGBW ? 32 : 24;
+    frames->transfer_us = (uint32_t)count * pixel_bits * BIT_NS / 1000 + RESET_US;
+    frames->shown_at = sdk_system_get_time() - frames->transfer_us;
+    frames->frames = 0;
+    frames->waits = 0;
+
+    ws2812_i2s_init(count, type);
+
+    return 0;
+}
+
+ws2812_pixel_t *frame_buffer_begin(frame_buffer_t *frames, bool keep) {
+    xSemaphoreTake(frames->lock, portMAX_DELAY);
+
+    ws2812_pixel_t *back = frames->buffers[frames->back];
+    if (keep && !frames->back_current)
+        memcpy(back, frames->buffers[frames->back ^ 1], frames->count * sizeof(ws2812_pixel_t));
+
+    return back;
+}
+
+void frame_buffer_show(frame_buffer_t *frames) {
+    ws2812_pixel_t *back = frames->buffers[frames->back];
+    ws2812_pixel_t *shown = back;
+    if (frames->limit)
+        shown = power_limit_apply(frames->limit, back, frames->buffers[frames->back ^ 1], frames->count);
+
+    uint32_t elapsed = sdk_system_get_time() - frames->shown_at;
+    if (elapsed < frames->transfer_us) {
+        frames->waits++;
+
+        // Whole ticks are slept, the driver spins for the rest
+        TickType_t ticks = (frames->transfer_us - elapsed) / 1000 / portTICK_PERIOD_MS;
+        if (ticks)
+            vTaskDelay(ticks);
+    }
+
+    ws2812_i2s_update(shown, frames->type);
+    frames->shown_at = sdk_system_get_time();
+    frames->frames++;
+
+    // The frame on the wire becomes the front buffer, unless it was
+    // dimmed into the front buffer already
+    if (shown == back) {
+        frames->back ^= 1;
+        frames->back_current = false;
+    } else {
+        frames->back_current = true;
+    }
+
+    xSemaphoreGive(frames->lock);
+}
+
+void frame_buffer_end(frame_buffer_t *frames) {
+    frames->back_current = true;
+
+    xSemaphoreGive(frames->lock);
+}
+
+void frame_buffer_set_limit(frame_buffer_t *frames, power_limit_t *limit) {
+    xSemaphoreTake(frames->lock, portMAX_DELAY);
+    frames->limit = limit;
+    xSemaphoreGive(frames->lock);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+#include <semphr.h>
+#include <ws2812_i2s/ws2812_i2s.h>
+#include <power_limit/power_limit.h>
+
+/*
+ * Front and back pixel buffers for a ws2812 strip driven by ws2812_i2s.
+ *
+ * Whoever draws owns the back buffer between frame_buffer_begin() and
+ * frame_buffer_show(), other tasks wait in frame_buffer_begin(). The
+ * front buffer holds the frame that is on the wire.
+ *
+ * ws2812_i2s_update() encodes a frame into its own DMA buffer and
+ * returns while DMA streams it out, but the next update busy-waits
+ * until that transfer is over. frame_buffer_show() sleeps through
+ * the rest of the previous transfer instead, so the time goes to
+ * rendering the next frame and to other tasks.
+ *
+ * With a power limiter set, a frame that has to be dimmed is dimmed
+ * into the front buffer and the back buffer keeps the frame as drawn.
+ */
+
+typedef struct {
+    ws2812_pixel_t *buffers[2];
+    uint16_t count;
+    pixeltype_t type;
+    uint8_t back;               // index of the back buffer
+    bool back_current;          // back buffer holds the last frame drawn
+    power_limit_t *limit;       // NULL for no limit
+
+    SemaphoreHandle_t lock;     // held by the owner of the back buffer
+    StaticSemaphore_t lock_buffer;
+    uint32_t transfer_us;       // time to stream out one frame
+    uint32_t shown_at;          // system time the last transfer started
+
+    uint32_t frames;            // frames shown
+    uint32_t waits;             // frames that had to wait for the previous transfer
+} frame_buffer_t;
+
+/**
+    Initializes the ws2812_i2s driver and clears both buffers.
+
+    @param frames Frame buffer to initialize.
+    @param count Number of LEDs on the strip.
+    @param type Type of LEDs.
+    @param buffer Buffer for 2 * count pixels or NULL to allocate one.
+    @return A negative integer if this method fails.
+*/
+int frame_buffer_init(frame_buffer_t *frames, uint16_t count, pixeltype_t type, ws2812_pixel_t *buffer);
+
+/**
+    Takes ownership of the back buffer, waiting for the current owner
+    to show its frame.
+
+    @param frames Frame buffer.
+    @param keep true to start from the last frame drawn, false if
+                the whole frame is drawn anyway.
+    @return Back buffer to draw the next frame in.
+*/
+ws2812_pixel_t *frame_buffer_begin(frame_buffer_t *frames, bool keep);
+
+/**
+    Hands the back buffer over to the strip once the previous frame
+    has streamed out, and releases ownership.
+
+    @param frames Frame buffer.
+*/
+void frame_buffer_show(frame_buffer_t *frames);
+
+/**
+    Releases ownership of the back buffer without showing it. The next
+    owner that keeps the frame continues from what was drawn.
+
+    @param frames Frame buffer.
+*/
+void frame_buffer_end(frame_buffer_t *frames);
+
+/**
+    Sets the power limiter applied to every frame shown.
+
+    @param frames Frame buffer.
+    @param limit Initialized limiter or NULL for no limit.
+*/
+void frame_buffer_set_limit(frame_buffer_t *frames, power_limit_t *limit);
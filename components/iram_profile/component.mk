@@ -0,0 +1,21 @@
+# Component makefile for iram_profile
+
+# expected anyone using this component includes it as 'iram_profile/iram_profile.h'
+INC_DIRS += $(iram_profile_ROOT)..
+
+# args for passing into compile rule generation
+iram_profile_SRC_DIR = $(iram_profile_ROOT)
+
+# Set to 1 to count calls and time of every function of the program
+# and its components. The SDK and the big libraries are left out.
+IRAM_PROFILE ?= 0
+
+EXTRA_CFLAGS += -DIRAM_PROFILE_ENABLED=$(IRAM_PROFILE)
+
+ifeq ($(IRAM_PROFILE),1)
+EXTRA_CFLAGS += \
+	-finstrument-functions \
+	-finstrument-functions-exclude-file-list=$(SDK_PATH),components/homekit,components/wolfssl,components/cJSON,components/iram_profile
+endif
+
+$(eval $(call component_compile_rules,iram_profile))
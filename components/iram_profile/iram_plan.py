@@ -0,0 +1,197 @@
+#!/usr/bin/env python
+"""
+Turns a dump printed by iram_profile_dump() into an IRAM placement list,
+or compares the interrupt paths of two profiled builds.
+
+Usage:
+    iram_plan.py plan DUMP ELF [--budget BYTES] [--nm NM]
+    iram_plan.py compare BEFORE_DUMP BEFORE_ELF AFTER_DUMP AFTER_ELF [--nm NM]
+
+plan prints, for every profiled function:
+    KEEP     already in IRAM
+    ADD      in flash, move to IRAM (mark it IRAM in the source)
+    SKIP     in flash and worth moving, but over the budget
+    DEMOTE   in IRAM, but hardly used and not an interrupt path
+
+Interrupt paths are added first, then functions by CPU time spent in
+them per byte of code, until IRAM in use reaches the budget.
+
+If the log holds several dumps, their counts are added up.
+"""
+from __future__ import division, print_function
+
+import argparse
+import subprocess
+import sys
+
+IRAM_START = 0x40100000
+IRAM_END = 0x40108000
+IRAM_SIZE = IRAM_END - IRAM_START
+
+# Functions called less often than this per dump are DEMOTE candidates
+DEMOTE_CALLS = 10
+
+
+def read_dump(path):
+    functions = {}
+    mhz = 80
+    lost = 0
+
+    inside = False
+    with open(path) as lines:
+        for line in lines:
+            fields = line.split()
+            if fields[:2] == ['PROFILE', 'BEGIN']:
+                mhz = int(fields[2])
+                lost += int(fields[3])
+                inside = True
+            elif fields[:2] == ['PROFILE', 'END']:
+                inside = False
+            elif inside and fields and fields[0] == 'F':
+                address = int(fields[1], 16)
+                calls, cycles, max_cycles, interrupt = (int(x) for x in fields[2:6])
+
+                function = functions.setdefault(address, {
+                    'calls': 0, 'cycles': 0, 'max_cycles': 0, 'interrupt': False,
+                })
+                function['calls'] += calls
+                function['cycles'] += cycles
+                function['max_cycles'] = max(function['max_cycles'], max_cycles)
+                function['interrupt'] |= bool(interrupt)
+
+    return functions, mhz, lost
+
+
+def read_symbols(elf, nm):
+    output = subprocess.check_output([nm, '-S', '--defined-only', elf])
+
+    symbols = {}
+    iram_used = 0
+    for line in output.decode().splitlines():
+        fields = line.split()
+        if len(fields) != 4 or fields[2] not in 'tTwW':
+            continue
+
+        address, size, name = int(fields[0], 16), int(fields[1], 16), fields[3]
+        symbols[address] = (name, size)
+        if IRAM_START <= address < IRAM_END:
+            iram_used += size
+
+    return symbols, iram_used
+
+
+def in_iram(address):
+    return IRAM_START <= address < IRAM_END
+
+
+def plan(args):
+    functions, mhz, lost = read_dump(args.dump)
+    symbols, iram_used = read_symbols(args.elf, args.nm)
+
+    rows = []
+    for address, function in functions.items():
+        name, size = symbols.get(address, ('0x%08x' % address, 0))
+        rows.append((address, name, size, function))
+
+    def priority(row):
+        address, name, size, function = row
+        return (not function['interrupt'], -function['cycles'] / max(size, 1))
+
+    planned = iram_used
+    lines = []
+    for address, name, size, function in sorted(rows, key=priority):
+        if in_iram(address):
+            if function['calls'] < DEMOTE_CALLS and not function['interrupt']:
+                action = 'DEMOTE'
+            else:
+                action = 'KEEP'
+        elif planned + size <= args.budget:
+            action = 'ADD'
+            planned += size
+        else:
+            action = 'SKIP'
+
+        average_us = function['cycles'] / max(function['calls'], 1) / mhz
+        lines.append('%-7s %-40s %6d %10d %10.1f %10.1f %s' % (
+            action, name, size, function['calls'], average_us,
+            function['max_cycles'] / mhz, 'isr' if function['interrupt'] else '',
+        ))
+
+    print('# IRAM placement for %s' % args.elf)
+    print('# IRAM used %d bytes, %d after the plan, budget %d' % (iram_used, planned, args.budget))
+    if lost:
+        print('# %d calls of functions past IRAM_PROFILE_MAX_FUNCTIONS were not profiled' % lost)
+    print('%-7s %-40s %6s %10s %10s %10s' % ('#', 'function', 'size', 'calls', 'avg us', 'max us'))
+    for line in lines:
+        print(line)
+
+
+def interrupt_paths(dump, elf, nm):
+    functions, mhz, _ = read_dump(dump)
+    symbols, _ = read_symbols(elf, nm)
+
+    paths = {}
+    for address, function in functions.items():
+        if not function['interrupt']:
+            continue
+
+        name = symbols.get(address, ('0x%08x' % address, 0))[0]
+        paths[name] = (
+            function['cycles'] / max(function['calls'], 1) / mhz,
+            function['max_cycles'] / mhz,
+            in_iram(address),
+        )
+
+    return paths
+
+
+def compare(args):
+    before = interrupt_paths(args.before_dump, args.before_elf, args.nm)
+    after = interrupt_paths(args.after_dump, args.after_elf, args.nm)
+
+    def where(path):
+        return 'iram' if path[2] else 'flash'
+
+    print('%-40s %21s %21s' % ('# interrupt path', 'avg us before/after', 'max us before/after'))
+    for name in sorted(set(before) | set(after)):
+        b = before.get(name)
+        a = after.get(name)
+        print('%-40s %10s %10s %10s %10s  %s -> %s' % (
+            name,
+            '%.1f' % b[0] if b else '-', '%.1f' % a[0] if a else '-',
+            '%.1f' % b[1] if b else '-', '%.1f' % a[1] if a else '-',
+            where(b) if b else '-', where(a) if a else '-',
+        ))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Plans IRAM placement from iram_profile dumps.')
+    commands = parser.add_subparsers(dest='command')
+
+    plan_parser = commands.add_parser('plan')
+    plan_parser.add_argument('dump')
+    plan_parser.add_argument('elf')
+    plan_parser.add_argument('--budget', type=int, default=IRAM_SIZE,
+                             help='IRAM bytes the plan may use in total')
+
+    compare_parser = commands.add_parser('compare')
+    compare_parser.add_argument('before_dump')
+    compare_parser.add_argument('before_elf')
+    compare_parser.add_argument('after_dump')
+    compare_parser.add_argument('after_elf')
+
+    for command in (plan_parser, compare_parser):
+        command.add_argument('--nm', default='xtensa-lx106-elf-nm', help='nm of the toolchain')
+
+    args = parser.parse_args()
+    if args.command == 'plan':
+        plan(args)
+    elif args.command == 'compare':
+        compare(args)
+    else:
+        parser.print_help()
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+#include <esp8266.h>
+#include <espressif/esp_system.h>
+
+#include "iram_profile.h"
+
+#if IRAM_PROFILE_ENABLED
+
+#if IRAM_PROFILE_MAX_FUNCTIONS & (IRAM_PROFILE_MAX_FUNCTIONS - 1)
+#error IRAM_PROFILE_MAX_FUNCTIONS should be a power of 2
+#endif
+
+#define NO_PROFILE __attribute__((no_instrument_function))
+
+typedef struct {
+    void *function;
+    uint32_t start;
+} frame_t;
+
+
+static iram_profile_entry_t entries[IRAM_PROFILE_MAX_FUNCTIONS];
+static uint32_t lost = 0;           // calls of functions past the table
+
+static frame_t stack[IRAM_PROFILE_MAX_DEPTH];
+static uint8_t depth = 0;
+
+static volatile bool paused = false;
+
+
+static inline NO_PROFILE uint32_t ccount() {
+    uint32_t value;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (value));
+    return value;
+}
+
+static inline NO_PROFILE uint32_t irq_disable() {
+    uint32_t ps;
+    __asm__ volatile ("rsil %0, 15" : "=a" (ps) :: "memory");
+    return ps;
+}
+
+static inline NO_PROFILE void irq_restore(uint32_t ps) {
+    __asm__ volatile ("wsr %0, ps; rsync" :: "a" (ps) : "memory");
+}
+
+static NO_PROFILE IRAM iram_profile_entry_t *entry_find(void *function) {
+    uint32_t index = ((uint32_t)function >> 2) & (IRAM_PROFILE_MAX_FUNCTIONS - 1);
+
+    for (int i = 0; i < IRAM_PROFILE_MAX_FUNCTIONS; i++) {
+        iram_profile_entry_t *entry = &entries[index];
+        if (entry->function == function)
+            return entry;
+
+        if (!entry->function) {
+            entry->function = function;
+            return entry;
+        }
+
+        index = (index + 1) & (IRAM_PROFILE_MAX_FUNCTIONS - 1);
+    }
+
+    return NULL;
+}
+
+// Called by the compiler on entry of every instrumented function
+NO_PROFILE IRAM void __cyg_profile_func_enter(void *function, void *call_site) {
+    if (paused)
+        return;
+
+    uint32_t ps = irq_disable();
+
+    iram_profile_entry_t *entry = entry_find(function);
+    if (entry) {
+        entry->calls++;
+        // PS.INTLEVEL as it was before masking
+        if (ps & 0xF)
+            entry->interrupt = true;
+    } else {
+        lost++;
+    }
+
+    if (depth < IRAM_PROFILE_MAX_DEPTH) {
+        stack[depth].function = function;
+        stack[depth].start = ccount();
+        depth++;
+    }
+
+    irq_restore(ps);
+}
+
+// Called by the compiler on exit of every instrumented function
+NO_PROFILE IRAM void __cyg_profile_func_exit(void *function, void *call_site) {
+    if (paused)
+        return;
+
+    uint32_t ps = irq_disable();
+
+    // Frames above the function's own belong to other tasks that were
+    // preempted inside a call, they are dropped
+    int frame = depth - 1;
+    while (frame >= 0 && stack[frame].function != function)
+        frame--;
+
+    if (frame >= 0) {
+        uint32_t cycles = ccount() - stack[frame].start;
+        depth = frame;
+
+        iram_profile_entry_t *entry = entry_find(function);
+        if (entry) {
+            entry->cycles += cycles;
+            if (cycles > entry->max_cycles)
+                entry->max_cycles = cycles;
+        }
+    }
+
+    irq_restore(ps);
+}
+
+void iram_profile_dump() {
+    paused = true;
+
+    printf("PROFILE BEGIN %u %u\n", sdk_system_get_cpu_freq(), lost);
+    for (int i = 0; i < IRAM_PROFILE_MAX_FUNCTIONS; i++) {
+        iram_profile_entry_t *entry = &entries[i];
+        if (!entry->function)
+            continue;
+
+        printf("F %08x %u %u %u %d\n",
+               (uint32_t)entry->function, entry->calls,
+               entry->cycles, entry->max_cycles, entry->interrupt);
+    }
+    printf("PROFILE END\n");
+
+    memset(entries, 0, sizeof(entries));
+    lost = 0;
+    depth = 0;
+
+    paused = false;
+}
+
+#else
+
+void iram_profile_dump() {
+}
+
+#endif
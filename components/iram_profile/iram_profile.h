@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Function profiler for deciding which code belongs in IRAM.
+ *
+ * Code in flash runs through a 32KB cache, and a cache miss stalls
+ * the CPU while the line is read from flash. Code in IRAM never
+ * misses, but IRAM is small. Interrupt handlers have to be in IRAM
+ * anyway, since flash is not readable while it is being written.
+ *
+ * Build with IRAM_PROFILE=1 to instrument every function of the
+ * program. Each call is counted and timed in CPU cycles, so the time
+ * includes cache misses. Functions first entered with interrupts
+ * masked are flagged as interrupt paths. Then:
+ *
+ *     make IRAM_PROFILE=1 flash monitor | tee profile.txt
+ *     python ../../components/iram_profile/iram_plan.py plan profile.txt build/<program>.out
+ *
+ * prints which functions to move to IRAM within the IRAM budget, and
+ *
+ *     python ../../components/iram_profile/iram_plan.py compare \
+ *         before.txt before.out after.txt after.out
+ *
+ * compares the interrupt paths of two builds.
+ *
+ * Times of functions that block or get preempted include the time
+ * other tasks ran.
+ */
+
+#ifndef IRAM_PROFILE_ENABLED
+#define IRAM_PROFILE_ENABLED 0
+#endif
+
+// Maximum number of functions told apart
+#ifndef IRAM_PROFILE_MAX_FUNCTIONS
+#define IRAM_PROFILE_MAX_FUNCTIONS 128
+#endif
+
+// Maximum call depth that is timed
+#define IRAM_PROFILE_MAX_DEPTH 32
+
+typedef struct {
+    void *function;
+    uint32_t calls;
+    uint32_t cycles;            // total time spent, callees included
+    uint32_t max_cycles;
+    bool interrupt;             // entered with interrupts masked
+} iram_profile_entry_t;
+
+/**
+    Prints all profiled functions and clears the counts. Does nothing
+    unless built with IRAM_PROFILE=1.
+*/
+void iram_profile_dump();
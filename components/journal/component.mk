@@ -0,0 +1,21 @@
+# Component makefile for journal
+
+# expected anyone using this component includes it as 'journal/journal.h'
+INC_DIRS += $(journal_ROOT)..
+
+# args for passing into compile rule generation
+journal_SRC_DIR = $(journal_ROOT)
+
+# First flash sector of the journal, by default right after the
+# HomeKit storage and the wifi_fast cache
+JOURNAL_FLASH_ADDR ?= ($(HOMEKIT_SPI_FLASH_BASE_ADDR) + 0x2000)
+
+# Number of sectors the journal rotates through, at least 2.
+# More sectors spread the wear wider.
+JOURNAL_SECTORS ?= 2
+
+journal_CFLAGS = $(CFLAGS) \
+	-DJOURNAL_FLASH_ADDR='$(JOURNAL_FLASH_ADDR)' \
+	-DJOURNAL_SECTORS=$(JOURNAL_SECTORS)
+
+$(eval $(call component_compile_rules,journal))
@@ -0,0 +1,491 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <spiflash.h>
+#include <homekit/homekit.h>
+#include <static_alloc/static_alloc.h>
+
+#include "journal.h"
+
+#ifndef JOURNAL_FLASH_ADDR
+#error JOURNAL_FLASH_ADDR is not defined
+#endif
+
+#ifndef JOURNAL_SECTORS
+#define JOURNAL_SECTORS 2
+#endif
+
+#if JOURNAL_SECTORS < 2
+#error JOURNAL_SECTORS should be at least 2
+#endif
+
+#define SECTOR_SIZE 4096
+#define SECTOR_MAGIC 0x4A524E31
+
+#define RECORD_SIZE sizeof(journal_record_t)
+#define RECORDS_PER_SECTOR (int)((SECTOR_SIZE - sizeof(sector_header_t)) / RECORD_SIZE)
+
+#define EMPTY_KEY 0xFF
+
+#define POLL_INTERVAL_MS 250
+
+#define INFO(message, ...) printf(">>> journal: " message "\n", ##__VA_ARGS__);
+
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;          // sector with the highest one is current
+} sector_header_t;
+
+// Records are appended to erased flash, so a slot with all bits set
+// is free. Records that fail the check were cut by a power loss.
+typedef struct {
+    uint8_t key;
+    uint8_t size;
+    uint16_t check;
+    uint8_t value[JOURNAL_VALUE_SIZE];
+} journal_record_t;
+
+typedef struct {
+    uint8_t key;
+    uint8_t size;               // 0 if the entry is free
+    bool dirty;                 // changed since it was written to flash
+    uint8_t value[JOURNAL_VALUE_SIZE];
+} journal_entry_t;
+
+
+// Latest values, updated from tasks and interrupts
+static journal_entry_t entries[JOURNAL_MAX_KEYS];
+// Values being written, only used by the writer under journal_lock
+static journal_entry_t snapshot[JOURNAL_MAX_KEYS];
+
+static volatile bool pending = false;
+
+static uint8_t sector = 0;
+static uint32_t sequence = 0;
+static uint16_t next_record = 0;
+
+static journal_stats_t stats;
+
+STATIC_MUTEX(journal);
+STATIC_TASK(journal, 256);
+
+static SemaphoreHandle_t journal_lock = NULL;
+
+
+#ifdef __XTENSA__
+// Unlike taskENTER_CRITICAL these can be used in interrupt handlers,
+// which is where journal_set may be called from
+static inline uint32_t irq_disable() {
+    uint32_t ps;
+    __asm__ volatile ("rsil %0, 15" : "=a" (ps) :: "memory");
+    return ps;
+}
+
+static inline void irq_restore(uint32_t ps) {
+    __asm__ volatile ("wsr %0, ps; rsync" :: "a" (ps) : "memory");
+}
+#else
+// Host build of tests/, which runs on one thread
+static inline uint32_t irq_disable() {
+    return 0;
+}
+
+static inline void irq_restore(uint32_t ps) {
+}
+#endif
+
+static uint32_t sector_addr(uint8_t index) {
+    return JOURNAL_FLASH_ADDR + index * SECTOR_SIZE;
+}
+
+static uint32_t record_addr(uint16_t index) {
+    return sector_addr(sector) + sizeof(sector_header_t) + index * RECORD_SIZE;
+}
+
+static uint16_t record_check(const journal_record_t *record) {
+    // FNV-1a folded to 16 bits, never equal to erased flash
+    uint32_t h = 2166136261;
+    const uint8_t *data = (const uint8_t *)record;
+    for (int i = 0; i < RECORD_SIZE; i++) {
+        if (i == offsetof(journal_record_t, check)) {
+            i += sizeof(record->check) - 1;
+            continue;
+        }
+        h ^= data[i];
+        h *= 16777619;
+    }
+    h = (h >> 16) ^ (h & 0xFFFF);
+    return (h == 0xFFFF) ? 0 : h;
+}
+
+static bool record_empty(const journal_record_t *record) {
+    const uint8_t *data = (const uint8_t *)record;
+    for (int i = 0; i < RECORD_SIZE; i++) {
+        if (data[i] != 0xFF)
+            return false;
+    }
+    return true;
+}
+
+static journal_entry_t *entry_find(uint8_t key) {
+    for (int i = 0; i < JOURNAL_MAX_KEYS; i++) {
+        if (entries[i].size && entries[i].key == key)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+static journal_entry_t *entry_add(uint8_t key) {
+    journal_entry_t *entry = entry_find(key);
+    if (entry)
+        return entry;
+
+    for (int i = 0; i < JOURNAL_MAX_KEYS; i++) {
+        if (!entries[i].size) {
+            entries[i].key = key;
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static bool record_write(const journal_entry_t *entry) {
+    journal_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.key = entry->key;
+    record.size = entry->size;
+    memcpy(record.value, entry->value, entry->size);
+    record.check = record_check(&record);
+
+    if (!spiflash_write(record_addr(next_record), (uint8_t *)&record, sizeof(record)))
+        return false;
+
+    next_record++;
+    stats.records++;
+    return true;
+}
+
+// Moves all values into the next sector. The header is written last,
+// so until it is there the old sector stays current.
+static bool journal_compact() {
+    uint8_t old_sector = sector;
+    uint16_t old_next_record = next_record;
+    uint8_t next_sector = (sector + 1) % JOURNAL_SECTORS;
+
+    if (!spiflash_erase_sector(sector_addr(next_sector)))
+        return false;
+    stats.erases++;
+
+    sector = next_sector;
+    next_record = 0;
+
+    bool written = true;
+    for (int i = 0; i < JOURNAL_MAX_KEYS && written; i++) {
+        if (snapshot[i].size)
+            written = record_write(&snapshot[i]);
+    }
+
+    if (written) {
+        sector_header_t header = {
+            .magic = SECTOR_MAGIC,
+            .sequence = sequence + 1,
+        };
+        written = spiflash_write(sector_addr(sector), (uint8_t *)&header, sizeof(header));
+    }
+
+    if (!written) {
+        // the old sector is still current, the next write compacts again
+        sector = old_sector;
+        next_record = old_next_record;
+        return false;
+    }
+
+    sequence++;
+    return true;
+}
+
+static void journal_load() {
+    sector_header_t header;
+    bool found = false;
+
+    for (int i = 0; i < JOURNAL_SECTORS; i++) {
+        if (!spiflash_read(sector_addr(i), (uint8_t *)&header, sizeof(header)))
+            continue;
+
+        if (header.magic != SECTOR_MAGIC)
+            continue;
+
+        if (!found || (int32_t)(header.sequence - sequence) > 0) {
+            found = true;
+            sector = i;
+            sequence = header.sequence;
+        }
+    }
+
+    if (!found) {
+        INFO("No journal found");
+        // Start with a fresh sector on the first write
+        sector = JOURNAL_SECTORS - 1;
+        next_record = RECORDS_PER_SECTOR;
+        return;
+    }
+
+    journal_record_t record;
+    int corrupted = 0;
+    for (next_record = 0; next_record < RECORDS_PER_SECTOR; next_record++) {
+        if (!spiflash_read(record_addr(next_record), (uint8_t *)&record, sizeof(record)))
+            break;
+
+        if (record_empty(&record))
+            break;
+
+        if (record.check != record_check(&record) ||
+                !record.size || record.size > JOURNAL_VALUE_SIZE) {
+            corrupted++;
+            continue;
+        }
+
+        journal_entry_t *entry = entry_add(record.key);
+        if (!entry)
+            continue;
+
+        entry->size = record.size;
+        memcpy(entry->value, record.value, record.size);
+    }
+
+    INFO("Loaded sector %d, %d of %d records used, %d corrupted",
+         sector, next_record, RECORDS_PER_SECTOR, corrupted);
+}
+
+// Clears the dirty flag once the value in flash is the latest one.
+// The value may have changed again while it was being written.
+static void entry_written(int index) {
+    uint32_t ps = irq_disable();
+    journal_entry_t *entry = &entries[index];
+    if (entry->size == snapshot[index].size &&
+            !memcmp(entry->value, snapshot[index].value, entry->size))
+        entry->dirty = false;
+    irq_restore(ps);
+}
+
+static void journal_write() {
+    xSemaphoreTake(journal_lock, portMAX_DELAY);
+
+    uint32_t ps = irq_disable();
+    pending = false;
+    memcpy(snapshot, entries, sizeof(snapshot));
+    irq_restore(ps);
+
+    bool written = true;
+    for (int i = 0; i < JOURNAL_MAX_KEYS; i++) {
+        if (!snapshot[i].dirty)
+            continue;
+
+        if (next_record >= RECORDS_PER_SECTOR) {
+            // compaction writes all values, the dirty ones included
+            written = journal_compact();
+            if (!written) {
+                INFO("Failed to compact journal");
+                break;
+            }
+
+            for (int j = 0; j < JOURNAL_MAX_KEYS; j++) {
+                if (snapshot[j].dirty)
+                    entry_written(j);
+            }
+            break;
+        }
+
+        written = record_write(&snapshot[i]);
+        if (!written) {
+            INFO("Failed to write record");
+            break;
+        }
+        entry_written(i);
+    }
+
+    // Values that did not make it stay dirty and are tried again
+    if (!written)
+        pending = true;
+
+    xSemaphoreGive(journal_lock);
+}
+
+// journal_set may be called from interrupts, e.g. by button handlers,
+// so the writer polls for changes instead of being notified, and
+// times them itself by watching the change counter
+static void journal_task(void *_args) {
+    bool waiting = false;
+    uint32_t changes = 0;
+    TickType_t first_change = 0;
+    TickType_t last_change = 0;
+
+    while (1) {
+        vTaskDelay(POLL_INTERVAL_MS / portTICK_PERIOD_MS);
+
+        if (!pending) {
+            waiting = false;
+            continue;
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if (!waiting) {
+            waiting = true;
+            first_change = last_change = now;
+            changes = stats.changes;
+        } else if (stats.changes != changes) {
+            last_change = now;
+            changes = stats.changes;
+        }
+
+        if (now - last_change >= JOURNAL_DEBOUNCE_MS / portTICK_PERIOD_MS ||
+                now - first_change >= JOURNAL_MAX_DELAY_MS / portTICK_PERIOD_MS) {
+            journal_write();
+            waiting = false;
+        }
+    }
+}
+
+int journal_init() {
+    journal_lock = STATIC_MUTEX_CREATE(journal);
+    if (!journal_lock)
+        return -1;
+
+    journal_load();
+
+    if (!STATIC_TASK_CREATE(journal, journal_task, "Journal", NULL, 1))
+        return -1;
+
+    return 0;
+}
+
+int journal_get(uint8_t key, void *value, uint8_t size) {
+    int result = -1;
+
+    uint32_t ps = irq_disable();
+    journal_entry_t *entry = entry_find(key);
+    if (entry) {
+        result = (size < entry->size) ? size : entry->size;
+        memcpy(value, entry->value, result);
+    }
+    irq_restore(ps);
+
+    return result;
+}
+
+int journal_set(uint8_t key, const void *value, uint8_t size) {
+    if (key == EMPTY_KEY || !size || size > JOURNAL_VALUE_SIZE)
+        return -1;
+
+    int result = 0;
+
+    uint32_t ps = irq_disable();
+    journal_entry_t *entry = entry_add(key);
+    if (!entry) {
+        result = -1;
+    } else if (entry->size != size || memcmp(entry->value, value, size)) {
+        entry->size = size;
+        memcpy(entry->value, value, size);
+        entry->dirty = true;
+        stats.changes++;
+        pending = true;
+    }
+    irq_restore(ps);
+
+    return result;
+}
+
+int journal_restore(uint8_t key, homekit_characteristic_t *ch) {
+    switch (ch->format) {
+        case homekit_format_bool: {
+            bool value;
+            if (journal_get(key, &value, sizeof(value)) < 0)
+                return -1;
+            ch->value = HOMEKIT_BOOL(value);
+            break;
+        }
+        case homekit_format_uint8:
+        case homekit_format_uint16:
+        case homekit_format_uint32:
+        case homekit_format_int: {
+            int value;
+            if (journal_get(key, &value, sizeof(value)) < 0)
+                return -1;
+            ch->value.format = ch->format;
+            ch->value.is_null = false;
+            ch->value.int_value = value;
+            break;
+        }
+        case homekit_format_float: {
+            float value;
+            if (journal_get(key, &value, sizeof(value)) < 0)
+                return -1;
+            ch->value = HOMEKIT_FLOAT(value);
+            break;
+        }
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+int journal_save(uint8_t key, const homekit_characteristic_t *ch) {
+    switch (ch->format) {
+        case homekit_format_bool:
+            return journal_set(key, &ch->value.bool_value, sizeof(ch->value.bool_value));
+        case homekit_format_uint8:
+        case homekit_format_uint16:
+        case homekit_format_uint32:
+        case homekit_format_int:
+            return journal_set(key, &ch->value.int_value, sizeof(ch->value.int_value));
+        case homekit_format_float:
+            return journal_set(key, &ch->value.float_value, sizeof(ch->value.float_value));
+        default:
+            return -1;
+    }
+}
+
+void journal_flush() {
+    journal_write();
+}
+
+void journal_reset() {
+    xSemaphoreTake(journal_lock, portMAX_DELAY);
+
+    for (int i = 0; i < JOURNAL_SECTORS; i++) {
+        spiflash_erase_sector(sector_addr(i));
+        stats.erases++;
+    }
+    uint32_t ps = irq_disable();
+    memset(entries, 0, sizeof(entries));
+    pending = false;
+    irq_restore(ps);
+
+    sector = JOURNAL_SECTORS - 1;
+    next_record = RECORDS_PER_SECTOR;
+
+    xSemaphoreGive(journal_lock);
+}
+
+const journal_stats_t *journal_stats() {
+    return &stats;
+}
+
+void journal_stats_dump() {
+    uint32_t written = stats.records * RECORD_SIZE + stats.erases * SECTOR_SIZE;
+
+    INFO("%u changes, %u records written, %u sectors erased",
+         stats.changes, stats.records, stats.erases);
+    if (stats.changes) {
+        // each change carries JOURNAL_VALUE_SIZE bytes of payload
+        INFO("Write amplification %u.%02u",
+             written / (stats.changes * JOURNAL_VALUE_SIZE),
+             written * 100 / (stats.changes * JOURNAL_VALUE_SIZE) % 100);
+    }
+    INFO("Sector %d, %d of %d records used",
+         sector, next_record, RECORDS_PER_SECTOR);
+}
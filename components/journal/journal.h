@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <homekit/types.h>
+
+/*
+ * Journal keeps small values, like characteristic states, in flash
+ * so they survive a reboot.
+ *
+ * Every change is appended as a record to the current flash sector,
+ * and the sector is only erased once it is full and the latest
+ * values are moved to the next one. Sectors are used in turn, so
+ * the wear is spread over all of them.
+ *
+ * Changes are not written right away: the journal waits until values
+ * stop changing for JOURNAL_DEBOUNCE_MS, so dragging a slider in the
+ * Home app only writes the value it ends up with.
+ */
+
+// Maximum number of distinct keys
+#define JOURNAL_MAX_KEYS 32
+
+// Maximum size of a value
+#define JOURNAL_VALUE_SIZE 4
+
+#ifndef JOURNAL_DEBOUNCE_MS
+#define JOURNAL_DEBOUNCE_MS 2000
+#endif
+
+// Changes are written at the latest this long after the first
+// one, even if values keep changing
+#ifndef JOURNAL_MAX_DELAY_MS
+#define JOURNAL_MAX_DELAY_MS 10000
+#endif
+
+typedef struct {
+    uint32_t changes;           // journal_set calls that changed a value
+    uint32_t records;           // records written to flash
+    uint32_t erases;            // sectors erased
+} journal_stats_t;
+
+/**
+    Loads the latest values from flash and starts the writer task.
+    Call it before any other journal function.
+
+    @return A negative integer if this method fails.
+*/
+int journal_init();
+
+/**
+    Reads the latest value of a key.
+
+    @param key Key, 0 to 254.
+    @param value Buffer for the value.
+    @param size Size of the buffer.
+    @return Size of the value or a negative integer if the key is not in the journal.
+*/
+int journal_get(uint8_t key, void *value, uint8_t size);
+
+/**
+    Sets the value of a key. The value is written to flash later.
+    Safe to call from interrupt handlers.
+
+    @param key Key, 0 to 254.
+    @param value Value to store.
+    @param size Size of the value, at most JOURNAL_VALUE_SIZE.
+    @return A negative integer if this method fails.
+*/
+int journal_set(uint8_t key, const void *value, uint8_t size);
+
+/**
+    Sets characteristic's value from the journal, so call it before
+    homekit_server_init. Bool, integer and float characteristics are
+    supported.
+
+    @return A negative integer if the key is not in the journal.
+*/
+int journal_restore(uint8_t key, homekit_characteristic_t *ch);
+
+/**
+    Stores characteristic's current value under the key.
+
+    @return A negative integer if this method fails.
+*/
+int journal_save(uint8_t key, const homekit_characteristic_t *ch);
+
+/**
+    Writes pending changes to flash right away, e.g. before a restart.
+*/
+void journal_flush();
+
+/**
+    Forgets all values.
+*/
+void journal_reset();
+
+const journal_stats_t *journal_stats();
+
+/**
+    Prints flash usage and how many bytes were written per change.
+*/
+void journal_stats_dump();
@@ -0,0 +1,15 @@
+# Component makefile for logger
+
+# expected anyone using this component includes it as 'logger/logger.h'
+INC_DIRS += $(logger_ROOT)..
+
+# args for passing into compile rule generation
+logger_SRC_DIR = $(logger_ROOT)
+
+# Most verbose level compiled in: 0 none, 1 error, 2 warning, 3 info, 4 debug.
+# Calls above it compile to nothing, arguments included.
+LOGGER_LEVEL ?= 3
+
+EXTRA_CFLAGS += -DLOGGER_LEVEL=$(LOGGER_LEVEL)
+
+$(eval $(call component_compile_rules,logger))
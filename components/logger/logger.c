@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <esp/uart.h>
+#include <esp/iomux.h>
+#include <espressif/esp_system.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <static_alloc/static_alloc.h>
+
+#include "logger.h"
+
+#if LOGGER_QUEUE_SIZE & (LOGGER_QUEUE_SIZE - 1)
+#error LOGGER_QUEUE_SIZE should be a power of 2
+#endif
+
+#if LOGGER_TEXT_SIZE & (LOGGER_TEXT_SIZE - 1)
+#error LOGGER_TEXT_SIZE should be a power of 2
+#endif
+
+// How often the task looks for new records
+#define LOGGER_POLL_MS 50
+
+#ifndef LOGGER_BAUD
+#define LOGGER_BAUD 115200
+#endif
+
+
+typedef struct {
+    uint32_t time;              // CPU cycles when queued, microseconds since boot once popped
+    const char *format;
+    uint32_t args[LOGGER_MAX_ARGS];
+    uint8_t level;
+} logger_record_t;
+
+static logger_record_t queue[LOGGER_QUEUE_SIZE];
+static uint32_t queue_head = 0;     // total number of records queued
+static uint32_t queue_tail = 0;     // total number of records formatted
+
+static char text[LOGGER_TEXT_SIZE];
+static uint32_t text_head = 0;      // total number of bytes formatted
+static uint32_t sink_tail = 0;      // total number of bytes sent to the sink
+
+static logger_sink_t sink = LOGGER_SINK_NONE;
+static logger_stats_t stats;
+
+static const char level_letters[] = "-EWID";
+
+
+static inline uint32_t ccount() {
+    uint32_t value;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (value));
+    return value;
+}
+
+// Unlike taskENTER_CRITICAL these can be used in interrupt handlers
+static inline uint32_t irq_disable() {
+    uint32_t ps;
+    __asm__ volatile ("rsil %0, 15" : "=a" (ps) :: "memory");
+    return ps;
+}
+
+static inline void irq_restore(uint32_t ps) {
+    __asm__ volatile ("wsr %0, ps; rsync" :: "a" (ps) : "memory");
+}
+
+void logger_record(uint8_t level, const char *format, const uint32_t *args) {
+    uint32_t time = ccount();
+
+    uint32_t ps = irq_disable();
+    uint32_t pending = queue_head - queue_tail;
+    if (pending < LOGGER_QUEUE_SIZE) {
+        logger_record_t *record = &queue[queue_head++ & (LOGGER_QUEUE_SIZE - 1)];
+        record->time = time;
+        record->format = format;
+        record->level = level;
+        memcpy(record->args, args, sizeof(record->args));
+
+        if (pending + 1 > stats.max_pending)
+            stats.max_pending = pending + 1;
+    } else {
+        stats.dropped++;
+    }
+    irq_restore(ps);
+}
+
+static bool logger_pop(logger_record_t *record) {
+    bool popped = false;
+
+    uint32_t ps = irq_disable();
+    if (queue_tail != queue_head) {
+        *record = queue[queue_tail++ & (LOGGER_QUEUE_SIZE - 1)];
+        popped = true;
+    }
+    irq_restore(ps);
+
+    if (popped) {
+        // Cycles are counted back from now, which is right as long as
+        // the record waited less than one wrap of ccount (26 s at 160 MHz)
+        uint32_t cycles = ccount() - record->time;
+        record->time = sdk_system_get_time() - cycles / sdk_system_get_cpu_freq();
+    }
+
+    return popped;
+}
+
+static void logger_append(const char *line, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        text[text_head++ & (LOGGER_TEXT_SIZE - 1)] = line[i];
+    }
+}
+
+static void logger_format(const logger_record_t *record) {
+    static char line[LOGGER_LINE_SIZE];
+
+    int length = snprintf(
+        line, sizeof(line), "%u.%03u %c ",
+        record->time / 1000000, record->time / 1000 % 1000,
+        level_letters[record->level < LOGGER_LEVEL_DEBUG ? record->level : LOGGER_LEVEL_DEBUG]
+    );
+    length += snprintf(
+        line + length, sizeof(line) - length, record->format,
+        record->args[0], record->args[1], record->args[2], record->args[3]
+    );
+    if (length > (int)sizeof(line) - 2)
+        length = sizeof(line) - 2;
+    line[length++] = '\n';
+
+    logger_append(line, length);
+    stats.logged++;
+}
+
+static void logger_drain() {
+    if (sink == LOGGER_SINK_NONE)
+        return;
+
+    if (text_head - sink_tail > LOGGER_TEXT_SIZE) {
+        stats.lost_bytes += text_head - sink_tail - LOGGER_TEXT_SIZE;
+        sink_tail = text_head - LOGGER_TEXT_SIZE;
+    }
+
+    int uart = (sink == LOGGER_SINK_UART1) ? 1 : 0;
+    while (sink_tail != text_head) {
+        // waits while the UART FIFO is full, which only delays this task
+        uart_putc(uart, text[sink_tail++ & (LOGGER_TEXT_SIZE - 1)]);
+    }
+}
+
+STATIC_TASK(logger, 384);
+
+static void logger_task(void *_args) {
+    logger_record_t record;
+
+    while (1) {
+        while (logger_pop(&record)) {
+            logger_format(&record);
+        }
+        logger_drain();
+
+        vTaskDelay(LOGGER_POLL_MS / portTICK_PERIOD_MS);
+    }
+}
+
+int logger_init(logger_sink_t _sink) {
+    sink = _sink;
+
+    if (sink == LOGGER_SINK_UART1) {
+        gpio_set_iomux_function(2, IOMUX_GPIO2_FUNC_UART1_TXD);
+        uart_set_baud(1, LOGGER_BAUD);
+    }
+
+    if (!STATIC_TASK_CREATE(logger, logger_task, "Logger", NULL, 1))
+        return -1;
+
+    return 0;
+}
+
+size_t logger_read(uint32_t *position, char *buffer, size_t size) {
+    // text_head only grows in the logger task, a stale value just
+    // means the newest line is read on the next call
+    uint32_t head = text_head;
+
+    if (head - *position > LOGGER_TEXT_SIZE)
+        *position = head - LOGGER_TEXT_SIZE;
+
+    size_t count = 0;
+    while (count < size && *position != head) {
+        buffer[count++] = text[(*position)++ & (LOGGER_TEXT_SIZE - 1)];
+    }
+
+    return count;
+}
+
+const logger_stats_t *logger_stats() {
+    return &stats;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Deferred logger.
+ *
+ * LOG_* calls only store the format string pointer and the raw
+ * arguments into a queue, which takes a few microseconds, never
+ * blocks and is safe from interrupt handlers. A low priority task
+ * formats queued records later into a RAM ring of text and drains it
+ * to the configured sink.
+ *
+ * Because formatting is deferred:
+ * - the format string and any %s argument must stay valid, string
+ *   literals are fine;
+ * - at most LOGGER_MAX_ARGS arguments are stored, as 32 bit integers.
+ *   Convert floats to a scaled integer first, e.g. (int32_t)(value * 10),
+ *   a negative float does not convert to uint32_t.
+ *   Pointers need a (uint32_t) cast.
+ *
+ * Levels above LOGGER_LEVEL (see component.mk) are compiled out.
+ */
+
+#define LOGGER_LEVEL_NONE 0
+#define LOGGER_LEVEL_ERROR 1
+#define LOGGER_LEVEL_WARNING 2
+#define LOGGER_LEVEL_INFO 3
+#define LOGGER_LEVEL_DEBUG 4
+
+#ifndef LOGGER_LEVEL
+#define LOGGER_LEVEL LOGGER_LEVEL_INFO
+#endif
+
+#define LOGGER_MAX_ARGS 4
+
+// Number of records waiting to be formatted, a power of 2
+#ifndef LOGGER_QUEUE_SIZE
+#define LOGGER_QUEUE_SIZE 16
+#endif
+
+// Bytes of formatted text kept in RAM, a power of 2
+#ifndef LOGGER_TEXT_SIZE
+#define LOGGER_TEXT_SIZE 1024
+#endif
+
+// Longest formatted line, longer ones are cut
+#define LOGGER_LINE_SIZE 96
+
+typedef enum {
+    LOGGER_SINK_NONE = 0,       // only keep the text in RAM, see logger_read()
+    LOGGER_SINK_UART0,
+    LOGGER_SINK_UART1,          // TX only, on GPIO2
+} logger_sink_t;
+
+typedef struct {
+    uint32_t logged;            // records formatted
+    uint32_t dropped;           // records lost to a full queue
+    uint32_t lost_bytes;        // text overwritten before the sink got it
+    uint16_t max_pending;       // most records waiting at once
+} logger_stats_t;
+
+#define LOGGER_RECORD(level, format, ...) \
+    logger_record(level, format, (const uint32_t[LOGGER_MAX_ARGS]){__VA_ARGS__})
+
+#if LOGGER_LEVEL >= LOGGER_LEVEL_ERROR
+#define LOG_ERROR(format, ...) LOGGER_RECORD(LOGGER_LEVEL_ERROR, format, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(format, ...) do {} while (0)
+#endif
+
+#if LOGGER_LEVEL >= LOGGER_LEVEL_WARNING
+#define LOG_WARNING(format, ...) LOGGER_RECORD(LOGGER_LEVEL_WARNING, format, ##__VA_ARGS__)
+#else
+#define LOG_WARNING(format, ...) do {} while (0)
+#endif
+
+#if LOGGER_LEVEL >= LOGGER_LEVEL_INFO
+#define LOG_INFO(format, ...) LOGGER_RECORD(LOGGER_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define LOG_INFO(format, ...) do {} while (0)
+#endif
+
+#if LOGGER_LEVEL >= LOGGER_LEVEL_DEBUG
+#define LOG_DEBUG(format, ...) LOGGER_RECORD(LOGGER_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(format, ...) do {} while (0)
+#endif
+
+/**
+    Starts the task that formats and drains the log. Records logged
+    before it starts are kept in the queue.
+
+    @param sink Where the formatted text goes.
+    @return A negative integer if this method fails.
+*/
+int logger_init(logger_sink_t sink);
+
+/**
+    Queues a record. Use the LOG_* macros instead, so levels can be
+    compiled out.
+*/
+void logger_record(uint8_t level, const char *format, const uint32_t *args);
+
+/**
+    Copies formatted text out of the RAM ring, for reading the log
+    back without a serial console.
+
+    @param position Offset to read from, updated past the copied text.
+           Start with 0; text that has already been overwritten is
+           skipped.
+    @param buffer Buffer for the text, it is not NUL terminated.
+    @param size Size of the buffer.
+    @return Number of bytes copied.
+*/
+size_t logger_read(uint32_t *position, char *buffer, size_t size);
+
+const logger_stats_t *logger_stats();
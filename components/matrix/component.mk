@@ -0,0 +1,9 @@
+# Component makefile for matrix
+
+# expected anyone using this component includes it as 'matrix/matrix.h'
+INC_DIRS += $(matrix_ROOT)..
+
+# args for passing into compile rule generation
+matrix_SRC_DIR = $(matrix_ROOT)
+
+$(eval $(call component_compile_rules,matrix))
@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include "matrix.h"
+
+
+// Strip index of a LED within a tile
+static uint16_t tile_index(const matrix_config_t *config, uint16_t x, uint16_t y) {
+    uint16_t line, pos, length;
+    if (config->layout & MATRIX_COLUMN_MAJOR) {
+        line = x; pos = y; length = config->height;
+    } else {
+        line = y; pos = x; length = config->width;
+    }
+
+    if ((config->layout & MATRIX_SERPENTINE) && (line & 1))
+        pos = length - pos - 1;
+
+    return line * length + pos;
+}
+
+int matrix_init(matrix_t *matrix, const matrix_config_t *config, uint16_t *map) {
+    if (!config->width || !config->height)
+        return -1;
+
+    uint16_t tiles_x = config->tiles_x ? config->tiles_x : 1;
+    uint16_t tiles_y = config->tiles_y ? config->tiles_y : 1;
+    uint16_t tile_size = config->width * config->height;
+
+    // physical size of the panel
+    uint16_t width = config->width * tiles_x;
+    uint16_t height = config->height * tiles_y;
+
+    if (!map) {
+        map = malloc(width * height * sizeof(uint16_t));
+        if (!map)
+            return -1;
+    }
+
+    bool swap = (config->rotation == MATRIX_ROTATE_90 || config->rotation == MATRIX_ROTATE_270);
+    matrix->width = swap ? height : width;
+    matrix->height = swap ? width : height;
+    matrix->map = map;
+
+    for (uint16_t y = 0; y < matrix->height; y++) {
+        for (uint16_t x = 0; x < matrix->width; x++) {
+            uint16_t px, py;
+            switch (config->rotation) {
+                case MATRIX_ROTATE_90:
+                    px = y; py = height - x - 1;
+                    break;
+                case MATRIX_ROTATE_180:
+                    px = width - x - 1; py = height - y - 1;
+                    break;
+                case MATRIX_ROTATE_270:
+                    px = width - y - 1; py = x;
+                    break;
+                default:
+                    px = x; py = y;
+                    break;
+            }
+
+            uint16_t tile = (py / config->height) * tiles_x + px / config->width;
+            map[y * matrix->width + x] = tile * tile_size +
+                tile_index(config, px % config->width, py % config->height);
+        }
+    }
+
+    return 0;
+}
+
+void matrix_fill_row(const matrix_t *matrix, ws2812_pixel_t *pixels, uint16_t y, ws2812_pixel_t color) {
+    if (y >= matrix->height)
+        return;
+
+    const uint16_t *row = &matrix->map[y * matrix->width];
+    for (uint16_t x = 0; x < matrix->width; x++)
+        pixels[row[x]] = color;
+}
+
+void matrix_fill_column(const matrix_t *matrix, ws2812_pixel_t *pixels, uint16_t x, ws2812_pixel_t color) {
+    if (x >= matrix->width)
+        return;
+
+    const uint16_t *index = &matrix->map[x];
+    for (uint16_t y = 0; y < matrix->height; y++, index += matrix->width)
+        pixels[*index] = color;
+}
+
+void matrix_fill_rect(const matrix_t *matrix, ws2812_pixel_t *pixels,
+                      uint16_t x, uint16_t y, uint16_t width, uint16_t height,
+                      ws2812_pixel_t color)
+{
+    if (x >= matrix->width || y >= matrix->height)
+        return;
+
+    if (width > matrix->width - x)
+        width = matrix->width - x;
+    if (height > matrix->height - y)
+        height = matrix->height - y;
+
+    for (uint16_t j = 0; j < height; j++) {
+        const uint16_t *row = &matrix->map[(y + j) * matrix->width + x];
+        for (uint16_t i = 0; i < width; i++)
+            pixels[row[i]] = color;
+    }
+}
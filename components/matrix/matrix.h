@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <ws2812_i2s/ws2812_i2s.h>
+
+/*
+ * Maps 2D coordinates of an LED panel to indexes on the strip.
+ *
+ * The whole (x, y) -> index map is computed once in matrix_init(),
+ * so drawing on any layout costs one table read per pixel and no
+ * per-pixel branching on the wiring of the panel.
+ *
+ * Coordinate (0, 0) is the corner where the first LED of the
+ * (first tile of the) panel is, before rotation.
+ */
+
+typedef enum {
+    MATRIX_ROW_MAJOR = 0,           // LEDs are chained along rows
+    MATRIX_COLUMN_MAJOR = (1 << 0), // LEDs are chained along columns
+    MATRIX_SERPENTINE = (1 << 1),   // every other row (column) runs backwards
+} matrix_layout_t;
+
+typedef enum {
+    MATRIX_ROTATE_0 = 0,
+    MATRIX_ROTATE_90,
+    MATRIX_ROTATE_180,
+    MATRIX_ROTATE_270,
+} matrix_rotation_t;
+
+typedef struct {
+    uint8_t width;          // size of a tile in LEDs
+    uint8_t height;
+    uint8_t tiles_x;        // tiles are chained row by row, 0 means 1
+    uint8_t tiles_y;
+    uint8_t layout;         // layout of LEDs within a tile, see matrix_layout_t
+    uint8_t rotation;       // see matrix_rotation_t
+} matrix_config_t;
+
+typedef struct {
+    uint16_t width;         // size of the panel after rotation
+    uint16_t height;
+    uint16_t *map;          // strip index of LED at (x, y) is map[y * width + x]
+} matrix_t;
+
+/**
+    Computes coordinates map for the given layout.
+
+    @param matrix Matrix to initialize.
+    @param config Layout of the panel.
+    @param map Buffer for width * height indexes or NULL to allocate one.
+    @return A negative integer if this method fails.
+*/
+int matrix_init(matrix_t *matrix, const matrix_config_t *config, uint16_t *map);
+
+static inline uint16_t matrix_index(const matrix_t *matrix, uint16_t x, uint16_t y) {
+    return matrix->map[y * matrix->width + x];
+}
+
+static inline void matrix_set(const matrix_t *matrix, ws2812_pixel_t *pixels,
+                              uint16_t x, uint16_t y, ws2812_pixel_t color) {
+    pixels[matrix_index(matrix, x, y)] = color;
+}
+
+void matrix_fill_row(const matrix_t *matrix, ws2812_pixel_t *pixels, uint16_t y, ws2812_pixel_t color);
+void matrix_fill_column(const matrix_t *matrix, ws2812_pixel_t *pixels, uint16_t x, ws2812_pixel_t color);
+
+/**
+    Fills a rectangle, clipped to the panel.
+*/
+void matrix_fill_rect(const matrix_t *matrix, ws2812_pixel_t *pixels,
+                      uint16_t x, uint16_t y, uint16_t width, uint16_t height,
+                      ws2812_pixel_t color);
@@ -0,0 +1,9 @@
+# Component makefile for palette
+
+# expected anyone using this component includes it as 'palette/palette.h'
+INC_DIRS += $(palette_ROOT)..
+
+# args for passing into compile rule generation
+palette_SRC_DIR = $(palette_ROOT)
+
+$(eval $(call component_compile_rules,palette))
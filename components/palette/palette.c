@@ -0,0 +1,115 @@
+#include <stdbool.h>
+#include "palette.h"
+
+
+// Division rounds towards a, so amount 0 gives a also when b < a
+static uint8_t mix(uint8_t a, uint8_t b, uint8_t amount) {
+    return a + (((int16_t)b - a) * (amount + 1)) / 256;
+}
+
+static uint32_t mix_color(uint32_t a, uint32_t b, uint8_t amount) {
+    return (mix(a >> 16, b >> 16, amount) << 16) |
+           (mix(a >> 8, b >> 8, amount) << 8) |
+           mix(a, b, amount);
+}
+
+static ws2812_pixel_t to_pixel(uint32_t color) {
+    return (ws2812_pixel_t) {
+        .red = (color >> 16) & 0xff,
+        .green = (color >> 8) & 0xff,
+        .blue = color & 0xff,
+    };
+}
+
+static uint32_t from_pixel(ws2812_pixel_t pixel) {
+    return (pixel.red << 16) | (pixel.green << 8) | pixel.blue;
+}
+
+int palette_build(palette_t *palette, const palette_stop_t *stops, uint8_t stop_count) {
+    if (!stop_count)
+        return -1;
+
+    for (int i = 1; i < stop_count; i++) {
+        if (stops[i].position < stops[i-1].position)
+            return -1;
+    }
+
+    uint8_t s = 0;
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        while (s < stop_count - 1 && stops[s+1].position <= i)
+            s++;
+
+        uint32_t color;
+        if (i <= stops[s].position || s == stop_count - 1) {
+            color = stops[s].color;
+        } else {
+            const palette_stop_t *lo = &stops[s], *hi = &stops[s+1];
+            uint8_t amount = (i - lo->position) * 255 / (hi->position - lo->position);
+            color = mix_color(lo->color, hi->color, amount);
+        }
+
+        palette->colors[i] = to_pixel(color);
+    }
+
+    return 0;
+}
+
+void palette_blend(palette_t *palette, const palette_t *from, const palette_t *to, uint8_t amount) {
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        uint32_t color = mix_color(
+            from_pixel(palette_color(from, i)),
+            from_pixel(palette_color(to, i)),
+            amount
+        );
+        palette->colors[i] = to_pixel(color);
+    }
+}
+
+static void reverse(ws2812_pixel_t *colors, int from, int to) {
+    for (to--; from < to; from++, to--) {
+        uint32_t tmp = colors[from].color;
+        colors[from].color = colors[to].color;
+        colors[to].color = tmp;
+    }
+}
+
+void palette_rotate(palette_t *palette, uint8_t offset) {
+    if (!offset)
+        return;
+
+    // rotate in place without a temporary table
+    reverse(palette->colors, 0, PALETTE_SIZE);
+    reverse(palette->colors, 0, offset);
+    reverse(palette->colors, offset, PALETTE_SIZE);
+}
+
+
+static const palette_stop_t fire_stops[] = {
+    PALETTE_STOP(0, 0x000000),
+    PALETTE_STOP(80, 0xff0000),
+    PALETTE_STOP(160, 0xffff00),
+    PALETTE_STOP(240, 0xffffff),
+};
+
+static const palette_stop_t rainbow_stops[] = {
+    PALETTE_STOP(0, 0xff0000),
+    PALETTE_STOP(85, 0x00ff00),
+    PALETTE_STOP(170, 0x0000ff),
+    PALETTE_STOP(255, 0xff0000),
+};
+
+// Each built-in palette has its own table, so the ones that are
+// never used are dropped by the linker
+#define BUILTIN_PALETTE(name) \
+    const palette_t *palette_##name() { \
+        static palette_t palette; \
+        static bool built = false; \
+        if (!built) { \
+            palette_build(&palette, name##_stops, sizeof(name##_stops) / sizeof(*name##_stops)); \
+            built = true; \
+        } \
+        return &palette; \
+    }
+
+BUILTIN_PALETTE(fire)
+BUILTIN_PALETTE(rainbow)
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <ws2812_i2s/ws2812_i2s.h>
+
+/*
+ * Palettes are 256-entry color lookup tables expanded from a few
+ * gradient stops, so mapping a value to a color costs one table read.
+ *
+ * Palettes can be built into RAM at runtime with palette_build() or
+ * declared const with precomputed colors, in which case they stay in
+ * flash. Colors are always read as whole 32-bit words, which is what
+ * flash mapped memory requires.
+ */
+
+#define PALETTE_SIZE 256
+
+typedef struct {
+    uint8_t position;       // 0 to 255, stops must be in ascending order
+    uint32_t color;         // 0xRRGGBB
+} palette_stop_t;
+
+typedef struct {
+    ws2812_pixel_t colors[PALETTE_SIZE];
+} palette_t;
+
+#define PALETTE_STOP(_position, _color) { .position=(_position), .color=(_color) }
+
+/**
+    Expands gradient stops into the palette. Colors before the first
+    and after the last stop are the colors of those stops.
+
+    @param palette Palette to fill.
+    @param stops Gradient stops sorted by position.
+    @param stop_count Number of stops.
+    @return A negative integer if this method fails.
+*/
+int palette_build(palette_t *palette, const palette_stop_t *stops, uint8_t stop_count);
+
+/**
+    Mixes two palettes, e.g. to smoothly change one palette into another.
+
+    @param palette Resulting palette, can be the same as one of the sources.
+    @param from First palette.
+    @param to Second palette.
+    @param amount 0 gives the first palette, 255 gives the second one.
+*/
+void palette_blend(palette_t *palette, const palette_t *from, const palette_t *to, uint8_t amount);
+
+/**
+    Shifts palette colors so that color at index 0 moves to index offset.
+*/
+void palette_rotate(palette_t *palette, uint8_t offset);
+
+static inline ws2812_pixel_t palette_color(const palette_t *palette, uint8_t index) {
+    return (ws2812_pixel_t) { .color = palette->colors[index].color };
+}
+
+/**
+    Built-in palettes. They are built into RAM on first use.
+*/
+const palette_t *palette_fire();        // black - red - yellow - white
+const palette_t *palette_rainbow();     // red - green - blue - red
@@ -0,0 +1,9 @@
+# Component makefile for pixel_stream
+
+# expected anyone using this component includes it as 'pixel_stream/pixel_stream.h'
+INC_DIRS += $(pixel_stream_ROOT)..
+
+# args for passing into compile rule generation
+pixel_stream_SRC_DIR = $(pixel_stream_ROOT)
+
+$(eval $(call component_compile_rules,pixel_stream))
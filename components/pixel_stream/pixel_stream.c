@@ -0,0 +1,461 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <espressif/esp_system.h>
+#include <lwip/udp.h>
+#include <lwip/pbuf.h>
+#include <lwip/tcpip.h>
+#include <static_alloc/static_alloc.h>
+
+#include "pixel_stream.h"
+
+#define CHANNELS_PER_PIXEL 3
+
+// DDP header, followed by a 4 byte timecode if its flag is set
+#define DDP_HEADER_SIZE 10
+#define DDP_TIMECODE_SIZE 4
+
+#define DDP_FLAGS_VERSION_MASK 0xC0
+#define DDP_FLAGS_VERSION_1 0x40
+#define DDP_FLAGS_TIMECODE 0x10
+#define DDP_FLAGS_STORAGE 0x08
+#define DDP_FLAGS_REPLY 0x04
+#define DDP_FLAGS_QUERY 0x02
+#define DDP_FLAGS_PUSH 0x01
+
+// Sequence numbers go from 1 to 15, 0 when the sender does not use them
+#define DDP_SEQUENCE_MASK 0x0F
+#define DDP_SEQUENCES 15
+
+#define DDP_ID_DISPLAY 1
+#define DDP_ID_ALL 255
+
+// E1.31 data packet, offsets of the fields used
+#define E131_HEADER_SIZE 126
+#define E131_PACKET_ID 4
+#define E131_ROOT_VECTOR 18
+#define E131_FRAMING_VECTOR 40
+#define E131_SEQUENCE 111
+#define E131_OPTIONS 112
+#define E131_UNIVERSE 113
+#define E131_DMP_VECTOR 117
+#define E131_VALUE_COUNT 123
+#define E131_START_CODE 125
+
+#define E131_ROOT_VECTOR_DATA 0x00000004
+#define E131_FRAMING_VECTOR_DATA 0x00000002
+#define E131_DMP_VECTOR_SET_PROPERTY 0x02
+
+#define E131_OPTIONS_PREVIEW 0x80
+#define E131_OPTIONS_TERMINATED 0x40
+
+#define E131_MAX_VALUES 512
+#define E131_PIXELS_PER_UNIVERSE 170
+
+// Sequence numbers this far behind the last one are out of order
+// packets, anything further back is a restarted source
+#define E131_LATE_WINDOW 20
+#define DDP_LATE_WINDOW 8
+
+static const char e131_packet_id[12] = "ASC-E1.17\0\0";
+
+typedef enum {
+    PROTOCOL_DDP,
+    PROTOCOL_E131,
+} protocol_t;
+
+// Packet handed from the lwIP thread to the stream task
+typedef struct {
+    struct pbuf *p;
+    protocol_t protocol;
+} stream_packet_t;
+
+STATIC_TASK(stream, PIXEL_STREAM_TASK_STACK);
+STATIC_QUEUE(stream, PIXEL_STREAM_QUEUE_LENGTH, sizeof(stream_packet_t));
+
+
+static frame_buffer_t *frames = NULL;
+static pixel_stream_hold_fn hold_fn = NULL;
+static void *hold_context = NULL;
+
+static QueueHandle_t packets = NULL;
+static volatile bool active = false;
+static TickType_t last_packet_time;
+
+// Frame being received
+static bool frame_started = false;
+static bool frame_lost = false;         // a packet of the frame went missing
+static uint32_t frame_start_time;
+
+static uint8_t ddp_sequence = 0;        // 0 until a sender uses sequence numbers
+
+static uint32_t e131_universes = 0;     // universes of the strip, one bit each
+static uint32_t e131_received = 0;      // universes of the frame received
+static uint32_t e131_sequenced = 0;     // universes with a known sequence number
+static uint8_t e131_sequences[PIXEL_STREAM_E131_MAX_UNIVERSES];
+
+static pixel_stream_stats_t stats;
+
+// Where stream channels go within a pixel
+static const uint8_t channel_offsets[CHANNELS_PER_PIXEL] = {
+    offsetof(ws2812_pixel_t, red),
+    offsetof(ws2812_pixel_t, green),
+    offsetof(ws2812_pixel_t, blue),
+};
+
+
+static uint16_t pbuf_get_u16(struct pbuf *p, uint16_t offset) {
+    return (pbuf_get_at(p, offset) << 8) | pbuf_get_at(p, offset + 1);
+}
+
+static uint32_t pbuf_get_u32(struct pbuf *p, uint16_t offset) {
+    return ((uint32_t)pbuf_get_u16(p, offset) << 16) | pbuf_get_u16(p, offset + 2);
+}
+
+// Copies channel values from the packet straight into the back buffer
+static void stream_write(ws2812_pixel_t *pixels, struct pbuf *p,
+                         uint16_t offset, uint16_t length, uint32_t channel) {
+    uint32_t channels = frames->count * CHANNELS_PER_PIXEL;
+    if (channel >= channels)
+        return;
+    if (length > channels - channel)
+        length = channels - channel;
+
+    uint8_t *pixel = (uint8_t *)&pixels[channel / CHANNELS_PER_PIXEL];
+    uint8_t color = channel % CHANNELS_PER_PIXEL;
+
+    for (struct pbuf *q = p; q && length; q = q->next) {
+        if (offset >= q->len) {
+            offset -= q->len;
+            continue;
+        }
+
+        const uint8_t *data = (const uint8_t *)q->payload + offset;
+        uint16_t count = q->len - offset;
+        if (count > length)
+            count = length;
+
+        offset = 0;
+        length -= count;
+
+        while (count--) {
+            pixel[channel_offsets[color]] = *data++;
+            if (++color == CHANNELS_PER_PIXEL) {
+                color = 0;
+                pixel += sizeof(ws2812_pixel_t);
+            }
+        }
+    }
+}
+
+static ws2812_pixel_t *frame_begin() {
+    if (!frame_started) {
+        frame_started = true;
+        frame_lost = false;
+        frame_start_time = sdk_system_get_time();
+    }
+
+    // packets may cover a part of the strip, the rest stays as it was
+    return frame_buffer_begin(frames, true);
+}
+
+// Shows the back buffer, which the caller owns
+static void frame_show() {
+    frame_buffer_show(frames);
+
+    stats.frames++;
+    if (frame_lost)
+        stats.incomplete++;
+
+    stats.latency_us = sdk_system_get_time() - frame_start_time + frames->transfer_us;
+    if (stats.latency_us > stats.max_latency_us)
+        stats.max_latency_us = stats.latency_us;
+
+    frame_started = false;
+    e131_received = 0;
+}
+
+static void stream_packet() {
+    stats.packets++;
+
+    if (!active) {
+        active = true;
+        ddp_sequence = 0;
+        e131_sequenced = 0;
+
+        if (hold_fn)
+            hold_fn(true, hold_context);
+    }
+
+    last_packet_time = xTaskGetTickCount();
+}
+
+static void stream_stop() {
+    if (!active)
+        return;
+
+    // a frame that was never completed is not shown
+    frame_started = false;
+    e131_received = 0;
+    active = false;
+
+    if (hold_fn)
+        hold_fn(false, hold_context);
+}
+
+static void ddp_receive(struct pbuf *p) {
+    uint8_t header[DDP_HEADER_SIZE];
+    if (pbuf_copy_partial(p, header, sizeof(header), 0) != sizeof(header)) {
+        stats.invalid++;
+        goto done;
+    }
+
+    uint8_t flags = header[0];
+    if ((flags & DDP_FLAGS_VERSION_MASK) != DDP_FLAGS_VERSION_1) {
+        stats.invalid++;
+        goto done;
+    }
+
+    // Only pixel data for the display is shown, queries and
+    // replies are not answered. Data type is not checked, as
+    // senders disagree on it, data is always 8 bit RGB.
+    if (flags & (DDP_FLAGS_QUERY | DDP_FLAGS_REPLY | DDP_FLAGS_STORAGE))
+        goto done;
+    if (header[3] != DDP_ID_DISPLAY && header[3] != DDP_ID_ALL)
+        goto done;
+
+    uint32_t channel = ((uint32_t)header[4] << 24) | (header[5] << 16) | (header[6] << 8) | header[7];
+    uint16_t length = (header[8] << 8) | header[9];
+    uint16_t offset = DDP_HEADER_SIZE + ((flags & DDP_FLAGS_TIMECODE) ? DDP_TIMECODE_SIZE : 0);
+    if (offset + length > p->tot_len) {
+        stats.invalid++;
+        goto done;
+    }
+
+    stream_packet();
+
+    bool gap = false;
+    uint8_t sequence = header[1] & DDP_SEQUENCE_MASK;
+    if (sequence) {
+        if (ddp_sequence) {
+            uint8_t ahead = (sequence - ddp_sequence + DDP_SEQUENCES) % DDP_SEQUENCES;
+            if (!ahead || ahead > DDP_LATE_WINDOW) {
+                stats.late++;
+                goto done;
+            }
+
+            if (ahead > 1) {
+                stats.lost += ahead - 1;
+                gap = true;
+            }
+        }
+        ddp_sequence = sequence;
+    }
+
+    // Packets missing before this one belong to this frame, or to
+    // the previous one which is then completed by this frame
+    ws2812_pixel_t *pixels = frame_begin();
+    if (gap)
+        frame_lost = true;
+    stream_write(pixels, p, offset, length, channel);
+
+    if (flags & DDP_FLAGS_PUSH) {
+        frame_show();
+    } else {
+        frame_buffer_end(frames);
+    }
+
+done:
+    pbuf_free(p);
+}
+
+static void e131_receive(struct pbuf *p) {
+    if (p->tot_len < E131_HEADER_SIZE ||
+            pbuf_memcmp(p, E131_PACKET_ID, e131_packet_id, sizeof(e131_packet_id)) ||
+            pbuf_get_u32(p, E131_ROOT_VECTOR) != E131_ROOT_VECTOR_DATA) {
+        stats.invalid++;
+        goto done;
+    }
+
+    // synchronization and discovery packets are not used
+    if (pbuf_get_u32(p, E131_FRAMING_VECTOR) != E131_FRAMING_VECTOR_DATA ||
+            pbuf_get_at(p, E131_DMP_VECTOR) != E131_DMP_VECTOR_SET_PROPERTY ||
+            pbuf_get_at(p, E131_START_CODE) != 0)
+        goto done;
+
+    uint8_t options = pbuf_get_at(p, E131_OPTIONS);
+    if (options & E131_OPTIONS_PREVIEW)
+        goto done;
+
+    uint16_t universe = pbuf_get_u16(p, E131_UNIVERSE) - PIXEL_STREAM_E131_UNIVERSE;
+    if (universe >= PIXEL_STREAM_E131_MAX_UNIVERSES || !(e131_universes & (1 << universe)))
+        goto done;
+
+    if (options & E131_OPTIONS_TERMINATED) {
+        stream_stop();
+        goto done;
+    }
+
+    // value count includes the start code
+    uint16_t length = pbuf_get_u16(p, E131_VALUE_COUNT) - 1;
+    if (length > E131_MAX_VALUES || E131_HEADER_SIZE + length > p->tot_len) {
+        stats.invalid++;
+        goto done;
+    }
+    if (length > E131_PIXELS_PER_UNIVERSE * CHANNELS_PER_PIXEL)
+        length = E131_PIXELS_PER_UNIVERSE * CHANNELS_PER_PIXEL;
+
+    stream_packet();
+
+    uint8_t sequence = pbuf_get_at(p, E131_SEQUENCE);
+    if (e131_sequenced & (1 << universe)) {
+        int8_t ahead = sequence - e131_sequences[universe];
+        if (ahead <= 0 && ahead > -E131_LATE_WINDOW) {
+            stats.late++;
+            goto done;
+        }
+
+        // frames missing the universe are told by the universes received
+        if (ahead > 1)
+            stats.lost += ahead - 1;
+    }
+    e131_sequences[universe] = sequence;
+    e131_sequenced |= (1 << universe);
+
+    ws2812_pixel_t *pixels;
+
+    // The universe is here again, so some universe of the frame got
+    // lost. The frame is shown as it is and a new one starts.
+    if (e131_received & (1 << universe)) {
+        frame_lost = true;
+        frame_buffer_begin(frames, true);
+        frame_show();
+    }
+
+    pixels = frame_begin();
+    stream_write(pixels, p, E131_HEADER_SIZE, length,
+                 (uint32_t)universe * E131_PIXELS_PER_UNIVERSE * CHANNELS_PER_PIXEL);
+    e131_received |= (1 << universe);
+
+    if (e131_received == e131_universes) {
+        frame_show();
+    } else {
+        frame_buffer_end(frames);
+    }
+
+done:
+    pbuf_free(p);
+}
+
+// Time left until the stream is over
+static TickType_t stream_timeout() {
+    if (!active)
+        return portMAX_DELAY;
+
+    TickType_t elapsed = xTaskGetTickCount() - last_packet_time;
+    TickType_t timeout = PIXEL_STREAM_TIMEOUT_MS / portTICK_PERIOD_MS;
+
+    return (elapsed < timeout) ? timeout - elapsed : 0;
+}
+
+// Packets are parsed and shown here, as drawing waits for the
+// renderer to release the frame buffer and for transfers to finish
+static void stream_task(void *_args) {
+    stream_packet_t packet;
+
+    while (1) {
+        if (xQueueReceive(packets, &packet, stream_timeout()) != pdTRUE) {
+            stream_stop();
+            continue;
+        }
+
+        switch (packet.protocol) {
+            case PROTOCOL_DDP:
+                ddp_receive(packet.p);
+                break;
+            case PROTOCOL_E131:
+                e131_receive(packet.p);
+                break;
+        }
+    }
+}
+
+// Runs in the lwIP thread, which must never wait for the strip
+static void stream_receive(void *arg, struct udp_pcb *_pcb, struct pbuf *p,
+                           const ip_addr_t *_addr, u16_t _port) {
+    stream_packet_t packet = {
+        .p = p,
+        .protocol = (protocol_t)arg,
+    };
+
+    if (xQueueSend(packets, &packet, 0) != pdTRUE) {
+        stats.dropped++;
+        pbuf_free(p);
+    }
+}
+
+static struct udp_pcb *stream_listen(uint16_t port, protocol_t protocol) {
+    struct udp_pcb *pcb = udp_new();
+    if (!pcb)
+        return NULL;
+
+    if (udp_bind(pcb, IP_ADDR_ANY, port) != ERR_OK) {
+        udp_remove(pcb);
+        return NULL;
+    }
+
+    udp_recv(pcb, stream_receive, (void *)protocol);
+
+    return pcb;
+}
+
+int pixel_stream_init(frame_buffer_t *_frames, pixel_stream_hold_fn hold, void *context) {
+    frames = _frames;
+    hold_fn = hold;
+    hold_context = context;
+    memset(&stats, 0, sizeof(stats));
+
+    uint32_t universe_count = (frames->count + E131_PIXELS_PER_UNIVERSE - 1) / E131_PIXELS_PER_UNIVERSE;
+    if (universe_count >= PIXEL_STREAM_E131_MAX_UNIVERSES) {
+        e131_universes = 0xFFFFFFFF;
+    } else {
+        e131_universes = (1 << universe_count) - 1;
+    }
+
+    packets = STATIC_QUEUE_CREATE(stream);
+    if (!packets)
+        return -1;
+
+    if (!STATIC_TASK_CREATE(stream, stream_task, "Pixel stream", NULL, PIXEL_STREAM_TASK_PRIORITY))
+        return -1;
+
+    LOCK_TCPIP_CORE();
+    struct udp_pcb *ddp_pcb = stream_listen(PIXEL_STREAM_DDP_PORT, PROTOCOL_DDP);
+    struct udp_pcb *e131_pcb = stream_listen(PIXEL_STREAM_E131_PORT, PROTOCOL_E131);
+    UNLOCK_TCPIP_CORE();
+
+    if (!ddp_pcb || !e131_pcb)
+        return -1;
+
+    return 0;
+}
+
+bool pixel_stream_active() {
+    return active;
+}
+
+const pixel_stream_stats_t *pixel_stream_stats() {
+    return &stats;
+}
+
+void pixel_stream_dump() {
+    printf("Stream: %s, %u packets, %u frames (%u incomplete)\n",
+           active ? "active" : "idle", stats.packets, stats.frames, stats.incomplete);
+    printf("Stream: %u lost, %u late, %u dropped, %u invalid packets\n",
+           stats.lost, stats.late, stats.dropped, stats.invalid);
+    printf("Stream: latency %u us, max %u us\n",
+           stats.latency_us, stats.max_latency_us);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <frame_buffer/frame_buffer.h>
+
+/*
+ * Receives pixels streamed by a show controller over UDP and shows
+ * them on a ws2812 strip.
+ *
+ * Two protocols are understood:
+ *   DDP     port 4048, RGB data at any byte offset, a frame is shown
+ *           on a packet with the PUSH flag.
+ *   E1.31   port 5568, unicast, 170 pixels per universe starting with
+ *           PIXEL_STREAM_E131_UNIVERSE, a frame is shown once every
+ *           universe of the strip arrived.
+ *
+ * The lwIP thread only queues packets for the stream task, which
+ * parses them straight from the packet buffers into the back buffer
+ * of the frame buffer. Drawing waits for the frame buffer and for the
+ * previous transfer, and the network must not wait with it. Packets
+ * that arrive out of order are dropped and missing ones are counted.
+ * A frame that lost a packet is shown when the next frame starts.
+ *
+ * When the first packet arrives, the hold callback is asked to stop
+ * whatever draws on the strip. PIXEL_STREAM_TIMEOUT_MS after the last
+ * packet (or right away when an E1.31 source terminates the stream)
+ * it is asked to take over again.
+ */
+
+#define PIXEL_STREAM_DDP_PORT 4048
+#define PIXEL_STREAM_E131_PORT 5568
+
+// First universe of the strip
+#ifndef PIXEL_STREAM_E131_UNIVERSE
+#define PIXEL_STREAM_E131_UNIVERSE 1
+#endif
+
+// Universes of the strip, pixels past them are not streamed over E1.31
+#define PIXEL_STREAM_E131_MAX_UNIVERSES 32
+
+// Packets waiting for the stream task, further ones are dropped
+#ifndef PIXEL_STREAM_QUEUE_LENGTH
+#define PIXEL_STREAM_QUEUE_LENGTH 8
+#endif
+
+#define PIXEL_STREAM_TASK_STACK 256
+#define PIXEL_STREAM_TASK_PRIORITY 3
+
+// Time without packets after which the stream is over
+#ifndef PIXEL_STREAM_TIMEOUT_MS
+#define PIXEL_STREAM_TIMEOUT_MS 2500
+#endif
+
+typedef struct {
+    uint32_t packets;
+    uint32_t frames;
+    uint32_t incomplete;        // frames shown with packets missing
+    uint32_t lost;              // packets missing according to sequence numbers
+    uint32_t late;              // packets dropped as out of order
+    uint32_t dropped;           // packets dropped while the stream task was busy
+    uint32_t invalid;           // packets that could not be parsed
+
+    // From the first packet of a frame to its last LED getting its
+    // color: time to receive and show the frame plus its transfer
+    uint32_t latency_us;
+    uint32_t max_latency_us;
+} pixel_stream_stats_t;
+
+/**
+    Asks the current owner of the strip to stop (hold is true) or
+    continue (hold is false) drawing. Called from the stream task, it
+    should not block for long.
+*/
+typedef void (*pixel_stream_hold_fn)(bool hold, void *context);
+
+/**
+    Starts listening for streams.
+
+    @param frames Frame buffer of the strip.
+    @param hold Callback to stop and continue the current owner of the strip.
+    @param context Context passed to the callback.
+    @return A negative integer if this method fails.
+*/
+int pixel_stream_init(frame_buffer_t *frames, pixel_stream_hold_fn hold, void *context);
+
+/**
+    Whether a stream is being shown.
+*/
+bool pixel_stream_active();
+
+/**
+    Returns statistics since the start.
+*/
+const pixel_stream_stats_t *pixel_stream_stats();
+
+/**
+    Prints statistics to UART.
+*/
+void pixel_stream_dump();
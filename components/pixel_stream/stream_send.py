@@ -0,0 +1,296 @@
+#!/usr/bin/env python
+"""
+Streams test patterns to a pixel_stream receiver over DDP or E1.31.
+
+Usage:
+    stream_send.py HOST [--protocol ddp|e131] [--pixels N] [--fps FPS]
+                        [--seconds S] [--pattern rainbow|chase|white]
+                        [--loss RATIO] [--reorder RATIO]
+    stream_send.py --loopback [options as above]
+
+--loss drops and --reorder swaps a share of packets, to check that the
+receiver counts lost and late packets (see pixel_stream_dump()).
+
+With --loopback packets go to a receiver in this script on 127.0.0.1,
+which assembles frames and checks sequence numbers the same way the
+device does. It prints lost, late and incomplete counts and the time
+from the first packet of a frame to the frame being complete.
+On the device the same latency, plus time to show the frame and
+stream it out to the strip, is reported by pixel_stream_dump().
+"""
+from __future__ import division, print_function
+
+import argparse
+import colorsys
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+DDP_PORT = 4048
+E131_PORT = 5568
+
+DDP_MAX_DATA = 1440
+DDP_VERSION_1 = 0x40
+DDP_PUSH = 0x01
+DDP_ID_DISPLAY = 1
+DDP_TYPE_RGB8 = 0x0B
+
+E131_PIXELS_PER_UNIVERSE = 170
+E131_PACKET_ID = b'ASC-E1.17\0\0\0'
+E131_CID = bytes(bytearray(random.getrandbits(8) for _ in range(16)))
+E131_HEADER_SIZE = 126
+
+# Sequence numbers this far behind the last one are out of order
+# packets, anything further back is a restarted source
+DDP_SEQUENCES = 15
+DDP_LATE_WINDOW = 8
+E131_LATE_WINDOW = 20
+
+
+def pattern_frame(pattern, pixels, frame):
+    data = bytearray()
+    for i in range(pixels):
+        if pattern == 'white':
+            rgb = (255, 255, 255)
+        elif pattern == 'chase':
+            rgb = (255, 255, 255) if i == frame % pixels else (0, 0, 0)
+        else:
+            hue = ((i / pixels) + frame / 100.0) % 1.0
+            rgb = tuple(int(c * 255) for c in colorsys.hsv_to_rgb(hue, 1, 1))
+        data.extend(rgb)
+    return bytes(data)
+
+
+def ddp_sequence(packet):
+    """Sequence number of the packet-th packet, 1 to 15."""
+    return packet % DDP_SEQUENCES + 1
+
+
+def ddp_packets(data, first_packet):
+    """Packets of a frame, first_packet is the number of packets sent before."""
+    packets = []
+    for offset in range(0, len(data), DDP_MAX_DATA):
+        sequence = ddp_sequence(first_packet + len(packets))
+        chunk = data[offset:offset + DDP_MAX_DATA]
+        flags = DDP_VERSION_1
+        if offset + len(chunk) >= len(data):
+            flags |= DDP_PUSH
+        header = struct.pack('>BBBBIH', flags, sequence, DDP_TYPE_RGB8, DDP_ID_DISPLAY, offset, len(chunk))
+        packets.append(header + chunk)
+    return packets
+
+
+def e131_packet(universe, sequence, chunk, options=0):
+    values = b'\0' + chunk
+    dmp = struct.pack('>HBBHHH', 0x7000 | (10 + len(values)), 0x02, 0xA1, 0, 1, len(values)) + values
+    framing = struct.pack('>HI64sBHBBH',
+                          0x7000 | (77 + len(dmp)), 0x00000002, b'stream_send.py',
+                          100, 0, sequence, options, universe) + dmp
+    root = struct.pack('>HH12sHI16s',
+                       0x0010, 0, E131_PACKET_ID,
+                       0x7000 | (22 + len(framing)), 0x00000004, E131_CID) + framing
+    return root
+
+
+def e131_packets(data, frame, first_universe):
+    packets = []
+    size = E131_PIXELS_PER_UNIVERSE * 3
+    for index, offset in enumerate(range(0, len(data), size)):
+        packets.append(e131_packet(first_universe + index, frame % 256, data[offset:offset + size]))
+    return packets
+
+
+def int8(value):
+    value &= 0xFF
+    return value - 256 if value >= 128 else value
+
+
+class LoopbackReceiver(threading.Thread):
+    """Assembles frames and checks sequence numbers like pixel_stream.c does."""
+
+    def __init__(self, protocol, pixels, first_universe):
+        threading.Thread.__init__(self)
+        self.daemon = True
+        self.protocol = protocol
+        self.universes = (pixels + E131_PIXELS_PER_UNIVERSE - 1) // E131_PIXELS_PER_UNIVERSE
+        self.first_universe = first_universe
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.socket.bind(('127.0.0.1', DDP_PORT if protocol == 'ddp' else E131_PORT))
+        self.socket.settimeout(0.5)
+        self.frame_started = None
+        self.frame_lost = False
+        self.received = set()
+        self.ddp_sequence = 0
+        self.e131_sequences = {}
+        self.latencies = []
+        self.lost = self.late = self.incomplete = 0
+        self.running = True
+
+    def frame_packet(self):
+        if self.frame_started is None:
+            self.frame_started = time.time()
+            self.frame_lost = False
+
+    def frame_done(self):
+        self.latencies.append(time.time() - self.frame_started)
+        if self.frame_lost:
+            self.incomplete += 1
+        self.frame_started = None
+        self.received = set()
+
+    def ddp_receive(self, packet):
+        flags, sequence = bytearray(packet[0:2])
+        sequence &= 0x0F
+
+        gap = False
+        if sequence:
+            if self.ddp_sequence:
+                ahead = (sequence - self.ddp_sequence) % DDP_SEQUENCES
+                if not ahead or ahead > DDP_LATE_WINDOW:
+                    self.late += 1
+                    return
+                if ahead > 1:
+                    self.lost += ahead - 1
+                    gap = True
+            self.ddp_sequence = sequence
+
+        self.frame_packet()
+        if gap:
+            self.frame_lost = True
+        if flags & DDP_PUSH:
+            self.frame_done()
+
+    def e131_receive(self, packet):
+        if len(packet) < E131_HEADER_SIZE or packet[4:16] != E131_PACKET_ID:
+            return
+        sequence = bytearray(packet[111:112])[0]
+        options = bytearray(packet[112:113])[0]
+        universe = struct.unpack('>H', packet[113:115])[0] - self.first_universe
+        if options & 0x40:
+            return
+
+        if universe in self.e131_sequences:
+            ahead = int8(sequence - self.e131_sequences[universe])
+            if -E131_LATE_WINDOW < ahead <= 0:
+                self.late += 1
+                return
+            if ahead > 1:
+                self.lost += ahead - 1
+        self.e131_sequences[universe] = sequence
+
+        # the universe is here again, so the frame lost a universe
+        if universe in self.received:
+            self.frame_lost = True
+            self.frame_done()
+        self.frame_packet()
+        self.received.add(universe)
+        if len(self.received) == self.universes:
+            self.frame_done()
+
+    def run(self):
+        while self.running:
+            try:
+                packet = self.socket.recv(2048)
+            except socket.timeout:
+                continue
+
+            if self.protocol == 'ddp':
+                self.ddp_receive(packet)
+            else:
+                self.e131_receive(packet)
+
+    def report(self):
+        if not self.latencies:
+            print('no frames received')
+            return
+        print('%d lost, %d late packets, %d incomplete frames' % (self.lost, self.late, self.incomplete))
+        latencies = sorted(self.latencies)
+        print('%d frames, latency avg %.0f us, 99%% %.0f us, max %.0f us' % (
+            len(latencies),
+            sum(latencies) / len(latencies) * 1e6,
+            latencies[int(len(latencies) * 0.99)] * 1e6,
+            latencies[-1] * 1e6,
+        ))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Streams test patterns over DDP or E1.31.')
+    parser.add_argument('host', nargs='?')
+    parser.add_argument('--loopback', action='store_true', help='send to a receiver in this script')
+    parser.add_argument('--protocol', choices=('ddp', 'e131'), default='ddp')
+    parser.add_argument('--pixels', type=int, default=50)
+    parser.add_argument('--universe', type=int, default=1, help='first E1.31 universe')
+    parser.add_argument('--fps', type=float, default=40)
+    parser.add_argument('--seconds', type=float, default=10)
+    parser.add_argument('--pattern', choices=('rainbow', 'chase', 'white'), default='rainbow')
+    parser.add_argument('--loss', type=float, default=0, help='share of packets not sent')
+    parser.add_argument('--reorder', type=float, default=0, help='share of packets sent late')
+    args = parser.parse_args()
+
+    if args.loopback:
+        host = '127.0.0.1'
+        receiver = LoopbackReceiver(args.protocol, args.pixels, args.universe)
+        receiver.start()
+    elif args.host:
+        host = args.host
+        receiver = None
+    else:
+        parser.print_help()
+        sys.exit(1)
+
+    port = DDP_PORT if args.protocol == 'ddp' else E131_PORT
+    sender = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+    sent = lost = reordered = 0
+    ddp_sent = 0
+    held = None
+    start = time.time()
+    frame = 0
+    while time.time() - start < args.seconds:
+        data = pattern_frame(args.pattern, args.pixels, frame)
+        if args.protocol == 'ddp':
+            packets = ddp_packets(data, ddp_sent)
+            ddp_sent += len(packets)
+        else:
+            packets = e131_packets(data, frame, args.universe)
+
+        for packet in packets:
+            if random.random() < args.loss:
+                lost += 1
+                continue
+            if held is None and random.random() < args.reorder:
+                held = packet
+                reordered += 1
+                continue
+
+            sender.sendto(packet, (host, port))
+            sent += 1
+            if held is not None:
+                sender.sendto(held, (host, port))
+                sent += 1
+                held = None
+
+        frame += 1
+        next_frame = start + frame / args.fps
+        time.sleep(max(0, next_frame - time.time()))
+
+    if args.protocol == 'e131':
+        # tells the receiver to hand the strip back right away
+        universes = (args.pixels + E131_PIXELS_PER_UNIVERSE - 1) // E131_PIXELS_PER_UNIVERSE
+        for index in range(universes):
+            sender.sendto(e131_packet(args.universe + index, frame % 256, b'', options=0x40), (host, port))
+
+    print('%d frames, %d packets sent, %d dropped, %d reordered' % (frame, sent, lost, reordered))
+
+    if receiver:
+        time.sleep(0.6)
+        receiver.running = False
+        receiver.join()
+        receiver.report()
+
+
+if __name__ == '__main__':
+    main()
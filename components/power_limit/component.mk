@@ -0,0 +1,9 @@
+# Component makefile for power_limit
+
+# expected anyone using this component includes it as 'power_limit/power_limit.h'
+INC_DIRS += $(power_limit_ROOT)..
+
+# args for passing into compile rule generation
+power_limit_SRC_DIR = $(power_limit_ROOT)
+
+$(eval $(call component_compile_rules,power_limit))
@@ -0,0 +1,89 @@
+#include "power_limit.h"
+
+#define FULL_SCALE 256
+
+// Lanes of 16 bits overflow after 257 pixels of 255
+#define SUM_CHUNK 256
+
+#define LANES 0x00FF00FF
+
+
+void power_limit_init(power_limit_t *limit, uint32_t budget_ma) {
+    limit->budget_ma = budget_ma;
+    limit->scale = FULL_SCALE;
+    limit->target = FULL_SCALE;
+    limit->requested_ma = 0;
+    limit->current_ma = 0;
+    limit->peak_ma = 0;
+    limit->limited = 0;
+}
+
+// Sum of all channels of all pixels
+static uint32_t channel_sum(const ws2812_pixel_t *pixels, uint16_t count) {
+    uint32_t sum = 0;
+
+    while (count) {
+        uint16_t chunk = (count < SUM_CHUNK) ? count : SUM_CHUNK;
+        count -= chunk;
+
+        // channels 0 and 2 in one word, 1 and 3 in the other
+        uint32_t even = 0, odd = 0;
+        for (int i = 0; i < chunk; i++) {
+            uint32_t color = pixels[i].color;
+            even += color & LANES;
+            odd += (color >> 8) & LANES;
+        }
+        pixels += chunk;
+
+        sum += (even & 0xFFFF) + (even >> 16) + (odd & 0xFFFF) + (odd >> 16);
+    }
+
+    return sum;
+}
+
+static void scale_pixels(const ws2812_pixel_t *pixels, ws2812_pixel_t *scaled,
+                         uint16_t count, uint32_t scale) {
+    // a channel times 256 still fits into its lane
+    for (int i = 0; i < count; i++) {
+        uint32_t color = pixels[i].color;
+        uint32_t even = (((color & LANES) * scale) >> 8) & LANES;
+        uint32_t odd = (((color >> 8) & LANES) * scale) & ~LANES;
+        scaled[i].color = even | odd;
+    }
+}
+
+ws2812_pixel_t *power_limit_apply(power_limit_t *limit, ws2812_pixel_t *pixels,
+                                  ws2812_pixel_t *scratch, uint16_t count) {
+    uint32_t idle_ma = count * POWER_LIMIT_IDLE_MA;
+    uint32_t sum = channel_sum(pixels, count);
+    uint32_t lit_ma = sum * POWER_LIMIT_CHANNEL_MA / 255;
+
+    limit->requested_ma = idle_ma + lit_ma;
+
+    uint32_t target = FULL_SCALE;
+    if (limit->budget_ma && limit->requested_ma > limit->budget_ma) {
+        target = (limit->budget_ma > idle_ma) ?
+            (uint64_t)(limit->budget_ma - idle_ma) * FULL_SCALE / lit_ma : 0;
+    }
+    limit->target = target;
+
+    if (target < limit->scale) {
+        limit->scale = target;
+    } else if (target > limit->scale) {
+        limit->scale += (target - limit->scale + POWER_LIMIT_RECOVERY - 1) / POWER_LIMIT_RECOVERY;
+    }
+
+    ws2812_pixel_t *result = pixels;
+    if (limit->scale < FULL_SCALE) {
+        scale_pixels(pixels, scratch, count, limit->scale);
+        result = scratch;
+        limit->limited++;
+        lit_ma = lit_ma * limit->scale / FULL_SCALE;
+    }
+
+    limit->current_ma = idle_ma + lit_ma;
+    if (limit->current_ma > limit->peak_ma)
+        limit->peak_ma = limit->current_ma;
+
+    return result;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <homekit/types.h>
+#include <ws2812_i2s/ws2812_i2s.h>
+
+/*
+ * Keeps estimated current draw of a ws2812 strip under a budget.
+ *
+ * Current of a frame is estimated from the sum of its channel values:
+ * every channel draws POWER_LIMIT_CHANNEL_MA at full brightness and
+ * every LED POWER_LIMIT_IDLE_MA when it is off. A frame over the
+ * budget is dimmed right away, so the supply never sees it. Once
+ * frames get darker, brightness comes back over a few frames instead
+ * of jumping up.
+ *
+ * Channels are summed two at a time in 16 bit lanes of a 32 bit word
+ * and scaled the same way, which costs a few cycles per pixel.
+ */
+
+// Current of one channel at full brightness
+#ifndef POWER_LIMIT_CHANNEL_MA
+#define POWER_LIMIT_CHANNEL_MA 20
+#endif
+
+// Current of an LED that is off
+#ifndef POWER_LIMIT_IDLE_MA
+#define POWER_LIMIT_IDLE_MA 1
+#endif
+
+// Brightness recovers by 1/POWER_LIMIT_RECOVERY of the way per frame
+#ifndef POWER_LIMIT_RECOVERY
+#define POWER_LIMIT_RECOVERY 8
+#endif
+
+typedef struct {
+    uint32_t budget_ma;         // 0 for no limit
+    uint16_t scale;             // brightness applied, 256 is full
+    uint16_t target;            // brightness scale is moving to
+
+    uint32_t requested_ma;      // estimate of the last frame as drawn
+    uint32_t current_ma;        // estimate of the last frame as sent
+    uint32_t peak_ma;           // highest current_ma so far
+    uint32_t limited;           // frames that were dimmed
+} power_limit_t;
+
+/**
+    @param limit Limiter to initialize.
+    @param budget_ma Current the strip may draw, 0 for no limit.
+*/
+void power_limit_init(power_limit_t *limit, uint32_t budget_ma);
+
+/**
+    Estimates current of a frame and dims it if needed.
+
+    @param limit Limiter.
+    @param pixels Frame as drawn, it is not changed.
+    @param scratch Buffer for a dimmed copy of the frame, it can be
+                   the same as pixels if the frame may be changed.
+    @param count Number of pixels.
+    @return Frame to send: pixels or scratch.
+*/
+ws2812_pixel_t *power_limit_apply(power_limit_t *limit, ws2812_pixel_t *pixels,
+                                  ws2812_pixel_t *scratch, uint16_t count);
+
+/**
+    Whether brightness is still coming back, so frames should be sent
+    even if nothing was drawn.
+*/
+static inline bool power_limit_recovering(const power_limit_t *limit) {
+    return limit->scale < limit->target;
+}
+
+/**
+    Custom read-only characteristic with the estimated current of the
+    strip in milliamps. The getter is up to the accessory, as there
+    can be several strips:
+
+        HOMEKIT_CHARACTERISTIC(CUSTOM_POWER_CURRENT, .getter=strip_current_get)
+*/
+#define HOMEKIT_CHARACTERISTIC_CUSTOM_POWER_CURRENT HOMEKIT_CUSTOM_UUID("F0000102")
+#define HOMEKIT_DECLARE_CHARACTERISTIC_CUSTOM_POWER_CURRENT(...) \
+    .type = HOMEKIT_CHARACTERISTIC_CUSTOM_POWER_CURRENT, \
+    .description = "Current", \
+    .format = homekit_format_uint32, \
+    .unit = homekit_unit_none, \
+    .permissions = homekit_permissions_paired_read, \
+    .value = HOMEKIT_UINT32_(0), \
+    ##__VA_ARGS__
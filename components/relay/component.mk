@@ -0,0 +1,9 @@
+# Component makefile for relay
+
+# expected anyone using this component includes it as 'relay/relay.h'
+INC_DIRS += $(relay_ROOT)..
+
+# args for passing into compile rule generation
+relay_SRC_DIR = $(relay_ROOT)
+
+$(eval $(call component_compile_rules,relay))
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <esp8266.h>
+#include <esp/timer.h>
+#include <esp/interrupts.h>
+#include <espressif/esp_system.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <static_alloc/static_alloc.h>
+
+#include "relay.h"
+
+// Relays are checked for pending transitions this often
+#define POLL_INTERVAL_MS 10
+
+// Half period assumed until the first crossings are measured
+#define DEFAULT_HALF_PERIOD_US 10000
+
+// Anything outside is noise or a missing pulse
+#define MIN_HALF_PERIOD_US 7000
+#define MAX_HALF_PERIOD_US 22000
+
+
+typedef struct {
+    uint8_t gpio;
+    volatile bool target;
+    bool state;
+} relay_t;
+
+static relay_t relays[RELAY_MAX_COUNT];
+static uint8_t relay_count = 0;
+
+static uint8_t zero_cross_gpio = RELAY_NO_ZERO_CROSS;
+static uint16_t lead_us = 0;
+
+static volatile uint32_t last_crossing = 0;
+static volatile uint32_t half_period_us = DEFAULT_HALF_PERIOD_US;
+
+// Transition waiting for the next crossing
+static volatile bool armed = false;
+static volatile bool scheduled = false;
+static uint8_t pending_gpio;
+static bool pending_on;
+static uint32_t pending_target;
+
+static relay_stats_t stats;
+
+STATIC_TASK(relay, 256);
+static TaskHandle_t relay_task_handle = NULL;
+
+
+static void record_error(uint32_t error) {
+    stats.total_error_us += error;
+    if (error > stats.max_error_us)
+        stats.max_error_us = error;
+}
+
+static void IRAM relay_timer_handler(void *arg) {
+    timer_set_interrupts(FRC1, false);
+    timer_set_run(FRC1, false);
+    scheduled = false;
+
+    if (!armed)
+        return;
+
+    gpio_write(pending_gpio, pending_on);
+    armed = false;
+
+    record_error(sdk_system_get_time() - pending_target);
+    vTaskNotifyGiveFromISR(relay_task_handle, NULL);
+}
+
+static void IRAM zero_cross_handler(uint8_t gpio) {
+    uint32_t now = sdk_system_get_time();
+
+    uint32_t interval = now - last_crossing;
+    last_crossing = now;
+    if (interval >= MIN_HALF_PERIOD_US && interval <= MAX_HALF_PERIOD_US) {
+        // smooth out jitter of the detector
+        half_period_us = (half_period_us * 7 + interval) / 8;
+    }
+
+    if (!armed || scheduled)
+        return;
+
+    // Switch lead_us before one of the next crossings
+    uint32_t delay = half_period_us - (lead_us % half_period_us);
+    pending_target = now + delay;
+    scheduled = true;
+
+    timer_set_timeout(FRC1, delay);
+    timer_set_interrupts(FRC1, true);
+    timer_set_run(FRC1, true);
+}
+
+static void relay_switch(relay_t *relay, bool on) {
+    if (zero_cross_gpio == RELAY_NO_ZERO_CROSS) {
+        gpio_write(relay->gpio, on);
+        return;
+    }
+
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    pending_gpio = relay->gpio;
+    pending_on = on;
+    armed = true;
+
+    // Up to a crossing and a half, plus some slack
+    uint32_t timeout = (half_period_us * 3) / 1000 + POLL_INTERVAL_MS;
+    if (!ulTaskNotifyTake(pdTRUE, timeout / portTICK_PERIOD_MS + 1)) {
+        taskENTER_CRITICAL();
+        bool missed = armed;
+        armed = false;
+        taskEXIT_CRITICAL();
+
+        if (missed) {
+            // no mains signal, do not leave the relay hanging
+            gpio_write(relay->gpio, on);
+            stats.zero_cross_timeouts++;
+        }
+    }
+}
+
+static void relay_task(void *_args) {
+    while (1) {
+        vTaskDelay(POLL_INTERVAL_MS / portTICK_PERIOD_MS);
+
+        for (int i = 0; i < relay_count; i++) {
+            relay_t *relay = &relays[i];
+            bool target = relay->target;
+            if (target == relay->state)
+                continue;
+
+            relay_switch(relay, target);
+            relay->state = target;
+            stats.switches++;
+
+            // Let the inrush of this relay settle before the next one
+            vTaskDelay(RELAY_STAGGER_MS / portTICK_PERIOD_MS);
+        }
+    }
+}
+
+int relay_init(uint8_t _zero_cross_gpio, uint16_t _lead_us) {
+    zero_cross_gpio = _zero_cross_gpio;
+    lead_us = _lead_us;
+
+    if (zero_cross_gpio != RELAY_NO_ZERO_CROSS) {
+        timer_set_interrupts(FRC1, false);
+        timer_set_run(FRC1, false);
+        timer_set_reload(FRC1, false);
+        _xt_isr_attach(INUM_TIMER_FRC1, relay_timer_handler, NULL);
+
+        gpio_enable(zero_cross_gpio, GPIO_INPUT);
+        gpio_set_interrupt(zero_cross_gpio, GPIO_INTTYPE_EDGE_POS, zero_cross_handler);
+    }
+
+    relay_task_handle = STATIC_TASK_CREATE(relay, relay_task, "Relay", NULL, 3);
+    if (!relay_task_handle)
+        return -1;
+
+    return 0;
+}
+
+int relay_create(uint8_t gpio, bool on) {
+    if (relay_count >= RELAY_MAX_COUNT)
+        return -1;
+
+    relay_t *relay = &relays[relay_count];
+    relay->gpio = gpio;
+    relay->target = on;
+    relay->state = on;
+
+    gpio_enable(gpio, GPIO_OUTPUT);
+    gpio_write(gpio, on);
+
+    return relay_count++;
+}
+
+void relay_set(int relay, bool on) {
+    if (relay < 0 || relay >= relay_count)
+        return;
+
+    relays[relay].target = on;
+}
+
+bool relay_get(int relay) {
+    if (relay < 0 || relay >= relay_count)
+        return false;
+
+    return relays[relay].target;
+}
+
+const relay_stats_t *relay_stats() {
+    stats.half_period_us = half_period_us;
+    return &stats;
+}
+
+void relay_stats_dump() {
+    relay_stats();
+
+    printf("relay: %u switches, %u without zero cross\n",
+           stats.switches, stats.zero_cross_timeouts);
+    if (zero_cross_gpio != RELAY_NO_ZERO_CROSS) {
+        uint32_t aligned = stats.switches - stats.zero_cross_timeouts;
+        printf("relay: half period %uus, error avg %uus, max %uus\n",
+               stats.half_period_us,
+               aligned ? stats.total_error_us / aligned : 0,
+               stats.max_error_us);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Relay scheduler: relays are switched by a scheduler task instead
+ * of the moment a setter or a button asks for it.
+ *
+ * - Transitions of different relays are at least RELAY_STAGGER_MS
+ *   apart, so their inrush currents do not add up.
+ * - With a zero-cross detector, every transition is timed so that the
+ *   contacts close at the next zero crossing. The coil is energized
+ *   lead_us before the crossing, to account for the relay's operate
+ *   time.
+ *
+ * Zero-cross timing uses the FRC1 hardware timer, which can not be
+ * shared with the pwm extra.
+ */
+
+#define RELAY_MAX_COUNT 4
+
+// Minimal time between transitions of two relays
+#ifndef RELAY_STAGGER_MS
+#define RELAY_STAGGER_MS 30
+#endif
+
+#define RELAY_NO_ZERO_CROSS 0xFF
+
+typedef struct {
+    uint32_t switches;
+    uint32_t zero_cross_timeouts;   // switched without waiting for a crossing
+    uint32_t half_period_us;        // measured time between crossings
+    uint32_t max_error_us;          // latest switching compared to the target
+    uint32_t total_error_us;
+} relay_stats_t;
+
+/**
+    Starts the scheduler.
+
+    @param zero_cross_gpio GPIO with pulses of a zero-cross detector,
+           or RELAY_NO_ZERO_CROSS.
+    @param lead_us How long before a zero crossing the relay is switched,
+           typically the operate time from its datasheet.
+    @return A negative integer if this method fails.
+*/
+int relay_init(uint8_t zero_cross_gpio, uint16_t lead_us);
+
+/**
+    Configures a relay output and switches it to the initial state
+    right away.
+
+    @param gpio GPIO driving the relay, high is on.
+    @param on Initial state.
+    @return Relay number or a negative integer if this method fails.
+*/
+int relay_create(uint8_t gpio, bool on);
+
+/**
+    Asks the scheduler to switch a relay. Safe to call from interrupt
+    handlers.
+*/
+void relay_set(int relay, bool on);
+
+/**
+    Returns the last requested state of a relay.
+*/
+bool relay_get(int relay);
+
+const relay_stats_t *relay_stats();
+
+void relay_stats_dump();
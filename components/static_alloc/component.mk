@@ -0,0 +1,8 @@
+# Component makefile for static_alloc
+
+# expected anyone using this component includes it as 'static_alloc/static_alloc.h'
+INC_DIRS += $(static_alloc_ROOT)..
+
+EXTRA_CFLAGS += -DconfigSUPPORT_STATIC_ALLOCATION=1
+
+# header only, nothing to compile
@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Usage: ram_report.sh <nm> <elf>
+#
+# Lists data and bss symbols, i.e. everything that is statically
+# allocated in RAM, largest first, followed by the total.
+
+NM=${1:-nm}
+ELF=$2
+
+$NM --print-size --size-sort --reverse-sort "$ELF" | awk '
+function hex(s,    i, n, c) {
+    n = 0
+    s = tolower(s)
+    for (i = 1; i <= length(s); i++) {
+        c = index("0123456789abcdef", substr(s, i, 1)) - 1
+        n = n * 16 + c
+    }
+    return n
+}
+
+$3 ~ /^[bBdD]$/ {
+    size = hex($2)
+    total += size
+    printf "%8d  %s  %s\n", size, ($3 ~ /[bB]/) ? "bss " : "data", $4
+}
+
+END {
+    printf "%8d  total static RAM\n", total
+}'
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <timers.h>
+#include <semphr.h>
+
+/*
+ * Declares tasks, queues and timers together with their memory at
+ * compile time, so creating them never touches the heap and all the
+ * RAM they need shows up in the static RAM report (make ram-report).
+ *
+ *   STATIC_TASK(blink, 256);
+ *   STATIC_QUEUE(events, 10, sizeof(event_t));
+ *   STATIC_MUTEX(lock);
+ *
+ *   TaskHandle_t task = STATIC_TASK_CREATE(blink, blink_task, "Blink", NULL, 2);
+ *   QueueHandle_t queue = STATIC_QUEUE_CREATE(events);
+ *   SemaphoreHandle_t mutex = STATIC_MUTEX_CREATE(lock);
+ *
+ * Each declared resource can be created only once.
+ */
+
+#define STATIC_TASK(name, stack_depth) \
+    static StackType_t name##_task_stack[stack_depth]; \
+    static StaticTask_t name##_task_tcb
+
+#define STATIC_TASK_CREATE(name, fn, task_name, params, priority) \
+    xTaskCreateStatic(fn, task_name, \
+                      sizeof(name##_task_stack) / sizeof(StackType_t), \
+                      params, priority, name##_task_stack, &name##_task_tcb)
+
+#define STATIC_QUEUE(name, length, item_size) \
+    static uint8_t name##_queue_storage[(length) * (item_size)]; \
+    static StaticQueue_t name##_queue_buffer; \
+    enum { name##_queue_length = (length), name##_queue_item_size = (item_size) }
+
+#define STATIC_QUEUE_CREATE(name) \
+    xQueueCreateStatic(name##_queue_length, name##_queue_item_size, \
+                       name##_queue_storage, &name##_queue_buffer)
+
+#define STATIC_TIMER(name) \
+    static StaticTimer_t name##_timer_buffer
+
+#define STATIC_TIMER_CREATE(name, timer_name, period, auto_reload, id, callback) \
+    xTimerCreateStatic(timer_name, period, auto_reload, id, callback, &name##_timer_buffer)
+
+#define STATIC_MUTEX(name) \
+    static StaticSemaphore_t name##_mutex_buffer
+
+#define STATIC_MUTEX_CREATE(name) \
+    xSemaphoreCreateMutexStatic(&name##_mutex_buffer)
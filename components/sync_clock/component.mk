@@ -0,0 +1,9 @@
+# Component makefile for sync_clock
+
+# expected anyone using this component includes it as 'sync_clock/sync_clock.h'
+INC_DIRS += $(sync_clock_ROOT)..
+
+# args for passing into compile rule generation
+sync_clock_SRC_DIR = $(sync_clock_ROOT)
+
+$(eval $(call component_compile_rules,sync_clock))
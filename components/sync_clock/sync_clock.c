@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+#include <espressif/esp_system.h>
+#include <espressif/esp_wifi.h>
+#include <lwip/udp.h>
+#include <lwip/pbuf.h>
+#include <lwip/tcpip.h>
+#include <static_alloc/static_alloc.h>
+
+#include "sync_clock.h"
+
+#define SYNC_MAGIC 0x41434C4B     // "ACLK"
+#define SYNC_VERSION 1
+
+// Beacon, all fields big endian
+#define BEACON_MAGIC 0
+#define BEACON_VERSION 4
+#define BEACON_NODE 8
+#define BEACON_TIME 12
+#define BEACON_SIZE 20
+
+
+static struct udp_pcb *pcb = NULL;
+STATIC_TIMER(beacon);
+static TimerHandle_t beacon_timer = NULL;
+
+// Written in the lwIP thread only
+static sync_clock_stats_t state;
+static TickType_t leader_heard_at;
+static int64_t samples[SYNC_CLOCK_WINDOW];
+static uint8_t sample_count = 0;
+static uint8_t sample_next = 0;
+
+
+static void put_u32(uint8_t *buffer, uint32_t value) {
+    buffer[0] = value >> 24;
+    buffer[1] = value >> 16;
+    buffer[2] = value >> 8;
+    buffer[3] = value;
+}
+
+static uint32_t get_u32(const uint8_t *buffer) {
+    return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
+}
+
+// Local clock extended to 64 bits, it has to be read at least once
+// per wrap around of the system time (71 minutes). Beacon timer does.
+static uint64_t local_us() {
+    static uint32_t last = 0;
+    static uint32_t high = 0;
+
+    uint32_t now = sdk_system_get_time();
+    if (now < last)
+        high++;
+    last = now;
+
+    return ((uint64_t)high << 32) | now;
+}
+
+uint64_t sync_clock_us() {
+    taskENTER_CRITICAL();
+    uint64_t now = local_us() + state.offset_us;
+    taskEXIT_CRITICAL();
+
+    return now;
+}
+
+uint32_t sync_clock_ms() {
+    return sync_clock_us() / 1000;
+}
+
+static void window_reset() {
+    sample_count = 0;
+    sample_next = 0;
+}
+
+static void offset_sample(int64_t sample) {
+    samples[sample_next] = sample;
+    sample_next = (sample_next + 1) % SYNC_CLOCK_WINDOW;
+    if (sample_count < SYNC_CLOCK_WINDOW)
+        sample_count++;
+
+    // samples are only ever made smaller by delays
+    int64_t best = samples[0], worst = samples[0];
+    for (int i = 1; i < sample_count; i++) {
+        if (samples[i] > best)
+            best = samples[i];
+        if (samples[i] < worst)
+            worst = samples[i];
+    }
+    state.jitter_us = best - worst;
+
+    int64_t error = best - state.offset_us;
+    if (!state.synced || error > SYNC_CLOCK_STEP_US || error < -SYNC_CLOCK_STEP_US) {
+        state.steps++;
+    } else {
+        error /= SYNC_CLOCK_SLEW;
+    }
+    state.error_us = error;
+
+    taskENTER_CRITICAL();
+    state.offset_us += error;
+    taskEXIT_CRITICAL();
+
+    state.synced = true;
+}
+
+static void beacon_receive(void *_arg, struct udp_pcb *_pcb, struct pbuf *p,
+                           const ip_addr_t *_addr, u16_t _port) {
+    // taken first, everything after adds to the delay
+    taskENTER_CRITICAL();
+    uint64_t received = local_us();
+    taskEXIT_CRITICAL();
+
+    uint8_t beacon[BEACON_SIZE];
+    if (pbuf_copy_partial(p, beacon, sizeof(beacon), 0) != sizeof(beacon))
+        goto done;
+    if (get_u32(beacon + BEACON_MAGIC) != SYNC_MAGIC || beacon[BEACON_VERSION] != SYNC_VERSION)
+        goto done;
+
+    uint32_t node = get_u32(beacon + BEACON_NODE);
+    if (node == state.node)
+        goto done;
+
+    TickType_t now = xTaskGetTickCount();
+
+    if (state.leading) {
+        if (node > state.node)
+            goto done;
+
+        // lowest id leads
+        state.leading = false;
+    } else if (state.leader && node != state.leader) {
+        bool leader_alive = (now - leader_heard_at) < SYNC_CLOCK_TIMEOUT_MS / portTICK_PERIOD_MS;
+        if (node > state.leader && leader_alive)
+            goto done;
+    }
+
+    bool leader_changed = (node != state.leader);
+    state.leader = node;
+    leader_heard_at = now;
+    state.beacons++;
+
+    uint64_t leader_time = ((uint64_t)get_u32(beacon + BEACON_TIME) << 32) |
+                           get_u32(beacon + BEACON_TIME + 4);
+    int64_t sample = leader_time + SYNC_CLOCK_DELAY_US - received;
+
+    // A new leader that was in sync with the old one goes on with the
+    // same clock and the samples so far stay good. One that was not
+    // is stepped to.
+    int64_t error = sample - state.offset_us;
+    if (leader_changed && (error > SYNC_CLOCK_STEP_US || error < -SYNC_CLOCK_STEP_US)) {
+        window_reset();
+        state.synced = false;
+    }
+
+    offset_sample(sample);
+
+done:
+    pbuf_free(p);
+}
+
+static void beacon_send() {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, BEACON_SIZE, PBUF_RAM);
+    if (!p)
+        return;
+
+    uint8_t *beacon = p->payload;
+    memset(beacon, 0, BEACON_SIZE);
+    put_u32(beacon + BEACON_MAGIC, SYNC_MAGIC);
+    beacon[BEACON_VERSION] = SYNC_VERSION;
+    put_u32(beacon + BEACON_NODE, state.node);
+
+    uint64_t now = sync_clock_us();
+    put_u32(beacon + BEACON_TIME, now >> 32);
+    put_u32(beacon + BEACON_TIME + 4, now);
+
+    udp_sendto(pcb, p, IP_ADDR_BROADCAST, SYNC_CLOCK_PORT);
+    pbuf_free(p);
+}
+
+// Runs in the lwIP thread
+static void beacon_tick(void *_arg) {
+    TickType_t now = xTaskGetTickCount();
+
+    if (!state.leading && now - leader_heard_at >= SYNC_CLOCK_TIMEOUT_MS / portTICK_PERIOD_MS) {
+        // shared clock goes on with the offset it has
+        state.leading = true;
+        state.synced = true;
+        state.leader = state.node;
+    }
+
+    if (state.leading)
+        beacon_send();
+}
+
+static void beacon_timer_fn(TimerHandle_t _timer) {
+    tcpip_callback(beacon_tick, NULL);
+}
+
+int sync_clock_init() {
+    uint8_t macaddr[6];
+    sdk_wifi_get_macaddr(STATION_IF, macaddr);
+
+    memset(&state, 0, sizeof(state));
+    state.node = get_u32(macaddr + 2);
+    leader_heard_at = xTaskGetTickCount();
+
+    beacon_timer = STATIC_TIMER_CREATE(beacon, "Sync clock", SYNC_CLOCK_INTERVAL_MS / portTICK_PERIOD_MS,
+                                       pdTRUE, NULL, beacon_timer_fn);
+    if (!beacon_timer)
+        return -1;
+
+    LOCK_TCPIP_CORE();
+    pcb = udp_new();
+    if (pcb) {
+        ip_set_option(pcb, SOF_BROADCAST);
+        if (udp_bind(pcb, IP_ADDR_ANY, SYNC_CLOCK_PORT) == ERR_OK) {
+            udp_recv(pcb, beacon_receive, NULL);
+        } else {
+            udp_remove(pcb);
+            pcb = NULL;
+        }
+    }
+    UNLOCK_TCPIP_CORE();
+
+    if (!pcb)
+        return -1;
+
+    if (xTimerStart(beacon_timer, 0) != pdPASS)
+        return -1;
+
+    return 0;
+}
+
+sync_clock_stats_t sync_clock_stats() {
+    taskENTER_CRITICAL();
+    sync_clock_stats_t stats = state;
+    taskEXIT_CRITICAL();
+
+    return stats;
+}
+
+void sync_clock_dump() {
+    sync_clock_stats_t stats = sync_clock_stats();
+
+    printf("Sync clock: node %08x, leader %08x%s%s\n", stats.node, stats.leader,
+           stats.leading ? " (this device)" : "", stats.synced ? "" : ", not synced");
+    printf("Sync clock: offset %d ms, last error %d us, jitter %u us\n",
+           (int32_t)(stats.offset_us / 1000), stats.error_us, stats.jitter_us);
+    printf("Sync clock: %u beacons, %u steps\n", stats.beacons, stats.steps);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Clock shared by devices on one network, so animations running on
+ * several devices stay in step.
+ *
+ * The device with the lowest id (from its MAC address) leads and
+ * broadcasts its clock every SYNC_CLOCK_INTERVAL_MS. The others take
+ * the leader's time from the beacon minus their own time at reception
+ * as a sample of the offset between the clocks. Delays on the way only
+ * make samples smaller, so the largest sample of the last
+ * SYNC_CLOCK_WINDOW ones is the best one; the offset is slewed towards
+ * it, or stepped if it is off by more than SYNC_CLOCK_STEP_US.
+ *
+ * Followers lag the leader by the smallest delay of a beacon, from
+ * the leader reading its clock to the follower reading its own, as
+ * nothing measures it. Followers with alike delays still agree with
+ * each other. SYNC_CLOCK_DELAY_US is added to every sample to make up
+ * for the lag where it is known for a network. A follower whose clock
+ * runs fast is also ahead by up to its drift over the window (0.8 ms
+ * at 50 ppm), since the largest samples are then the oldest ones.
+ *
+ * A device that hears no leader for SYNC_CLOCK_TIMEOUT_MS starts to
+ * lead, a leader that hears a lower id steps down. The shared clock
+ * of a device that starts to lead goes on from where it was.
+ *
+ * sync_clock_tool.py simulates several devices on loopback with
+ * jitter and shows how far apart their clocks are. tests/ runs this
+ * code against a simulated leader.
+ */
+
+#define SYNC_CLOCK_PORT 4050
+
+// Time between beacons of the leader
+#ifndef SYNC_CLOCK_INTERVAL_MS
+#define SYNC_CLOCK_INTERVAL_MS 1000
+#endif
+
+// Time without beacons after which a device starts to lead
+#ifndef SYNC_CLOCK_TIMEOUT_MS
+#define SYNC_CLOCK_TIMEOUT_MS (SYNC_CLOCK_INTERVAL_MS * 7 / 2)
+#endif
+
+// Number of offset samples the best one is picked from
+#ifndef SYNC_CLOCK_WINDOW
+#define SYNC_CLOCK_WINDOW 16
+#endif
+
+// Offset errors above this are corrected at once, not slewed
+#ifndef SYNC_CLOCK_STEP_US
+#define SYNC_CLOCK_STEP_US 50000
+#endif
+
+// Smallest delay of beacons, see above
+#ifndef SYNC_CLOCK_DELAY_US
+#define SYNC_CLOCK_DELAY_US 0
+#endif
+
+// Part of the offset error corrected per beacon is 1/SYNC_CLOCK_SLEW
+#ifndef SYNC_CLOCK_SLEW
+#define SYNC_CLOCK_SLEW 4
+#endif
+
+typedef struct {
+    uint32_t node;              // id of this device
+    uint32_t leader;            // id of the leader, 0 if there is none yet
+    bool leading;
+    bool synced;                // following a leader or leading
+
+    int64_t offset_us;          // shared clock minus local clock
+    int32_t error_us;           // last correction of the offset
+    uint32_t jitter_us;         // spread of samples in the window
+    uint32_t beacons;           // beacons received from the leader
+    uint32_t steps;             // times the offset was stepped
+} sync_clock_stats_t;
+
+/**
+    Starts listening for and sending beacons. Call after WiFi was
+    started, the MAC address is needed.
+
+    @return A negative integer if this method fails.
+*/
+int sync_clock_init();
+
+/**
+    Shared time in microseconds.
+*/
+uint64_t sync_clock_us();
+
+/**
+    Shared time in milliseconds, wraps around like tick counts do.
+*/
+uint32_t sync_clock_ms();
+
+/**
+    Returns a copy of the current state.
+*/
+sync_clock_stats_t sync_clock_stats();
+
+/**
+    Prints the state to UART.
+*/
+void sync_clock_dump();
@@ -0,0 +1,254 @@
+#!/usr/bin/env python
+"""
+Simulates sync_clock on several nodes over loopback, or monitors beacons
+of real devices.
+
+Usage:
+    sync_clock_tool.py simulate [--nodes N] [--seconds S] [--interval MS]
+                                [--delay MS] [--jitter MS] [--drift PPM]
+                                [--kill-leader SECONDS] [--compensate MS]
+    sync_clock_tool.py monitor
+
+simulate runs the algorithm of sync_clock.c on N nodes, each with its own
+clock (started at a random time, running off by up to --drift ppm).
+Beacons reach other nodes after --delay plus a random jitter of up to
+--jitter milliseconds. Every second the spread of the shared clocks of
+all nodes is printed; --kill-leader stops the leader to check that
+another node takes over without a jump. --compensate is added to samples
+like SYNC_CLOCK_DELAY_US; without it followers lag the leader by about
+--delay.
+
+monitor prints beacons broadcast by devices on the network.
+"""
+from __future__ import division, print_function
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+PORT = 4050
+MAGIC = 0x41434C4B
+VERSION = 1
+BEACON = struct.Struct('>IB3xIQ')
+
+WINDOW = 16
+STEP_US = 50000
+SLEW = 4
+
+
+class Node(object):
+    def __init__(self, index, node_id, args, network):
+        self.index = index
+        self.id = node_id
+        self.args = args
+        self.network = network
+        self.boot = random.uniform(0, 3600e6)
+        self.rate = 1 + random.uniform(-args.drift, args.drift) * 1e-6
+        self.started = time.time()
+
+        self.lock = threading.Lock()
+        self.offset = 0
+        self.synced = False
+        self.leading = False
+        self.leader = 0
+        self.leader_heard_at = time.time()
+        self.samples = []
+        self.steps = 0
+        self.alive = True
+
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.socket.bind(('127.0.0.1', 0))
+        self.socket.settimeout(0.1)
+        self.port = self.socket.getsockname()[1]
+
+    def local_us(self):
+        return int(self.boot + (time.time() - self.started) * 1e6 * self.rate)
+
+    def shared_us(self):
+        with self.lock:
+            return self.local_us() + self.offset
+
+    def receive(self, beacon):
+        received = self.local_us()
+        magic, version, node, leader_time = BEACON.unpack(beacon)
+        if magic != MAGIC or version != VERSION or node == self.id:
+            return
+
+        with self.lock:
+            now = time.time()
+            if self.leading:
+                if node > self.id:
+                    return
+                self.leading = False
+            elif self.leader and node != self.leader:
+                leader_alive = now - self.leader_heard_at < self.args.timeout
+                if node > self.leader and leader_alive:
+                    return
+
+            leader_changed = node != self.leader
+            self.leader = node
+            self.leader_heard_at = now
+
+            sample = leader_time + self.args.compensate - received
+            if leader_changed and abs(sample - self.offset) > STEP_US:
+                self.samples = []
+                self.synced = False
+
+            self.samples = (self.samples + [sample])[-WINDOW:]
+            error = max(self.samples) - self.offset
+            if not self.synced or abs(error) > STEP_US:
+                self.steps += 1
+            else:
+                error = int(error / SLEW)
+            self.offset += error
+            self.synced = True
+
+    def tick(self):
+        with self.lock:
+            if not self.leading and time.time() - self.leader_heard_at >= self.args.timeout:
+                self.leading = True
+                self.synced = True
+                self.leader = self.id
+            leading = self.leading
+
+        if leading:
+            beacon = BEACON.pack(MAGIC, VERSION, self.id, self.shared_us())
+            self.network.broadcast(self, beacon)
+
+    def run(self):
+        next_tick = time.time()
+        while self.alive:
+            try:
+                self.receive(self.socket.recv(64))
+            except socket.timeout:
+                pass
+
+            if time.time() >= next_tick:
+                self.tick()
+                next_tick += self.args.interval
+
+
+class Network(object):
+    """Broadcasts to every node with a delay and jitter."""
+
+    def __init__(self, args):
+        self.args = args
+        self.nodes = []
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+    def broadcast(self, sender, beacon):
+        for node in self.nodes:
+            if node is sender:
+                continue
+            delay = self.args.delay + random.uniform(0, self.args.jitter)
+            timer = threading.Timer(delay, self.socket.sendto, (beacon, ('127.0.0.1', node.port)))
+            timer.daemon = True
+            timer.start()
+
+
+def simulate(args):
+    network = Network(args)
+    ids = random.sample(range(1, 0xFFFFFFFF), args.nodes)
+    network.nodes = [Node(i, node_id, args, network) for i, node_id in enumerate(ids)]
+
+    threads = []
+    for node in network.nodes:
+        thread = threading.Thread(target=node.run)
+        thread.daemon = True
+        thread.start()
+        threads.append(thread)
+
+    print('%6s %8s %12s %s' % ('time', 'leader', 'spread us', 'offsets from leader us'))
+    start = time.time()
+    killed = False
+    worst = 0
+    while time.time() - start < args.seconds:
+        time.sleep(1)
+        elapsed = time.time() - start
+
+        alive = [node for node in network.nodes if node.alive]
+        leaders = [node for node in alive if node.leading]
+
+        if args.kill_leader and not killed and elapsed >= args.kill_leader and leaders:
+            leaders[0].alive = False
+            killed = True
+            print('# node %08x (leader) stopped' % leaders[0].id)
+            continue
+
+        if len(leaders) != 1 or not all(node.synced for node in alive):
+            print('%6.1f %8s %12s' % (elapsed, '-', 'not synced'))
+            continue
+
+        # read all clocks as close together as possible
+        clocks = [node.shared_us() for node in alive]
+        leader_clock = leaders[0].shared_us()
+        spread = max(clocks) - min(clocks)
+        print('%6.1f %08x %12d %s' % (
+            elapsed, leaders[0].id, spread,
+            ' '.join('%+d' % (clock - leader_clock) for clock in clocks),
+        ))
+
+        # skip the first seconds while the window fills up
+        if elapsed > args.interval * WINDOW + args.timeout:
+            worst = max(worst, spread)
+
+    for node in network.nodes:
+        node.alive = False
+    print('# worst spread after settling: %d us' % worst)
+
+
+def monitor(args):
+    listener = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(('', PORT))
+
+    while True:
+        beacon, address = listener.recvfrom(64)
+        if len(beacon) != BEACON.size:
+            continue
+        magic, version, node, leader_time = BEACON.unpack(beacon)
+        if magic != MAGIC:
+            continue
+        print('%.3f %-15s node %08x time %d.%06d' % (
+            time.time(), address[0], node, leader_time // 1000000, leader_time % 1000000))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Simulates or monitors sync_clock.')
+    commands = parser.add_subparsers(dest='command')
+
+    simulate_parser = commands.add_parser('simulate')
+    simulate_parser.add_argument('--nodes', type=int, default=4)
+    simulate_parser.add_argument('--seconds', type=float, default=30)
+    simulate_parser.add_argument('--interval', type=float, default=1000, help='beacon interval, ms')
+    simulate_parser.add_argument('--delay', type=float, default=1, help='smallest network delay, ms')
+    simulate_parser.add_argument('--jitter', type=float, default=10, help='largest extra delay, ms')
+    simulate_parser.add_argument('--drift', type=float, default=50, help='largest clock error, ppm')
+    simulate_parser.add_argument('--kill-leader', type=float, default=0,
+                                 help='stop the leader after that many seconds')
+    simulate_parser.add_argument('--compensate', type=float, default=0,
+                                 help='delay added to samples, ms (SYNC_CLOCK_DELAY_US)')
+
+    commands.add_parser('monitor')
+
+    args = parser.parse_args()
+    if args.command == 'simulate':
+        args.interval /= 1000
+        args.delay /= 1000
+        args.jitter /= 1000
+        args.compensate = int(args.compensate * 1000)
+        args.timeout = args.interval * 7 / 2
+        simulate(args)
+    elif args.command == 'monitor':
+        monitor(args)
+    else:
+        parser.print_help()
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
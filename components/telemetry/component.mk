@@ -0,0 +1,22 @@
+# Component makefile for telemetry
+
+# expected anyone using this component includes it as 'telemetry/telemetry.h'
+INC_DIRS += $(telemetry_ROOT)..
+
+# args for passing into compile rule generation
+telemetry_SRC_DIR = $(telemetry_ROOT)
+
+# Task list is only available with trace facility enabled.
+# Per-task CPU share needs run time stats, which count microseconds
+# of system time. Set TELEMETRY_RUN_TIME_STATS=0 to skip that.
+TELEMETRY_RUN_TIME_STATS ?= 1
+
+EXTRA_CFLAGS += -DconfigUSE_TRACE_FACILITY=1
+ifeq ($(TELEMETRY_RUN_TIME_STATS),1)
+EXTRA_CFLAGS += \
+	-DconfigGENERATE_RUN_TIME_STATS=1 \
+	'-DportCONFIGURE_TIMER_FOR_RUN_TIME_STATS()=' \
+	'-DportGET_RUN_TIME_COUNTER_VALUE()=({ extern uint32_t sdk_system_get_time(void); sdk_system_get_time(); })'
+endif
+
+$(eval $(call component_compile_rules,telemetry))
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include <static_alloc/static_alloc.h>
+
+#include "telemetry.h"
+
+
+static telemetry_sample_t samples[TELEMETRY_SAMPLES];
+static uint8_t sample_next = 0;
+static uint8_t sample_count = 0;
+
+static telemetry_task_t tasks[TELEMETRY_MAX_TASKS];
+static TaskStatus_t task_status[TELEMETRY_MAX_TASKS];
+static uint32_t last_total_run_time = 0;
+static uint32_t heap_min_free = UINT32_MAX;
+
+STATIC_MUTEX(telemetry);
+STATIC_TASK(telemetry, 384);
+
+static SemaphoreHandle_t lock = NULL;
+
+
+// Memory above the program break was never handed out and is
+// contiguous with the allocator's top chunk, so together they are
+// a lower bound of the largest block malloc() can return.
+static uint32_t heap_largest_block() {
+    struct mallinfo info = mallinfo();
+    uint32_t heap_free = xPortGetFreeHeapSize();
+    uint32_t unused = (heap_free > info.fordblks) ? heap_free - info.fordblks : 0;
+    return unused + info.keepcost;
+}
+
+static telemetry_task_t *task_find(const TaskStatus_t *status) {
+    for (int i = 0; i < TELEMETRY_MAX_TASKS; i++) {
+        telemetry_task_t *task = &tasks[i];
+        if (task->name[0] && task->number == status->xTaskNumber)
+            return task;
+    }
+    return NULL;
+}
+
+// Call it once every running task is marked alive, so only slots of
+// tasks that finished are taken
+static telemetry_task_t *task_add(const TaskStatus_t *status) {
+    telemetry_task_t *free_slot = NULL;
+    for (int i = 0; i < TELEMETRY_MAX_TASKS; i++) {
+        telemetry_task_t *task = &tasks[i];
+        if (!task->name[0] || !task->alive) {
+            free_slot = task;
+            break;
+        }
+    }
+
+    // Tasks that finished are kept until their slot is needed
+    if (free_slot) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        strncpy(free_slot->name, status->pcTaskName, sizeof(free_slot->name) - 1);
+        free_slot->number = status->xTaskNumber;
+        free_slot->stack_min = UINT16_MAX;
+        free_slot->run_time = 0;
+    }
+    return free_slot;
+}
+
+void telemetry_sample() {
+    uint32_t total_run_time = 0;
+    UBaseType_t task_count = uxTaskGetSystemState(task_status, TELEMETRY_MAX_TASKS, &total_run_time);
+    uint32_t elapsed = total_run_time - last_total_run_time;
+
+    uint32_t heap_free = xPortGetFreeHeapSize();
+    uint32_t heap_largest = heap_largest_block();
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    if (heap_free < heap_min_free)
+        heap_min_free = heap_free;
+
+    telemetry_sample_t *sample = &samples[sample_next];
+    sample->time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    sample->heap_free = heap_free;
+    sample->heap_min_free = heap_min_free;
+    sample->heap_largest = heap_largest;
+    sample->idle_permille = 0;
+    sample->task_count = task_count;
+
+    for (int i = 0; i < TELEMETRY_MAX_TASKS; i++)
+        tasks[i].alive = false;
+
+    for (int i = 0; i < task_count; i++) {
+        telemetry_task_t *task = task_find(&task_status[i]);
+        if (task)
+            task->alive = true;
+    }
+
+    for (int i = 0; i < task_count; i++) {
+        TaskStatus_t *status = &task_status[i];
+        telemetry_task_t *task = task_find(status);
+        if (!task)
+            task = task_add(status);
+        if (!task)
+            continue;
+
+        task->alive = true;
+        if (status->usStackHighWaterMark < task->stack_min)
+            task->stack_min = status->usStackHighWaterMark;
+
+#if configGENERATE_RUN_TIME_STATS
+        // first sample of a task covers its whole life
+        uint32_t run_time = status->ulRunTimeCounter - task->run_time;
+        task->run_time = status->ulRunTimeCounter;
+        task->cpu_permille = elapsed ? (uint64_t)run_time * 1000 / elapsed : 0;
+
+        if (!strcmp(task->name, "IDLE"))
+            sample->idle_permille = task->cpu_permille;
+#endif
+    }
+
+    last_total_run_time = total_run_time;
+    sample_next = (sample_next + 1) % TELEMETRY_SAMPLES;
+    if (sample_count < TELEMETRY_SAMPLES)
+        sample_count++;
+
+    xSemaphoreGive(lock);
+}
+
+const telemetry_sample_t *telemetry_get_sample(uint8_t age) {
+    static telemetry_sample_t sample;
+
+    if (age >= sample_count)
+        return NULL;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    sample = samples[(sample_next + TELEMETRY_SAMPLES - age - 1) % TELEMETRY_SAMPLES];
+    xSemaphoreGive(lock);
+
+    return &sample;
+}
+
+void telemetry_dump() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    printf("Telemetry: %u samples every %d ms\n", sample_count, TELEMETRY_INTERVAL_MS);
+    printf("%10s %8s %8s %8s %6s %5s\n", "time", "free", "min", "largest", "idle", "tasks");
+    for (int age = sample_count - 1; age >= 0; age--) {
+        telemetry_sample_t *sample =
+            &samples[(sample_next + TELEMETRY_SAMPLES - age - 1) % TELEMETRY_SAMPLES];
+        printf("%10u %8u %8u %8u %3u.%u%% %5u\n",
+               sample->time, sample->heap_free, sample->heap_min_free, sample->heap_largest,
+               sample->idle_permille / 10, sample->idle_permille % 10, sample->task_count);
+    }
+
+    printf("%-16s %9s %6s %s\n", "task", "stack min", "cpu", "");
+    for (int i = 0; i < TELEMETRY_MAX_TASKS; i++) {
+        telemetry_task_t *task = &tasks[i];
+        if (!task->name[0])
+            continue;
+        printf("%-16s %9u %3u.%u%% %s\n",
+               task->name, task->stack_min,
+               task->cpu_permille / 10, task->cpu_permille % 10,
+               task->alive ? "" : "(finished)");
+    }
+
+    xSemaphoreGive(lock);
+}
+
+int telemetry_summary(char *buffer, size_t size) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    const telemetry_sample_t *sample =
+        &samples[(sample_next + TELEMETRY_SAMPLES - 1) % TELEMETRY_SAMPLES];
+    int len = snprintf(buffer, size, "heap %u/%u/%u idle %u%%",
+                       sample->heap_free, sample->heap_min_free, sample->heap_largest,
+                       sample->idle_permille / 10);
+
+    // tasks with the least stack left go first
+    bool listed[TELEMETRY_MAX_TASKS] = {};
+    while (len < size) {
+        int lowest = -1;
+        for (int i = 0; i < TELEMETRY_MAX_TASKS; i++) {
+            if (!tasks[i].name[0] || listed[i])
+                continue;
+            if (lowest < 0 || tasks[i].stack_min < tasks[lowest].stack_min)
+                lowest = i;
+        }
+        if (lowest < 0)
+            break;
+
+        listed[lowest] = true;
+        len += snprintf(buffer + len, size - len, " %s:%u", tasks[lowest].name, tasks[lowest].stack_min);
+    }
+
+    xSemaphoreGive(lock);
+
+    return (len < size) ? len : size - 1;
+}
+
+homekit_value_t telemetry_homekit_get() {
+    static char summary[TELEMETRY_SUMMARY_LEN + 1];
+    telemetry_summary(summary, sizeof(summary));
+
+    homekit_value_t value = HOMEKIT_STRING(summary);
+    value.is_static = true;
+    return value;
+}
+
+static void telemetry_task(void *_args) {
+    int dump_counter = 0;
+
+    while (1) {
+        telemetry_sample();
+
+        if (TELEMETRY_DUMP_EVERY && ++dump_counter >= TELEMETRY_DUMP_EVERY) {
+            dump_counter = 0;
+            telemetry_dump();
+        }
+
+        vTaskDelay(TELEMETRY_INTERVAL_MS / portTICK_PERIOD_MS);
+    }
+}
+
+int telemetry_init() {
+    lock = STATIC_MUTEX_CREATE(telemetry);
+    if (!lock)
+        return -1;
+
+    if (!STATIC_TASK_CREATE(telemetry, telemetry_task, "Telemetry", NULL, 1))
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <homekit/types.h>
+
+/*
+ * Periodically samples heap usage, stack high water marks and CPU
+ * share of every task, so stack sizes and heap margins can be tuned
+ * from real data. Samples are kept in a fixed ring, tasks in a fixed
+ * table which remembers tasks that already finished (e.g. identify).
+ */
+
+// Interval between samples
+#ifndef TELEMETRY_INTERVAL_MS
+#define TELEMETRY_INTERVAL_MS 10000
+#endif
+
+// Number of samples kept
+#ifndef TELEMETRY_SAMPLES
+#define TELEMETRY_SAMPLES 12
+#endif
+
+// Number of tasks tracked
+#ifndef TELEMETRY_MAX_TASKS
+#define TELEMETRY_MAX_TASKS 16
+#endif
+
+// Print everything to UART every that many samples, 0 to disable
+#ifndef TELEMETRY_DUMP_EVERY
+#define TELEMETRY_DUMP_EVERY 6
+#endif
+
+#define TELEMETRY_TASK_NAME_LEN 16
+
+typedef struct {
+    uint32_t time;              // milliseconds since boot
+    uint32_t heap_free;
+    uint32_t heap_min_free;     // lowest free heap seen so far
+    uint32_t heap_largest;      // lower bound of the largest free block
+    uint16_t idle_permille;     // CPU share of the idle task since the previous sample
+    uint8_t task_count;
+} telemetry_sample_t;
+
+typedef struct {
+    char name[TELEMETRY_TASK_NAME_LEN];
+    uint32_t number;
+    uint32_t run_time;          // run time counter at the last sample
+    uint16_t stack_min;         // lowest stack high water mark seen, in words
+    uint16_t cpu_permille;      // CPU share since the previous sample
+    bool alive;
+} telemetry_task_t;
+
+/**
+    Starts the sampling task.
+
+    @return A negative integer if this method fails.
+*/
+int telemetry_init();
+
+/**
+    Takes a sample right away.
+*/
+void telemetry_sample();
+
+/**
+    Returns sample taken that many samples ago (0 being the latest) or
+    NULL if there is no such sample. Result is a copy and stays valid
+    until the next call.
+*/
+const telemetry_sample_t *telemetry_get_sample(uint8_t age);
+
+/**
+    Prints samples and tasks to UART.
+*/
+void telemetry_dump();
+
+/**
+    Formats a short summary: heap numbers and tasks with the least
+    stack left.
+
+    @return Length of the summary.
+*/
+int telemetry_summary(char *buffer, size_t size);
+
+homekit_value_t telemetry_homekit_get();
+
+#define TELEMETRY_SUMMARY_LEN 128
+
+/**
+    Custom read-only characteristic with telemetry summary, add it
+    to any service with HOMEKIT_CHARACTERISTIC(CUSTOM_TELEMETRY).
+*/
+#define HOMEKIT_CHARACTERISTIC_CUSTOM_TELEMETRY HOMEKIT_CUSTOM_UUID("F0000101")
+#define HOMEKIT_DECLARE_CHARACTERISTIC_CUSTOM_TELEMETRY(...) \
+    .type = HOMEKIT_CHARACTERISTIC_CUSTOM_TELEMETRY, \
+    .description = "Telemetry", \
+    .format = homekit_format_string, \
+    .permissions = homekit_permissions_paired_read, \
+    .max_len = (int[]) {TELEMETRY_SUMMARY_LEN}, \
+    .getter = telemetry_homekit_get, \
+    .value = HOMEKIT_STRING_(""), \
+    ##__VA_ARGS__
@@ -0,0 +1,21 @@
+# Component makefile for trace
+
+# expected anyone using this component includes it as 'trace/trace.h'
+INC_DIRS += $(trace_ROOT)..
+
+# args for passing into compile rule generation
+trace_SRC_DIR = $(trace_ROOT)
+
+# Set to 0 to compile all TRACE_* macros out
+TRACE ?= 1
+
+# Set to 1 to also record FreeRTOS task switches
+TRACE_TASKS ?= 0
+
+EXTRA_CFLAGS += -DTRACE_ENABLED=$(TRACE)
+
+ifeq ($(TRACE_TASKS),1)
+EXTRA_CFLAGS += '-DtraceTASK_SWITCHED_IN()={ extern void trace_task_switched_in(void *task); trace_task_switched_in(pxCurrentTCB); }'
+endif
+
+$(eval $(call component_compile_rules,trace))
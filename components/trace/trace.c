@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <string.h>
+#include <esp8266.h>
+#include <espressif/esp_system.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "trace.h"
+
+#if TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)
+#error TRACE_BUFFER_SIZE should be a power of 2
+#endif
+
+#define TASK_NAME_LEN 16
+
+
+static trace_event_t events[TRACE_BUFFER_SIZE];
+static uint32_t head = 0;           // total number of events recorded
+static volatile bool paused = false;
+
+static const char *names[TRACE_MAX_NAMES];
+
+static void *tasks[TRACE_MAX_TASKS];
+static char task_names[TRACE_MAX_TASKS][TASK_NAME_LEN];
+
+
+static inline uint32_t ccount() {
+    uint32_t value;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (value));
+    return value;
+}
+
+// Unlike taskENTER_CRITICAL these nest inside the scheduler, which
+// calls the task switch hook with interrupts already masked
+static inline uint32_t irq_disable() {
+    uint32_t ps;
+    __asm__ volatile ("rsil %0, 15" : "=a" (ps) :: "memory");
+    return ps;
+}
+
+static inline void irq_restore(uint32_t ps) {
+    __asm__ volatile ("wsr %0, ps; rsync" :: "a" (ps) : "memory");
+}
+
+void trace_name(uint8_t name, const char *label) {
+    if (name < TRACE_MAX_NAMES)
+        names[name] = label;
+}
+
+void IRAM trace_event(trace_event_type_t type, uint8_t name, uint16_t arg) {
+    if (paused)
+        return;
+
+    uint32_t ps = irq_disable();
+    trace_event_t *event = &events[head++ & (TRACE_BUFFER_SIZE - 1)];
+    event->ccount = ccount();
+    event->type = type;
+    event->name = name;
+    event->arg = arg;
+    irq_restore(ps);
+}
+
+// Called by the scheduler with TRACE_TASKS=1, see component.mk
+void IRAM trace_task_switched_in(void *task) {
+    int index;
+    for (index = 0; index < TRACE_MAX_TASKS; index++) {
+        if (tasks[index] == task)
+            break;
+
+        if (!tasks[index]) {
+            tasks[index] = task;
+            strncpy(task_names[index], pcTaskGetName(task), TASK_NAME_LEN - 1);
+            break;
+        }
+    }
+
+    // tasks past the table are all shown as the last one
+    if (index == TRACE_MAX_TASKS)
+        index--;
+
+    trace_event(TRACE_EVENT_TASK, 0, index);
+}
+
+void trace_dump() {
+    paused = true;
+
+    uint32_t count = (head < TRACE_BUFFER_SIZE) ? head : TRACE_BUFFER_SIZE;
+
+    printf("TRACE BEGIN %u %u\n", sdk_system_get_cpu_freq(), head - count);
+
+    for (int i = 0; i < TRACE_MAX_NAMES; i++) {
+        if (names[i])
+            printf("N %d %s\n", i, names[i]);
+    }
+    for (int i = 0; i < TRACE_MAX_TASKS && tasks[i]; i++) {
+        printf("T %d %s\n", i, task_names[i]);
+    }
+
+    for (uint32_t i = head - count; i != head; i++) {
+        trace_event_t *event = &events[i & (TRACE_BUFFER_SIZE - 1)];
+        printf("E %08x %x %x %x\n", event->ccount, event->type, event->name, event->arg);
+    }
+
+    printf("TRACE END\n");
+
+    head = 0;
+    paused = false;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Binary event tracer.
+ *
+ * Events are 8 byte records with a CPU cycle timestamp, kept in a
+ * ring buffer that overwrites the oldest ones. Recording an event
+ * masks interrupts for a handful of instructions and never blocks,
+ * so it can be used in interrupt handlers and timing critical code
+ * where a printf would block on the UART.
+ *
+ * trace_dump() prints the buffer as text, which trace2chrome.py turns
+ * into a Chrome/Perfetto trace:
+ *
+ *     make monitor | tee dump.txt
+ *     python ../../components/trace/trace2chrome.py dump.txt > trace.json
+ *
+ * Build with TRACE_TASKS=1 to also record task switches.
+ */
+
+// Number of events kept, a power of 2
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 256
+#endif
+
+// Maximum number of event names
+#define TRACE_MAX_NAMES 32
+
+// Maximum number of tasks told apart
+#define TRACE_MAX_TASKS 16
+
+typedef enum {
+    TRACE_EVENT_BEGIN = 0,
+    TRACE_EVENT_END,
+    TRACE_EVENT_INSTANT,
+    TRACE_EVENT_COUNTER,
+    TRACE_EVENT_TASK,           // task switch, arg is task number
+} trace_event_type_t;
+
+typedef struct {
+    uint32_t ccount;            // CPU cycles
+    uint8_t type;               // see trace_event_type_t
+    uint8_t name;
+    uint16_t arg;
+} trace_event_t;
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(name) trace_event(TRACE_EVENT_BEGIN, name, 0)
+#define TRACE_END(name) trace_event(TRACE_EVENT_END, name, 0)
+#define TRACE_INSTANT(name, arg) trace_event(TRACE_EVENT_INSTANT, name, arg)
+#define TRACE_COUNTER(name, value) trace_event(TRACE_EVENT_COUNTER, name, value)
+#else
+#define TRACE_BEGIN(name) do {} while (0)
+#define TRACE_END(name) do {} while (0)
+#define TRACE_INSTANT(name, arg) do {} while (0)
+#define TRACE_COUNTER(name, value) do {} while (0)
+#endif
+
+/**
+    Names an event for the dump.
+
+    @param name Event number, 0 to TRACE_MAX_NAMES - 1.
+    @param label Name shown in the trace viewer, must stay valid.
+*/
+void trace_name(uint8_t name, const char *label);
+
+/**
+    Records an event. Use the TRACE_* macros instead, so tracing can
+    be compiled out.
+*/
+void trace_event(trace_event_type_t type, uint8_t name, uint16_t arg);
+
+/**
+    Prints all recorded events and clears the buffer. Recording is
+    paused while the dump is printed.
+*/
+void trace_dump();
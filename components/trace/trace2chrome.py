@@ -0,0 +1,120 @@
+#!/usr/bin/env python
+"""
+Converts a dump printed by trace_dump() into Chrome trace JSON, which
+can be opened in chrome://tracing or https://ui.perfetto.dev
+
+Usage: trace2chrome.py [dump.txt] > trace.json
+
+Reads standard input if no file is given. Lines outside of the dump,
+like other log output, are ignored. If the log holds several dumps,
+they are all converted one after another.
+"""
+import json
+import sys
+
+BEGIN, END, INSTANT, COUNTER, TASK = range(5)
+
+CCOUNT_WRAP = 1 << 32
+
+
+def convert(lines):
+    trace = []
+    offset = 0.0        # time of the end of the previous dump
+
+    dump = None
+    for line in lines:
+        fields = line.strip().split(' ', 2)
+        if len(fields) < 2:
+            continue
+
+        if fields[0] == 'TRACE' and fields[1] == 'BEGIN':
+            fields = fields[2].split()
+            dump = {
+                'mhz': int(fields[0]),
+                'dropped': int(fields[1]),
+                'names': {},
+                'tasks': {},
+                'events': [],
+            }
+        elif dump is None:
+            continue
+        elif fields[0] == 'N':
+            dump['names'][int(fields[1])] = fields[2]
+        elif fields[0] == 'T':
+            dump['tasks'][int(fields[1])] = fields[2]
+        elif fields[0] == 'E':
+            ccount, kind, name, arg = (int(x, 16) for x in line.split()[1:5])
+            dump['events'].append((ccount, kind, name, arg))
+        elif fields[0] == 'TRACE' and fields[1] == 'END':
+            offset = convert_dump(dump, offset, trace)
+            dump = None
+
+    return {'traceEvents': trace, 'displayTimeUnit': 'ms'}
+
+
+def convert_dump(dump, offset, trace):
+    names = dump['names']
+    tasks = dump['tasks']
+    mhz = dump['mhz']
+
+    if dump['dropped']:
+        sys.stderr.write('%d oldest events were overwritten\n' % dump['dropped'])
+
+    for index, task in tasks.items():
+        trace.append({'ph': 'M', 'name': 'thread_name', 'pid': 0,
+                      'tid': index, 'args': {'name': task}})
+
+    # Events are in recording order, so cycle counter wraps show up
+    # as going back in time
+    cycles = 0
+    previous = None
+    task = -1
+    ts = offset
+    for ccount, kind, name, arg in dump['events']:
+        if previous is not None:
+            cycles += (ccount - previous) % CCOUNT_WRAP
+        previous = ccount
+        ts = offset + float(cycles) / mhz
+
+        label = names.get(name, 'event %d' % name)
+
+        if kind == TASK:
+            if task >= 0:
+                trace.append({'ph': 'E', 'name': 'running', 'pid': 0,
+                              'tid': task, 'ts': ts})
+            task = arg
+            trace.append({'ph': 'B', 'name': 'running', 'pid': 0,
+                          'tid': task, 'ts': ts})
+        elif kind == BEGIN:
+            trace.append({'ph': 'B', 'name': label, 'pid': 0,
+                          'tid': task, 'ts': ts})
+        elif kind == END:
+            trace.append({'ph': 'E', 'name': label, 'pid': 0,
+                          'tid': task, 'ts': ts})
+        elif kind == INSTANT:
+            trace.append({'ph': 'i', 'name': label, 'pid': 0, 'tid': task,
+                          'ts': ts, 's': 't', 'args': {'arg': arg}})
+        elif kind == COUNTER:
+            trace.append({'ph': 'C', 'name': label, 'pid': 0,
+                          'ts': ts, 'args': {label: arg}})
+
+    if task >= 0:
+        trace.append({'ph': 'E', 'name': 'running', 'pid': 0,
+                      'tid': task, 'ts': ts})
+
+    return ts
+
+
+def main():
+    if len(sys.argv) > 1:
+        with open(sys.argv[1]) as f:
+            trace = convert(f)
+    else:
+        trace = convert(sys.stdin)
+
+    json.dump(trace, sys.stdout, indent=1)
+    sys.stdout.write('\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,20 @@
+# Component makefile for wifi_fast
+
+# expected anyone using this component includes it as 'wifi_fast/wifi_fast.h'
+INC_DIRS += $(wifi_fast_ROOT)..
+
+# args for passing into compile rule generation
+wifi_fast_SRC_DIR = $(wifi_fast_ROOT)
+
+# Flash sector where last connection is cached, by default the one
+# right after HomeKit storage
+WIFI_FAST_FLASH_ADDR ?= ($(HOMEKIT_SPI_FLASH_BASE_ADDR) + 0x1000)
+
+# Set to 1 to reuse the cached DHCP lease as a static address
+WIFI_FAST_STATIC_IP ?= 0
+
+wifi_fast_CFLAGS = $(CFLAGS) \
+	-DWIFI_FAST_FLASH_ADDR='$(WIFI_FAST_FLASH_ADDR)' \
+	-DWIFI_FAST_STATIC_IP=$(WIFI_FAST_STATIC_IP)
+
+$(eval $(call component_compile_rules,wifi_fast))
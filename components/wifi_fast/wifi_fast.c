@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <espressif/esp_common.h>
+#include <espressif/esp_wifi.h>
+#include <espressif/esp_sta.h>
+#include <espressif/esp_system.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <spiflash.h>
+
+#include "wifi_fast.h"
+
+#ifndef WIFI_FAST_FLASH_ADDR
+#error WIFI_FAST_FLASH_ADDR is not defined
+#endif
+
+#ifndef WIFI_FAST_STATIC_IP
+#define WIFI_FAST_STATIC_IP 0
+#endif
+
+#define WIFI_FAST_MAGIC 0x57464331
+
+#define POLL_INTERVAL_MS 10
+#define SCAN_TIMEOUT_MS 2000
+
+#define INFO(message, ...) printf(">>> wifi_fast: " message "\n", ##__VA_ARGS__);
+
+
+typedef struct {
+    uint32_t magic;
+    uint32_t ssid_hash;         // cache is only valid for the same network
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t bssid_valid;
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t checksum;
+} wifi_cache_t;
+
+typedef enum {
+    WIFI_FAST_IDLE = 0,
+    WIFI_FAST_DIRECT,           // connecting to the cached access point
+    WIFI_FAST_SCAN,             // regular connect with scan and DHCP
+    WIFI_FAST_CONNECTED,
+} wifi_fast_state_t;
+
+
+static struct sdk_station_config station_config;
+static wifi_cache_t cache;
+static wifi_fast_state_t state = WIFI_FAST_IDLE;
+static uint32_t start_time;
+
+static volatile bool scan_done;
+static uint8_t scan_channel;
+static uint8_t scan_bssid[6];
+static bool scan_found;
+
+
+static uint32_t elapsed_ms() {
+    return (sdk_system_get_time() - start_time) / 1000;
+}
+
+// FNV-1a
+static uint32_t hash(const uint8_t *data, size_t size) {
+    uint32_t h = 2166136261;
+    for (size_t i = 0; i < size; i++) {
+        h ^= data[i];
+        h *= 16777619;
+    }
+    return h;
+}
+
+static uint32_t cache_checksum(const wifi_cache_t *c) {
+    return hash((const uint8_t *)c, offsetof(wifi_cache_t, checksum));
+}
+
+static uint32_t ssid_hash() {
+    return hash(station_config.ssid, strnlen((char *)station_config.ssid, sizeof(station_config.ssid)));
+}
+
+static bool cache_load() {
+    if (!spiflash_read(WIFI_FAST_FLASH_ADDR, (uint8_t *)&cache, sizeof(cache)))
+        return false;
+
+    return cache.magic == WIFI_FAST_MAGIC &&
+           cache.checksum == cache_checksum(&cache) &&
+           cache.ssid_hash == ssid_hash();
+}
+
+static void cache_save(const wifi_cache_t *c) {
+    wifi_cache_t stored;
+    if (spiflash_read(WIFI_FAST_FLASH_ADDR, (uint8_t *)&stored, sizeof(stored)) &&
+            !memcmp(&stored, c, sizeof(stored))) {
+        // nothing changed, spare the flash
+        return;
+    }
+
+    if (!spiflash_erase_sector(WIFI_FAST_FLASH_ADDR) ||
+            !spiflash_write(WIFI_FAST_FLASH_ADDR, (uint8_t *)c, sizeof(*c))) {
+        INFO("Failed to save connection cache");
+        return;
+    }
+
+    INFO("Connection cache saved (%u ms)", elapsed_ms());
+}
+
+void wifi_fast_forget() {
+    spiflash_erase_sector(WIFI_FAST_FLASH_ADDR);
+}
+
+bool wifi_fast_connected() {
+    return state == WIFI_FAST_CONNECTED;
+}
+
+static bool wait_for_ip(uint32_t timeout_ms) {
+    uint32_t waited = 0;
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) {
+        if (timeout_ms && waited >= timeout_ms)
+            return false;
+
+        vTaskDelay(POLL_INTERVAL_MS / portTICK_PERIOD_MS);
+        waited += POLL_INTERVAL_MS;
+    }
+    return true;
+}
+
+static void connect_direct() {
+    state = WIFI_FAST_DIRECT;
+
+    struct sdk_station_config config = station_config;
+    config.bssid_set = cache.bssid_valid;
+    memcpy(config.bssid, cache.bssid, sizeof(config.bssid));
+    sdk_wifi_station_set_config(&config);
+    sdk_wifi_set_channel(cache.channel);
+
+#if WIFI_FAST_STATIC_IP
+    if (cache.ip) {
+        struct ip_info info;
+        info.ip.addr = cache.ip;
+        info.netmask.addr = cache.netmask;
+        info.gw.addr = cache.gw;
+
+        sdk_wifi_station_dhcpc_stop();
+        sdk_wifi_set_ip_info(STATION_IF, &info);
+    }
+#endif
+
+    INFO("Connecting to cached access point on channel %d (%u ms)", cache.channel, elapsed_ms());
+    sdk_wifi_station_connect();
+}
+
+static void connect_scan() {
+    state = WIFI_FAST_SCAN;
+
+    sdk_wifi_station_disconnect();
+
+    struct sdk_station_config config = station_config;
+    config.bssid_set = 0;
+    sdk_wifi_station_set_config(&config);
+    sdk_wifi_station_dhcpc_start();
+
+    INFO("Connecting with full scan (%u ms)", elapsed_ms());
+    sdk_wifi_station_connect();
+}
+
+static void scan_done_cb(void *arg, sdk_scan_status_t status) {
+    scan_found = false;
+
+    if (status == SCAN_OK) {
+        // first entry is a list head, not an access point
+        struct sdk_bss_info *bss = ((struct sdk_bss_info *)arg)->next.stqe_next;
+        int8_t best_rssi = INT8_MIN;
+        for (; bss; bss = bss->next.stqe_next) {
+            if (bss->channel == scan_channel && bss->rssi > best_rssi) {
+                best_rssi = bss->rssi;
+                memcpy(scan_bssid, bss->bssid, sizeof(scan_bssid));
+                scan_found = true;
+            }
+        }
+    }
+
+    scan_done = true;
+}
+
+// The SDK does not report which access point it joined, so look it up
+// with a scan limited to our network on the current channel. It runs
+// after the connection is up, off the critical path.
+static bool lookup_bssid(uint8_t channel) {
+    struct sdk_scan_config config = {
+        .ssid = station_config.ssid,
+        .channel = channel,
+    };
+
+    scan_channel = channel;
+    scan_done = false;
+    if (!sdk_wifi_station_scan(&config, scan_done_cb))
+        return false;
+
+    for (int waited = 0; !scan_done && waited < SCAN_TIMEOUT_MS; waited += POLL_INTERVAL_MS)
+        vTaskDelay(POLL_INTERVAL_MS / portTICK_PERIOD_MS);
+
+    return scan_done && scan_found;
+}
+
+static void cache_update(bool direct) {
+    wifi_cache_t updated = cache;
+    updated.magic = WIFI_FAST_MAGIC;
+    updated.ssid_hash = ssid_hash();
+
+    struct ip_info info;
+    if (sdk_wifi_get_ip_info(STATION_IF, &info)) {
+        updated.ip = info.ip.addr;
+        updated.netmask = info.netmask.addr;
+        updated.gw = info.gw.addr;
+    }
+
+    uint8_t channel = sdk_wifi_get_channel();
+    if (!direct || !cache.bssid_valid || channel != cache.channel) {
+        updated.channel = channel;
+        updated.bssid_valid = lookup_bssid(channel);
+        if (updated.bssid_valid)
+            memcpy(updated.bssid, scan_bssid, sizeof(updated.bssid));
+    }
+
+    updated.checksum = cache_checksum(&updated);
+    cache = updated;
+    cache_save(&cache);
+}
+
+static void wifi_fast_task(void *_args) {
+    bool direct = false;
+
+    if (cache_load()) {
+        connect_direct();
+        direct = wait_for_ip(WIFI_FAST_DIRECT_TIMEOUT_MS);
+        if (!direct)
+            INFO("Cached access point did not connect (%u ms)", elapsed_ms());
+    } else {
+        INFO("No cached connection");
+    }
+
+    if (!direct) {
+        connect_scan();
+        wait_for_ip(0);
+    }
+
+    state = WIFI_FAST_CONNECTED;
+    INFO("Got IP via %s (%u ms)", direct ? "cached access point" : "full scan", elapsed_ms());
+
+    cache_update(direct);
+
+    vTaskDelete(NULL);
+}
+
+int wifi_fast_connect(const char *ssid, const char *password) {
+    // both are kept with a terminating zero, a longer one would not
+    // match the network
+    size_t ssid_len = strnlen(ssid, sizeof(station_config.ssid));
+    size_t password_len = strnlen(password, sizeof(station_config.password));
+    if (ssid_len >= sizeof(station_config.ssid) || password_len >= sizeof(station_config.password)) {
+        INFO("SSID or password too long");
+        return -1;
+    }
+
+    start_time = sdk_system_get_time();
+
+    memset(&station_config, 0, sizeof(station_config));
+    memcpy(station_config.ssid, ssid, ssid_len);
+    memcpy(station_config.password, password, password_len);
+
+    sdk_wifi_set_opmode(STATION_MODE);
+
+    if (xTaskCreate(wifi_fast_task, "wifi_fast", 384, NULL, 2, NULL) != pdPASS)
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+
+/*
+ * Connection manager that remembers the access point, channel and
+ * DHCP lease of the last successful connection in flash.
+ *
+ * On boot it first connects directly to the cached access point on
+ * its channel, skipping the full scan, and optionally reuses the
+ * lease as a static address, skipping DHCP. If that does not succeed
+ * in time, it falls back to a regular connect with scan and DHCP.
+ * Time to each stage is printed.
+ */
+
+// How long to wait for the cached access point before falling back
+#ifndef WIFI_FAST_DIRECT_TIMEOUT_MS
+#define WIFI_FAST_DIRECT_TIMEOUT_MS 4000
+#endif
+
+/**
+    Starts connecting to the network in background.
+
+    @param ssid Network name, up to 31 characters.
+    @param password Network password, up to 63 characters.
+    @return A negative integer if this method fails or the SSID or
+            password is too long.
+*/
+int wifi_fast_connect(const char *ssid, const char *password);
+
+/**
+    Returns true once the station got an IP address.
+*/
+bool wifi_fast_connected();
+
+/**
+    Forgets the cached connection, e.g. on configuration reset.
+*/
+void wifi_fast_forget();
@@ -20,57 +20,53 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <static_alloc/static_alloc.h>
+#include <wifi_fast/wifi_fast.h>
+#include <journal/journal.h>
+#include <char_cache/char_cache.h>
+#include <trace/trace.h>
+#include <iram_profile/iram_profile.h>
 #include "wifi.h"
 
-#include <math.h>  //requires LIBS ?= hal m to be added to Makefile
+#include <fixmath/fixmath.h>
 #include "mjpwm.h"
 
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 //http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
-void hsi2rgbw(float h, float s, float i, int* rgbw) {
+void hsi2rgbw(q16_t h, q16_t s, q16_t i, int* rgbw) {
     int r, g, b, w;
-    float cos_h, cos_1047_h;
-    //h = fmod(h,360); // cycle h around to 0-360 degrees
-    h = 3.14159*h/(float)180; // Convert to radians.
-    s /=(float)100; i/=(float)100; //from percentage to ratio
-    s = s>0?(s<1?s:1):0; // clamp s and i to interval [0,1]
-    i = i>0?(i<1?i:1):0;
-    i = i*sqrt(i); //shape intensity to have finer granularity near 0
-
-    if(h < 2.09439) {
-        cos_h = cos(h);
-        cos_1047_h = cos(1.047196667-h);
-        r = s*4095*i/3*(1+cos_h/cos_1047_h);
-        g = s*4095*i/3*(1+(1-cos_h/cos_1047_h));
+    q16_t ratio, base;
+    h = q16_mod(h, Q16(360)); // cycle h around to 0-360 degrees
+    s /= 100; i /= 100; //from percentage to ratio
+    s = q16_clamp(s, 0, Q16_ONE); // clamp s and i to interval [0,1]
+    i = q16_clamp(i, 0, Q16_ONE);
+    i = q16_mul(i, q16_sqrt(i)); //shape intensity to have finer granularity near 0
+    base = q16_mul(s, i)*4095/3;
+
+    if(h < Q16(120)) {
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60)-h));
+        r = q16_round(q16_mul(base, Q16_ONE+ratio));
+        g = q16_round(q16_mul(base, Q16_ONE+(Q16_ONE-ratio)));
         b = 0;
-        w = 4095*(1-s)*i;
-    } else if(h < 4.188787) {
-        h = h - 2.09439;
-        cos_h = cos(h);
-        cos_1047_h = cos(1.047196667-h);
-        g = s*4095*i/3*(1+cos_h/cos_1047_h);
-        b = s*4095*i/3*(1+(1-cos_h/cos_1047_h));
+        w = q16_round(q16_mul(Q16_ONE-s, i)*4095);
+    } else if(h < Q16(240)) {
+        h = h - Q16(120);
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60)-h));
+        g = q16_round(q16_mul(base, Q16_ONE+ratio));
+        b = q16_round(q16_mul(base, Q16_ONE+(Q16_ONE-ratio)));
         r = 0;
-        w = 4095*(1-s)*i;
+        w = q16_round(q16_mul(Q16_ONE-s, i)*4095);
     } else {
-        h = h - 4.188787;
-        cos_h = cos(h);
-        cos_1047_h = cos(1.047196667-h);
-        b = s*4095*i/3*(1+cos_h/cos_1047_h);
-        r = s*4095*i/3*(1+(1-cos_h/cos_1047_h));
+        h = h - Q16(240);
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60)-h));
+        b = q16_round(q16_mul(base, Q16_ONE+ratio));
+        r = q16_round(q16_mul(base, Q16_ONE+(Q16_ONE-ratio)));
         g = 0;
-        w = 4095*(1-s)*i;
+        w = q16_round(q16_mul(Q16_ONE-s, i)*4095);
     }
 
     rgbw[0]=r;
@@ -82,22 +78,61 @@ void hsi2rgbw(float h, float s, float i, int* rgbw) {
 #define PIN_DI 				13
 #define PIN_DCKI 			15
 
-float hue,sat,bri;
-bool on;
+// Journal keys of the light state
+#define JOURNAL_ON 0
+#define JOURNAL_BRIGHTNESS 1
+#define JOURNAL_HUE 2
+#define JOURNAL_SATURATION 3
+
+// Trace events
+#define TRACE_LIGHT_SET 0
+#define TRACE_HUE 1
+#define TRACE_SATURATION 2
+#define TRACE_BRIGHTNESS 3
+#define TRACE_WHITE 4
+
+void light_commit(char_cache_t *cache);
+
+// Values written by controllers are applied to the light together
+char_cache_t light_cache = CHAR_CACHE_(light_commit);
+
+homekit_characteristic_t light_on = HOMEKIT_CHARACTERISTIC_(
+    ON, true, .callback=CHAR_CACHE_CALLBACK(light_cache)
+);
+homekit_characteristic_t light_bri = HOMEKIT_CHARACTERISTIC_(
+    BRIGHTNESS, 100, .callback=CHAR_CACHE_CALLBACK(light_cache)
+);
+homekit_characteristic_t light_hue = HOMEKIT_CHARACTERISTIC_(
+    HUE, 0, .callback=CHAR_CACHE_CALLBACK(light_cache)
+);
+homekit_characteristic_t light_sat = HOMEKIT_CHARACTERISTIC_(
+    SATURATION, 0, .callback=CHAR_CACHE_CALLBACK(light_cache)
+);
 
 void lightSET(void) {
+    q16_t hue = q16_from_float(light_hue.value.float_value);
+    q16_t sat = q16_from_float(light_sat.value.float_value);
+    q16_t bri = q16_from_int(light_bri.value.int_value);
+
+    // traced instead of printed, printing blocks on the UART
+    TRACE_BEGIN(TRACE_LIGHT_SET);
+
     int rgbw[4];
-    if (on) {
-        printf("h=%d,s=%d,b=%d => ",(int)hue,(int)sat,(int)bri);
-        
+    if (light_on.value.bool_value) {
+        TRACE_COUNTER(TRACE_HUE, q16_round(hue));
+        TRACE_COUNTER(TRACE_SATURATION, q16_round(sat));
+        TRACE_COUNTER(TRACE_BRIGHTNESS, q16_round(bri));
+
         hsi2rgbw(hue,sat,bri,rgbw);
-        printf("r=%d,g=%d,b=%d,w=%d\n",rgbw[0],rgbw[1],rgbw[2],rgbw[3]);
-        
+        TRACE_COUNTER(TRACE_WHITE, rgbw[3]);
+
         mjpwm_send_duty(rgbw[0],rgbw[1],rgbw[2],rgbw[3]);
     } else {
-        printf("off\n");
+        TRACE_COUNTER(TRACE_BRIGHTNESS, 0);
         mjpwm_send_duty(     0,      0,      0,      0 );
     }
+
+    TRACE_END(TRACE_LIGHT_SET);
 }
 
 void light_init() {
@@ -110,76 +145,60 @@ void light_init() {
         .resv = 0,
     };
     mjpwm_init(PIN_DI, PIN_DCKI, 1, init_cmd);
-    on=true; hue=0; sat=0; bri=100; //this should not be here, but part of the homekit init work
+    journal_restore(JOURNAL_ON, &light_on);
+    journal_restore(JOURNAL_BRIGHTNESS, &light_bri);
+    journal_restore(JOURNAL_HUE, &light_hue);
+    journal_restore(JOURNAL_SATURATION, &light_sat);
     lightSET();
 }
 
-homekit_value_t light_on_get() {
-    return HOMEKIT_BOOL(on);
-}
-void light_on_set(homekit_value_t value) {
-    if (value.format != homekit_format_bool) {
-        printf("Invalid on-value format: %d\n", value.format);
-        return;
-    }
-    on = value.bool_value;
+void light_commit(char_cache_t *cache) {
     lightSET();
-}
 
-homekit_value_t light_bri_get() {
-    return HOMEKIT_INT(bri);
-}
-void light_bri_set(homekit_value_t value) {
-    if (value.format != homekit_format_int) {
-        printf("Invalid bri-value format: %d\n", value.format);
-        return;
-    }
-    bri = value.int_value;
-    lightSET();
+    journal_save(JOURNAL_ON, &light_on);
+    journal_save(JOURNAL_BRIGHTNESS, &light_bri);
+    journal_save(JOURNAL_HUE, &light_hue);
+    journal_save(JOURNAL_SATURATION, &light_sat);
 }
 
-homekit_value_t light_hue_get() {
-    return HOMEKIT_FLOAT(hue);
-}
-void light_hue_set(homekit_value_t value) {
-    if (value.format != homekit_format_float) {
-        printf("Invalid hue-value format: %d\n", value.format);
-        return;
-    }
-    hue = value.float_value;
-    lightSET();
-}
 
-homekit_value_t light_sat_get() {
-    return HOMEKIT_FLOAT(sat);
-}
-void light_sat_set(homekit_value_t value) {
-    if (value.format != homekit_format_float) {
-        printf("Invalid sat-value format: %d\n", value.format);
-        return;
+STATIC_TASK(light_identify, 256);
+TaskHandle_t light_identify_task_handle = NULL;
+
+void light_identify_task(void *_args) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (int i=0;i<5;i++) {
+            mjpwm_send_duty(4095,    0,    0,    0);
+            vTaskDelay(300 / portTICK_PERIOD_MS); //0.3 sec
+            mjpwm_send_duty(   0, 4095,    0,    0);
+            vTaskDelay(300 / portTICK_PERIOD_MS); //0.3 sec
+            mjpwm_send_duty(   0,    0, 4095,    0);
+            vTaskDelay(300 / portTICK_PERIOD_MS); //0.3 sec
+        }
+        lightSET();
     }
-    sat = value.float_value;
-    lightSET();
 }
 
+// Printing the traces takes a while, so it is done below the server
+// priority instead of in the identify callback
+STATIC_TASK(light_dump, 512);
+TaskHandle_t light_dump_task_handle = NULL;
 
-void light_identify_task(void *_args) {
-    for (int i=0;i<5;i++) {
-        mjpwm_send_duty(4095,    0,    0,    0);
-        vTaskDelay(300 / portTICK_PERIOD_MS); //0.3 sec
-        mjpwm_send_duty(   0, 4095,    0,    0);
-        vTaskDelay(300 / portTICK_PERIOD_MS); //0.3 sec
-        mjpwm_send_duty(   0,    0, 4095,    0);
-        vTaskDelay(300 / portTICK_PERIOD_MS); //0.3 sec
-    }
-    lightSET();
+void light_dump_task(void *_args) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-    vTaskDelete(NULL);
+        trace_dump();
+        iram_profile_dump();
+    }
 }
 
 void light_identify(homekit_value_t _value) {
     printf("Light Identify\n");
-    xTaskCreate(light_identify_task, "Light identify", 256, NULL, 2, NULL);
+    xTaskNotifyGive(light_identify_task_handle);
+    xTaskNotifyGive(light_dump_task_handle);
 }
 
 
@@ -200,26 +219,10 @@ homekit_accessory_t *accessories[] = {
                 }),
             HOMEKIT_SERVICE(LIGHTBULB, .primary=true,
                 .characteristics=(homekit_characteristic_t*[]){
-                    HOMEKIT_CHARACTERISTIC(
-                        ON, true,
-                        .getter=light_on_get,
-                        .setter=light_on_set
-                    ),
-                    HOMEKIT_CHARACTERISTIC(
-                        BRIGHTNESS, 100,
-                        .getter=light_bri_get,
-                        .setter=light_bri_set
-                    ),
-                    HOMEKIT_CHARACTERISTIC(
-                        HUE, 0,
-                        .getter=light_hue_get,
-                        .setter=light_hue_set
-                    ),
-                    HOMEKIT_CHARACTERISTIC(
-                        SATURATION, 0,
-                        .getter=light_sat_get,
-                        .setter=light_sat_set
-                    ),
+                    &light_on,
+                    &light_bri,
+                    &light_hue,
+                    &light_sat,
                     NULL
                 }),
             NULL
@@ -234,8 +237,18 @@ homekit_server_config_t config = {
 
 void user_init(void) {
     uart_set_baud(0, 115200);
+    light_identify_task_handle = STATIC_TASK_CREATE(light_identify, light_identify_task, "Light identify", NULL, 2);
+    light_dump_task_handle = STATIC_TASK_CREATE(light_dump, light_dump_task, "Light dump", NULL, 1);
+
+    trace_name(TRACE_LIGHT_SET, "lightSET");
+    trace_name(TRACE_HUE, "hue");
+    trace_name(TRACE_SATURATION, "saturation");
+    trace_name(TRACE_BRIGHTNESS, "brightness");
+    trace_name(TRACE_WHITE, "white");
 
+    journal_init();
     wifi_init();
     light_init();
+    char_cache_init();
     homekit_server_init(&config);
 }
@@ -13,18 +13,13 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <static_alloc/static_alloc.h>
+#include <wifi_fast/wifi_fast.h>
 #include "wifi.h"
 
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 const int led_gpio = 2;
@@ -39,26 +34,31 @@ void led_init() {
     led_write(led_on);
 }
 
+STATIC_TASK(led_identify, 128);
+TaskHandle_t led_identify_task_handle = NULL;
+
 void led_identify_task(void *_args) {
-    for (int i=0; i<3; i++) {
-        for (int j=0; j<2; j++) {
-            led_write(true);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            led_write(false);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (int i=0; i<3; i++) {
+            for (int j=0; j<2; j++) {
+                led_write(true);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+                led_write(false);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+            }
+
+            vTaskDelay(250 / portTICK_PERIOD_MS);
         }
 
-        vTaskDelay(250 / portTICK_PERIOD_MS);
+        led_write(led_on);
     }
-
-    led_write(led_on);
-
-    vTaskDelete(NULL);
 }
 
 void led_identify(homekit_value_t _value) {
     printf("LED identify\n");
-    xTaskCreate(led_identify_task, "LED identify", 128, NULL, 2, NULL);
+    xTaskNotifyGive(led_identify_task_handle);
 }
 
 homekit_value_t led_on_get() {
@@ -111,6 +111,7 @@ homekit_server_config_t config = {
 
 void user_init(void) {
     uart_set_baud(0, 115200);
+    led_identify_task_handle = STATIC_TASK_CREATE(led_identify, led_identify_task, "LED identify", NULL, 2);
 
     uint8_t macaddr[6];
     sdk_wifi_get_macaddr(STATION_IF, macaddr);
@@ -8,6 +8,7 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <wifi_fast/wifi_fast.h>
 #include "wifi.h"
 #include "button.h"
 
@@ -18,14 +19,7 @@
 
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 
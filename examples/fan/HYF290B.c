@@ -1,11 +1,14 @@
 #include "HYF290B.h"
 //#include <etstimer.h>
+#include <esp8266.h>
 #include <esplibs/libmain.h>
 #include <espressif/esp_system.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
+#include <static_alloc/static_alloc.h>
+#include <logger/logger.h>
 
 // How response the LED "off" detection is. If the timer goes this many milliseconds
 // without being reset by the LED lines being properly set, the LED will be detected
@@ -59,7 +62,7 @@ static struct {
   uint8_t npulses;
   uint8_t last_npulses;
   uint8_t last_mode;
-  float speed;
+  uint8_t speed;
   uint8_t int_speed;
 
   uint8_t power_btn;
@@ -69,6 +72,9 @@ static struct {
   on_off_state_cb_t power_callback;
   on_off_state_cb_t oscillate_callback;
   uint32_t last_activity_timer;
+  // the monitor tasks run, until then nothing reports the state the
+  // buttons are pushed for
+  volatile bool started;
 } g_motor_config;
 
 
@@ -88,12 +94,12 @@ typedef struct {
   uint8_t gpio_source;
 } motor_evt_t;
 
+STATIC_QUEUE(oscillation_evt, 2, sizeof(uint32_t));
 QueueHandle_t g_oscillation_evt_q;
 void oscillation_monitor_task(void *pvParameters) {
   uint32_t ts = 0;
   BaseType_t ret;
 
-  g_oscillation_evt_q = xQueueCreate(2, sizeof(uint32_t));
   gpio_enable(g_motor_config.oscillation_pin, GPIO_INPUT);
   gpio_set_interrupt(g_motor_config.oscillation_pin, GPIO_INTTYPE_EDGE_NEG, oscillation_pin_cb);
 
@@ -132,6 +138,7 @@ void power_monitor_task(void *pvParameters) {
   }
 }
 
+STATIC_QUEUE(motor_evt, 10, sizeof(motor_evt_t));
 QueueHandle_t g_motor_evt_q;
 void motor_monitor_task(void *pvParameters) {
   uint32_t last_ts = 0;
@@ -141,7 +148,6 @@ void motor_monitor_task(void *pvParameters) {
   BaseType_t ret;
 
   g_motor_config.last_activity_timer = 0;
-  g_motor_evt_q = xQueueCreate(10, sizeof(motor_evt_t));
   gpio_enable(g_motor_config.hi_pin, GPIO_INPUT);
   gpio_enable(g_motor_config.med_pin, GPIO_INPUT);
   gpio_set_interrupt(g_motor_config.hi_pin, GPIO_INTTYPE_EDGE_NEG, motor_pin_cb);
@@ -156,11 +162,10 @@ void motor_monitor_task(void *pvParameters) {
     }
     g_motor_config.last_activity_timer = evt.ts;
     npulses++;
-    // printf("%i\n", evt.ts - last_ts);
+    LOG_DEBUG("motor pulse after %d us", evt.ts - last_ts);
     if (evt.ts - last_ts > PULSE_LENGTH_US) {
       if (evt.gpio_source == g_motor_config.med_pin) {
-        // printf("%i\n", evt.ts - last_ts);
-        // printf("npulses: %i last_npulses: %i\n", npulses, last_npulses);
+        LOG_DEBUG("npulses: %d last_npulses: %d", npulses, last_npulses);
         if (last_npulses == npulses) {
           continue;
         }
@@ -224,7 +229,7 @@ void HYF290B_init(uint8_t motor_hi_pin,
                   uint8_t power_btn_pin,
                   uint8_t speed_btn_pin,
                   uint8_t oscillate_btn_pin) {
-  printf("Starting HYF290B driver...\n");
+  LOG_INFO("Starting HYF290B driver...");
   g_motor_config.hi_pin = motor_hi_pin;
   g_motor_config.med_pin = motor_med_pin;
   g_motor_config.oscillation_pin = oscillation_pin;
@@ -235,45 +240,49 @@ void HYF290B_init(uint8_t motor_hi_pin,
   g_motor_config.speed_btn = speed_btn_pin;
   g_motor_config.oscillate_btn = oscillate_btn_pin;
 
-  printf("HYF290B driver running!\n");
+  LOG_INFO("HYF290B driver running!");
 }
 
+STATIC_TASK(motor_monitor, 256);
+STATIC_TASK(power_monitor, 256);
+STATIC_TASK(oscillation_monitor, 256);
+
 void HYF290B_start(void) {
     // Setup buttons
     button_pusher_init(g_motor_config.power_btn);
     button_pusher_init(g_motor_config.speed_btn);
     button_pusher_init(g_motor_config.oscillate_btn);
 
-    xTaskCreate(motor_monitor_task, "MotorMonitorTask", 256, &g_motor_evt_q, 3, NULL);
-    xTaskCreate(power_monitor_task, "PowerMonitorTask", 256, NULL, 2, NULL);
-    xTaskCreate(oscillation_monitor_task, "OscillationMonitorTask", 256, g_oscillation_evt_q, 2, NULL);
+    // Queues are created before the tasks that feed them from interrupts
+    g_motor_evt_q = STATIC_QUEUE_CREATE(motor_evt);
+    g_oscillation_evt_q = STATIC_QUEUE_CREATE(oscillation_evt);
+
+    STATIC_TASK_CREATE(motor_monitor, motor_monitor_task, "MotorMonitorTask", &g_motor_evt_q, 3);
+    STATIC_TASK_CREATE(power_monitor, power_monitor_task, "PowerMonitorTask", NULL, 2);
+    STATIC_TASK_CREATE(oscillation_monitor, oscillation_monitor_task, "OscillationMonitorTask", g_oscillation_evt_q, 2);
+    g_motor_config.started = true;
 }
 
-void HYF290B_speed_set(float speed) {
-  printf("fan speed set to %f\n", speed);
-  uint8_t target_speed = 0;
-  if (0.0 <= speed && speed <= 4.0) {
+void HYF290B_speed_set(uint8_t speed) {
+  LOG_INFO("fan speed set to %d", speed);
+  if (!g_motor_config.started) {
+    LOG_WARNING("HYF290B not started yet");
+    return;
+  }
+  if (speed <= 4) {
     HYF290B_power_set(false);
     return;
-  } else if (4.0 < speed && speed <= 22.2) {
+  }
+
+  // Steps of 11.1%, except that speed 1 covers everything up to 22.2%
+  uint8_t target_speed = (speed * 9 + 99) / 100 - 1;
+  if (target_speed < 1) {
     target_speed = 1;
-  } else if (22.2 < speed && speed <= 33.3) {
-    target_speed = 2;
-  } else if (33.3 < speed && speed <= 44.4) {
-    target_speed = 3;
-  } else if (44.4 < speed && speed <= 55.5) {
-    target_speed = 4;
-  } else if (55.5 < speed && speed <= 66.6) {
-    target_speed = 5;
-  } else if (66.6 < speed && speed <= 77.7) {
-    target_speed = 6;
-  } else if (77.7 < speed && speed <= 88.8) {
-    target_speed = 7;
-  } else {
+  } else if (target_speed > 8) {
     target_speed = 8;
   }
   if (target_speed != g_motor_config.int_speed) {
-    printf("Changing speed from %i to %i\n", g_motor_config.int_speed, target_speed);
+    LOG_INFO("Changing speed from %d to %d", g_motor_config.int_speed, target_speed);
     if (!g_motor_config.power) {
       HYF290B_power_set(true);
     }
@@ -284,13 +293,17 @@ void HYF290B_speed_set(float speed) {
   }
 }
 
-float HYF290B_speed_get(void) {
+uint8_t HYF290B_speed_get(void) {
   return g_motor_config.speed;
 }
 
 
 void HYF290B_oscillation_set(bool on_off) {
-  printf("Oscillation set to %i", on_off);
+  LOG_INFO("Oscillation set to %d", on_off);
+  if (!g_motor_config.started) {
+    LOG_WARNING("HYF290B not started yet");
+    return;
+  }
   while (g_motor_config.oscillate != on_off) {
     push_button(g_motor_config.oscillate_btn);
     vTaskDelay(100);
@@ -302,7 +315,11 @@ bool HYF290B_oscillation_get(void) {
 }
 
 void HYF290B_power_set(bool on_off) {
-  printf("Fan power %i\n", on_off);
+  LOG_INFO("Fan power %d", on_off);
+  if (!g_motor_config.started) {
+    LOG_WARNING("HYF290B not started yet");
+    return;
+  }
   while (g_motor_config.power != on_off) {
     push_button(g_motor_config.power_btn);
     vTaskDelay(100);
@@ -313,7 +330,7 @@ bool HYF290B_power_get(void) {
   return g_motor_config.power;
 }
 
-static void motor_pin_cb(uint8_t gpio) {
+static void IRAM motor_pin_cb(uint8_t gpio) {
   motor_evt_t evt = {sdk_system_get_time(), gpio};
   xQueueSendToBackFromISR(g_motor_evt_q, &evt, NULL);
 }
@@ -321,25 +338,25 @@ static void motor_pin_cb(uint8_t gpio) {
 static void report_speed(uint8_t speed) {
   switch(speed) {
     case 1:
-      g_motor_config.callback(12.5);
+      g_motor_config.callback(13);
       break;
     case 2:
-      g_motor_config.callback(25.0);
+      g_motor_config.callback(25);
       break;
     case 3:
-      g_motor_config.callback(37.5);
+      g_motor_config.callback(38);
       break;
     case 4:
-      g_motor_config.callback(50.0);
+      g_motor_config.callback(50);
       break;
     case 5:
-      g_motor_config.callback(62.5);
+      g_motor_config.callback(63);
       break;
     case 6:
-      g_motor_config.callback(75.0);
+      g_motor_config.callback(75);
       break;
     case 7:
-      g_motor_config.callback(87.5);
+      g_motor_config.callback(88);
       break;
     case 8:
       g_motor_config.callback(100);
@@ -348,7 +365,7 @@ static void report_speed(uint8_t speed) {
 }
 
 
-static void oscillation_pin_cb(uint8_t gpio_num) {
+static void IRAM oscillation_pin_cb(uint8_t gpio_num) {
   uint32_t ts = sdk_system_get_time();
   xQueueSendToFrontFromISR(g_oscillation_evt_q, &ts, NULL);
 }
@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include <stdbool.h>
-typedef void (*fan_speed_cb_t)(float speed);
+// Speeds are in percent, 0 to 100
+typedef void (*fan_speed_cb_t)(uint8_t speed);
 typedef void (*on_off_state_cb_t)(bool on_off);
 void HYF290B_init(uint8_t motor_hi_pin,
                   uint8_t motor_med_pin,
@@ -12,8 +13,8 @@ void HYF290B_init(uint8_t motor_hi_pin,
                   uint8_t speed_btn_pin,
                   uint8_t oscillate_btn_pin);
 void HYF290B_start(void);
-void HYF290B_speed_set(float speed);
-float HYF290B_speed_get(void);
+void HYF290B_speed_set(uint8_t speed);
+uint8_t HYF290B_speed_get(void);
 void HYF290B_power_set(bool on_off);
 bool HYF290B_power_get(void);
 void HYF290B_oscillation_set(bool on_off);
@@ -8,6 +8,12 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <wifi_fast/wifi_fast.h>
+#include <telemetry/telemetry.h>
+#include <boot_profile/boot_profile.h>
+#include <char_cache/char_cache.h>
+#include <logger/logger.h>
+#include <iram_profile/iram_profile.h>
 #include "wifi.h"
 
 #include "HYF290B.h"
@@ -31,70 +37,53 @@
 #define LINE_OSC 12
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 void fan_identify(homekit_value_t _value) {
   // called to identify the accessory
   // spin the fan up and down a couple times
-    printf("Fan identify\n");
+    LOG_INFO("Fan identify");
+    iram_profile_dump();
 }
 
-homekit_value_t fan_active_get(void) {
-  return HOMEKIT_UINT8(HYF290B_power_get());
-}
-
-void fan_active_set(homekit_value_t value) {
-  HYF290B_power_set(value.int_value);
-}
+void fan_commit(char_cache_t *cache);
 
-void rotation_speed_set(homekit_value_t value) {
-  HYF290B_speed_set(value.float_value);
-}
-
-homekit_value_t rotation_speed_get(void) {
-  return HOMEKIT_FLOAT(HYF290B_speed_get());
-}
-
-void swing_mode_set(homekit_value_t value) {
-  HYF290B_oscillation_set(value.int_value);
-}
-
-homekit_value_t swing_mode_get(void) {
-  return HOMEKIT_UINT8(HYF290B_oscillation_get());
-}
+// Controllers read values from RAM, and writes are applied to the fan
+// from the commit task, so pressing its buttons does not stall the
+// HomeKit server
+char_cache_t fan_cache = CHAR_CACHE_(fan_commit);
 
 // Initially (physically) turned off
 homekit_characteristic_t fan_active = HOMEKIT_CHARACTERISTIC_(
         ACTIVE,
         0,
-        .getter=fan_active_get,
-        .setter=fan_active_set
+        .callback=CHAR_CACHE_CALLBACK(fan_cache)
     );
 
 // Initially not spinning
 homekit_characteristic_t rotation_speed = HOMEKIT_CHARACTERISTIC_(
         ROTATION_SPEED,
         0.0,
-        .getter=rotation_speed_get,
-        .setter=rotation_speed_set
+        .callback=CHAR_CACHE_CALLBACK(fan_cache)
     );
 
 // Initially not swinging (oscillating)
 homekit_characteristic_t swing_mode = HOMEKIT_CHARACTERISTIC_(
         SWING_MODE,
         0,
-        .getter=swing_mode_get,
-        .setter=swing_mode_set
+        .callback=CHAR_CACHE_CALLBACK(fan_cache)
     );
 
+void fan_commit(char_cache_t *cache) {
+  if (char_cache_dirty(cache, &rotation_speed))
+    HYF290B_speed_set(rotation_speed.value.float_value + 0.5f);
+  if (char_cache_dirty(cache, &fan_active))
+    HYF290B_power_set(fan_active.value.int_value);
+  if (char_cache_dirty(cache, &swing_mode))
+    HYF290B_oscillation_set(swing_mode.value.int_value);
+}
+
 
 homekit_accessory_t *accessories[] = {
     HOMEKIT_ACCESSORY(
@@ -110,6 +99,7 @@ homekit_accessory_t *accessories[] = {
                     HOMEKIT_CHARACTERISTIC(MODEL, "HYF290B"),
                     HOMEKIT_CHARACTERISTIC(FIRMWARE_REVISION, "0.1"),
                     HOMEKIT_CHARACTERISTIC(IDENTIFY, fan_identify),
+                    HOMEKIT_CHARACTERISTIC(CUSTOM_TELEMETRY),
                     NULL
                 },
             ),
@@ -130,19 +120,19 @@ homekit_accessory_t *accessories[] = {
     NULL
 };
 
-void fan_speed_changed_cb(float speed) {
-  printf("Fan speed: %f\n", speed);
-  homekit_characteristic_notify(&rotation_speed, HOMEKIT_FLOAT(speed));
+void fan_speed_changed_cb(uint8_t speed) {
+  LOG_INFO("Fan speed: %d", speed);
+  char_cache_update(&fan_cache, &rotation_speed, HOMEKIT_FLOAT(speed));
 }
 
 void power_state_changed_cb(bool on_off) {
-  printf("Power state: %i\n", on_off);
-  homekit_characteristic_notify(&fan_active, HOMEKIT_UINT8(on_off));
+  LOG_INFO("Power state: %d", on_off);
+  char_cache_update(&fan_cache, &fan_active, HOMEKIT_UINT8(on_off));
 }
 
 void oscillation_state_changed_cb(bool on_off) {
-  printf("Oscillation state: %i\n", on_off);
-  homekit_characteristic_notify(&swing_mode, HOMEKIT_UINT8(on_off));
+  LOG_INFO("Oscillation state: %d", on_off);
+  char_cache_update(&fan_cache, &swing_mode, HOMEKIT_UINT8(on_off));
 }
 
 homekit_server_config_t config = {
@@ -152,7 +142,12 @@ homekit_server_config_t config = {
 
 void user_init(void) {
     uart_set_baud(0, 115200);
+    // GPIO2 drives the motor, so the log can not move to UART1
+    logger_init(LOGGER_SINK_UART0);
+    boot_profile_init();
+    telemetry_init();
     wifi_init();
+    boot_profile_mark("wifi init");
     HYF290B_init( MOTOR_HI_PIN,
                   MOTOR_MED_PIN,
                   LINE_OSC,
@@ -164,6 +159,11 @@ void user_init(void) {
                   BTN_OSCILLATE
                 );
 
+    char_cache_init();
     homekit_server_init(&config);
-    HYF290B_start();
+    boot_profile_mark("homekit");
+
+    // Driver tasks are started while WiFi associates
+    boot_profile_async("HYF290B", HYF290B_start, 256);
+    boot_profile_watch_wifi();
 }
@@ -14,6 +14,10 @@
  * Fireplace exposes itself as a HomeKit light bulb with
  * brightness setting.
  *
+ * Built with FIREPLACE_PLAYBACK=1 it plays a fire recorded on the
+ * host and written to flash with 'make flash-anim', dimmed to the
+ * brightness, and prints how long a frame takes either way at boot.
+ *
  * See demo.gif for demonstration.
  */
 #include <stdio.h>
@@ -28,20 +32,22 @@
 #include <homekit/homekit.h>
 #include <homekit/types.h>
 #include <homekit/characteristics.h>
+#include <wifi_fast/wifi_fast.h>
 
 #include <ws2812_i2s/ws2812_i2s.h>
+#include <frame_buffer/frame_buffer.h>
+#include <animation/animation.h>
+#include <power_limit/power_limit.h>
+#include <palette/palette.h>
+#include <matrix/matrix.h>
+#include <telemetry/telemetry.h>
+#include <boot_profile/boot_profile.h>
+#include <flash_anim/flash_anim.h>
 
 #include "wifi.h"
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 homekit_characteristic_t brightness = HOMEKIT_CHARACTERISTIC_(BRIGHTNESS, 50);
@@ -55,68 +61,36 @@ homekit_characteristic_t brightness = HOMEKIT_CHARACTERISTIC_(BRIGHTNESS, 50);
 /* Refresh rate. Higher makes for flickerier
    Recommend small values for small displays */
 #define FPS 17
-#define FPS_DELAY (1000 / FPS / portTICK_PERIOD_MS)
 
 /* Rate of cooling. Play with to change fire from
    roaring (larger values) to weak (smaller values) */
 #define COOLING 55
 
+/* Current the power supply can give to the LEDs */
+#define POWER_BUDGET_MA 2000
 
-ws2812_pixel_t heat_colors[16] = {
-    { .color=0x000000 },
-    { .color=0x330000 },
-    { .color=0x660000 },
-    { .color=0x990000 },
-    { .color=0xcc0000 },
-    { .color=0xff0000 },
-    { .color=0xff3300 },
-    { .color=0xff6600 },
-    { .color=0xff9900 },
-    { .color=0xffcc00 },
-    { .color=0xffff00 },
-    { .color=0xffff33 },
-    { .color=0xffff66 },
-    { .color=0xffff99 },
-    { .color=0xffffcc },
-    { .color=0xffffff },
-};
-
-static int min(int a, int b) {
-    return (a > b) ? b : a;
-}
+/* Frames timed by the benchmark of the recorded fire */
+#define BENCH_FRAMES 100
 
-uint8_t scale(uint8_t x, uint8_t s) {
-    return (((uint16_t)x) * s) >> 8;
-}
 
-ws2812_pixel_t heat_color(uint8_t index) {
-    // Since palette is only 16 colors, uses high 4 bits if index
-    // to pick to palette colors and lower 4 bits to interpolate
-    // between those two colors.
-    ws2812_pixel_t lo_color = heat_colors[index >> 4];
-    if (!(index & 0xf))
-        return lo_color;
-
-    ws2812_pixel_t hi_color = heat_colors[min((index >> 4) + 1, 15)];
-    uint8_t s2 = (index & 0xf) << 4;
-    uint8_t s1 = 255 - s2;
-
-    return (ws2812_pixel_t) {
-        .red = scale(lo_color.red, s1) + scale(hi_color.red, s2),
-        .green = scale(lo_color.green, s1) + scale(hi_color.green, s2),
-        .blue = scale(lo_color.blue, s1) + scale(hi_color.blue, s2),
-    };
-}
-
-
-
-ws2812_pixel_t pixels[NUM_LEDS];
+ws2812_pixel_t frame_pixels[2 * NUM_LEDS];
+frame_buffer_t frames;
+power_limit_t power_limit;
+animation_t fireplace;
+flash_anim_t fire_recording;
+uint16_t matrix_map[NUM_LEDS];
+matrix_t matrix;
 bool fireplace_on = false;
 
-void fireplace_update() {
+// Set once the strip is set up, controllers can use the accessory before
+static volatile bool fireplace_ready = false;
+
+static bool fireplace_render(ws2812_pixel_t *pixels, uint32_t frame, void *_context) {
     // Update fire animation
     static unsigned int stack[WIDTH][HEIGHT] = {};
 
+    const palette_t *palette = palette_fire();
+
     unsigned int hot = 256 * brightness.value.int_value / 100;
     unsigned int maxhot = hot * HEIGHT;
 
@@ -147,96 +121,123 @@ void fireplace_update() {
     for (int i = 0; i < WIDTH; i++) {
         for (int j = 0; j < HEIGHT; j++) {
             uint8_t index = ((unsigned long)stack[i][j]) / HEIGHT * 2;
-            ws2812_pixel_t color = heat_color(index);
-
-            if (i % 2 == 0) {
-                pixels[(i*HEIGHT) + j] = color;
-            } else {
-                pixels[(i*HEIGHT) + HEIGHT - j - 1] = color;
-            }
+            matrix_set(&matrix, pixels, i, j, palette_color(palette, index));
         }
     }
 
-    ws2812_i2s_update(pixels, PIXEL_RGB);
+    return true;
 }
 
-void fireplace_clear() {
-    memset(pixels, 0, sizeof(pixels));
-    ws2812_i2s_update(pixels, PIXEL_RGB);
-}
-
-void fireplace_task(void *_arg) {
-    while (fireplace_on) {
-        fireplace_update();
+// Fire recorded at full heat, dimmed to the brightness
+static bool fireplace_playback_render(ws2812_pixel_t *pixels, uint32_t frame, void *_context) {
+    flash_anim_render(pixels, frame, &fire_recording);
 
-        vTaskDelay(FPS_DELAY);
+    uint16_t scale = 256 * brightness.value.int_value / 100;
+    for (int i = 0; i < NUM_LEDS; i++) {
+        pixels[i].red = pixels[i].red * scale >> 8;
+        pixels[i].green = pixels[i].green * scale >> 8;
+        pixels[i].blue = pixels[i].blue * scale >> 8;
     }
 
-    fireplace_clear();
-    vTaskDelete(NULL);
+    return true;
 }
 
-void fireplace_init() {
-    ws2812_i2s_init(NUM_LEDS, PIXEL_RGB);
-    memset(pixels, 0, sizeof(pixels));
-}
+// Red column sweeping left and right twice, between two blank frames
+static bool fireplace_identify_render(ws2812_pixel_t *pixels, uint32_t frame, void *_context) {
+    ws2812_pixel_t red = { .color=0x990000 };
+    const uint32_t sweep = 2 * WIDTH - 2;
 
-void fireplace_start() {
-    fireplace_on = true;
-    xTaskCreate(fireplace_task, "Fireplace", 256, NULL, 2, NULL);
-}
+    memset(pixels, 0, NUM_LEDS * sizeof(ws2812_pixel_t));
+    if (frame == 0)
+        return true;
 
-void _fill_column(int column, ws2812_pixel_t color) {
-    if (column % 2 == 0) {
-        for (int j = 0; j < HEIGHT; j++)
-            pixels[(column*HEIGHT) + j] = color;
-    } else {
-        for (int j = 0; j < HEIGHT; j++)
-            pixels[(column*HEIGHT) + HEIGHT - j - 1] = color;
-    }
+    uint32_t step = frame - 1;
+    if (step >= 2 * sweep)
+        return false;
+
+    step %= sweep;
+    uint8_t column = (step < WIDTH) ? step : sweep - step;
+    matrix_fill_column(&matrix, pixels, column, red);
+
+    return true;
 }
 
-void fireplace_identify_task(void *_args) {
-    bool old_on = fireplace_on;
-    fireplace_on = false;
-    vTaskDelay(2*FPS_DELAY);
+static const animation_program_t fireplace_program = {
+    .render = fireplace_render,
+    .frame_ms = 1000 / FPS,
+};
 
-    ws2812_pixel_t black = { .color=0x000000 };
-    ws2812_pixel_t red = { .color=0x990000 };
+// frame_ms comes from the recording
+static animation_program_t fireplace_playback_program = {
+    .render = fireplace_playback_render,
+};
 
-    memset(pixels, 0, sizeof(pixels));
-    ws2812_i2s_update(pixels, PIXEL_RGB);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
+static const animation_program_t fireplace_identify_program = {
+    .render = fireplace_identify_render,
+    .frame_ms = 100,
+};
 
-    for (int x = 0; x < 2; x++) {
-        for (int i = 0; i < WIDTH; i++) {
-            _fill_column(i, red);
-            ws2812_i2s_update(pixels, PIXEL_RGB);
+// Renders frames of the live and the recorded fire into the frame
+// buffer before it is set up
+static void fireplace_bench() {
+    uint32_t start = sdk_system_get_time();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        fireplace_render(frame_pixels, i, NULL);
+    }
+    uint32_t live = sdk_system_get_time() - start;
 
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            _fill_column(i, black);
-        }
+    start = sdk_system_get_time();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        fireplace_playback_render(frame_pixels, i, NULL);
+    }
+    uint32_t playback = sdk_system_get_time() - start;
 
-        for (int i = WIDTH-2; i > 0; i--) {
-            _fill_column(i, red);
-            ws2812_i2s_update(pixels, PIXEL_RGB);
+    printf("Fireplace frame: %u us live, %u us recorded (decoding %u us, max %u us)\n",
+           live / BENCH_FRAMES, playback / BENCH_FRAMES,
+           fire_recording.total_us / fire_recording.decoded, fire_recording.max_us);
+}
 
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            _fill_column(i, black);
+void fireplace_init() {
+    // columns going up and down in turn, see the layout above
+    matrix_config_t matrix_config = {
+        .width = WIDTH,
+        .height = HEIGHT,
+        .layout = MATRIX_COLUMN_MAJOR | MATRIX_SERPENTINE,
+    };
+    matrix_init(&matrix, &matrix_config, matrix_map);
+
+    const animation_program_t *program = &fireplace_program;
+    if (FIREPLACE_PLAYBACK) {
+        if (!flash_anim_open(&fire_recording, NUM_LEDS)) {
+            fireplace_bench();
+            fireplace_playback_program.frame_ms = fire_recording.header.frame_ms;
+            program = &fireplace_playback_program;
+        } else {
+            printf("No fire recorded in flash, rendering it live\n");
         }
     }
 
-    ws2812_i2s_update(pixels, PIXEL_RGB);
-
-    if (old_on)
-        fireplace_start();
+    frame_buffer_init(&frames, NUM_LEDS, PIXEL_RGB, frame_pixels);
+    power_limit_init(&power_limit, POWER_BUDGET_MA);
+    frame_buffer_set_limit(&frames, &power_limit);
+    animation_init(&fireplace, &frames, program, "Fireplace", 2);
+}
 
-    vTaskDelete(NULL);
+void fireplace_start() {
+    fireplace_on = true;
+    animation_start(&fireplace);
 }
 
 void fireplace_identify(homekit_value_t _value) {
     printf("Fireplace identify\n");
-    xTaskCreate(fireplace_identify_task, "Fireplace identify", 256, NULL, 2, NULL);
+    if (!fireplace_ready)
+        return;
+
+    animation_preempt(&fireplace, &fireplace_identify_program);
+}
+
+homekit_value_t fireplace_current_get() {
+    return HOMEKIT_UINT32(power_limit.current_ma);
 }
 
 homekit_value_t fireplace_on_get() {
@@ -249,10 +250,15 @@ void fireplace_on_set(homekit_value_t value) {
         return;
     }
 
-    if (value.bool_value && !fireplace_on) {
-        fireplace_start();
-    }
     fireplace_on = value.bool_value;
+    if (!fireplace_ready)
+        return;
+
+    if (fireplace_on) {
+        animation_start(&fireplace);
+    } else {
+        animation_stop(&fireplace);
+    }
 }
 
 
@@ -265,6 +271,7 @@ homekit_accessory_t *accessories[] = {
             HOMEKIT_CHARACTERISTIC(MODEL, "LEDFireplace"),
             HOMEKIT_CHARACTERISTIC(FIRMWARE_REVISION, "0.1"),
             HOMEKIT_CHARACTERISTIC(IDENTIFY, fireplace_identify),
+            HOMEKIT_CHARACTERISTIC(CUSTOM_TELEMETRY),
             NULL
         }),
         HOMEKIT_SERVICE(LIGHTBULB, .primary=true, .characteristics=(homekit_characteristic_t*[]){
@@ -275,6 +282,7 @@ homekit_accessory_t *accessories[] = {
                 .setter=fireplace_on_set
             ),
             &brightness,
+            HOMEKIT_CHARACTERISTIC(CUSTOM_POWER_CURRENT, .getter=fireplace_current_get),
             NULL
         }),
         NULL
@@ -288,11 +296,25 @@ homekit_server_config_t config = {
     .password = "111-11-111"
 };
 
+static void fireplace_setup() {
+    fireplace_init();
+    fireplace_ready = true;
+    fireplace_start();
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
+    boot_profile_init();
 
+    telemetry_init();
     wifi_init();
-    fireplace_init();
-    fireplace_start();
+    boot_profile_mark("wifi init");
+
+    // LED strip is set up while WiFi associates
+    // fireplace_bench() prints from it
+    boot_profile_async("fireplace", fireplace_setup, 1024);
+
     homekit_server_init(&config);
+    boot_profile_mark("homekit");
+    boot_profile_watch_wifi();
 }
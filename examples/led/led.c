@@ -8,22 +8,25 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <static_alloc/static_alloc.h>
+#include <wifi_fast/wifi_fast.h>
+#include <char_cache/char_cache.h>
 #include "wifi.h"
 
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 const int led_gpio = 2;
-bool led_on = false;
+
+void led_commit(char_cache_t *cache);
+
+char_cache_t led_cache = CHAR_CACHE_(led_commit);
+
+homekit_characteristic_t led_on = HOMEKIT_CHARACTERISTIC_(
+    ON, false, .callback=CHAR_CACHE_CALLBACK(led_cache)
+);
 
 void led_write(bool on) {
     gpio_write(led_gpio, on ? 0 : 1);
@@ -31,43 +34,40 @@ void led_write(bool on) {
 
 void led_init() {
     gpio_enable(led_gpio, GPIO_OUTPUT);
-    led_write(led_on);
+    led_write(led_on.value.bool_value);
 }
 
+STATIC_TASK(led_identify, 128);
+TaskHandle_t led_identify_task_handle = NULL;
+
 void led_identify_task(void *_args) {
-    for (int i=0; i<3; i++) {
-        for (int j=0; j<2; j++) {
-            led_write(true);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            led_write(false);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (int i=0; i<3; i++) {
+            for (int j=0; j<2; j++) {
+                led_write(true);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+                led_write(false);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+            }
+
+            vTaskDelay(250 / portTICK_PERIOD_MS);
         }
 
-        vTaskDelay(250 / portTICK_PERIOD_MS);
+        led_write(led_on.value.bool_value);
     }
-
-    led_write(led_on);
-
-    vTaskDelete(NULL);
 }
 
 void led_identify(homekit_value_t _value) {
     printf("LED identify\n");
-    xTaskCreate(led_identify_task, "LED identify", 128, NULL, 2, NULL);
-}
-
-homekit_value_t led_on_get() {
-    return HOMEKIT_BOOL(led_on);
+    xTaskNotifyGive(led_identify_task_handle);
 }
 
-void led_on_set(homekit_value_t value) {
-    if (value.format != homekit_format_bool) {
-        printf("Invalid value format: %d\n", value.format);
-        return;
-    }
-
-    led_on = value.bool_value;
-    led_write(led_on);
+// Runs in the commit task, so the cache stats time a write of the
+// switch up to the GPIO edge
+void led_commit(char_cache_t *cache) {
+    led_write(led_on.value.bool_value);
 }
 
 
@@ -84,11 +84,7 @@ homekit_accessory_t *accessories[] = {
         }),
         HOMEKIT_SERVICE(LIGHTBULB, .primary=true, .characteristics=(homekit_characteristic_t*[]){
             HOMEKIT_CHARACTERISTIC(NAME, "Sample LED"),
-            HOMEKIT_CHARACTERISTIC(
-                ON, false,
-                .getter=led_on_get,
-                .setter=led_on_set
-            ),
+            &led_on,
             NULL
         }),
         NULL
@@ -103,8 +99,10 @@ homekit_server_config_t config = {
 
 void user_init(void) {
     uart_set_baud(0, 115200);
+    led_identify_task_handle = STATIC_TASK_CREATE(led_identify, led_identify_task, "LED identify", NULL, 2);
 
     wifi_init();
     led_init();
+    char_cache_init();
     homekit_server_init(&config);
 }
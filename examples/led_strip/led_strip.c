@@ -5,8 +5,9 @@
 *    1) the ws2812_i2s library uses hardware I2S so output pin is GPIO3 and cannot be changed.
 *    2) on some ESP8266 such as the Wemos D1 mini, GPIO3 is the same pin used for serial comms.
 * 
-* Debugging printf statements are disabled below because of note (2) - you can uncomment
-* them if your hardware supports serial comms that do not conflict with I2S on GPIO3.
+* Because of note (2) debug messages go to the deferred logger, which keeps them in RAM
+* (see logger_read()) - pass LOGGER_SINK_UART1 to logger_init() to print them on GPIO2
+* if your board does not use it for the onboard LED.
 *
 * Contributed March 2018 by https://github.com/Dave1001
 */
@@ -18,10 +19,14 @@
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
-#include <math.h>
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <static_alloc/static_alloc.h>
+#include <wifi_fast/wifi_fast.h>
+#include <char_cache/char_cache.h>
+#include <logger/logger.h>
+#include <fixmath/fixmath.h>
 #include "wifi.h"
 #include "ws2812_i2s/ws2812_i2s.h"
 
@@ -31,41 +36,60 @@
 #define LED_RGB_SCALE 255       // this is the scaling factor used for color conversion
 
 // Global variables
-float led_hue = 0;              // hue is scaled 0 to 360
-float led_saturation = 59;      // saturation is scaled 0 to 100
-float led_brightness = 100;     // brightness is scaled 0 to 100
-bool led_on = false;            // on is boolean on or off
 ws2812_pixel_t pixels[LED_COUNT];
 
+void led_commit(char_cache_t *cache);
+
+// Values written by controllers are applied to the strip together
+char_cache_t led_cache = CHAR_CACHE_(led_commit);
+
+homekit_characteristic_t led_on = HOMEKIT_CHARACTERISTIC_(
+    ON, false, .callback=CHAR_CACHE_CALLBACK(led_cache)
+);
+// brightness is scaled 0 to 100
+homekit_characteristic_t led_brightness = HOMEKIT_CHARACTERISTIC_(
+    BRIGHTNESS, 100, .callback=CHAR_CACHE_CALLBACK(led_cache)
+);
+// hue is scaled 0 to 360
+homekit_characteristic_t led_hue = HOMEKIT_CHARACTERISTIC_(
+    HUE, 0, .callback=CHAR_CACHE_CALLBACK(led_cache)
+);
+// saturation is scaled 0 to 100
+homekit_characteristic_t led_saturation = HOMEKIT_CHARACTERISTIC_(
+    SATURATION, 59, .callback=CHAR_CACHE_CALLBACK(led_cache)
+);
+
 //http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
-static void hsi2rgb(float h, float s, float i, ws2812_pixel_t* rgb) {
+static void hsi2rgb(q16_t h, q16_t s, q16_t i, ws2812_pixel_t* rgb) {
     int r, g, b;
+    q16_t ratio;
+
+    h = q16_mod(h, Q16(360));           // cycle h around to 0-360 degrees
+    s = q16_clamp(s / 100, 0, Q16_ONE); // from percentage to ratio, clamped to [0,1]
+    i = q16_clamp(i / 100, 0, Q16_ONE); // from percentage to ratio, clamped to [0,1]
+    i = q16_mul(i, q16_sqrt(i));        // shape intensity to have finer granularity near 0
 
-    while (h < 0) { h += 360.0F; };     // cycle h around to 0-360 degrees
-    while (h >= 360) { h -= 360.0F; };
-    h = 3.14159F*h / 180.0F;            // convert to radians.
-    s /= 100.0F;                        // from percentage to ratio
-    i /= 100.0F;                        // from percentage to ratio
-    s = s > 0 ? (s < 1 ? s : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i > 0 ? (i < 1 ? i : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i * sqrt(i);                    // shape intensity to have finer granularity near 0
-
-    if (h < 2.09439) {
-        r = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        g = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        b = LED_RGB_SCALE * i / 3 * (1 - s);
+    q16_t base = i * LED_RGB_SCALE / 3;
+
+    if (h < Q16(120)) {
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60) - h));
+        r = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, ratio)));
+        g = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, Q16_ONE - ratio)));
+        b = q16_round(q16_mul(base, Q16_ONE - s));
     }
-    else if (h < 4.188787) {
-        h = h - 2.09439;
-        g = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        b = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        r = LED_RGB_SCALE * i / 3 * (1 - s);
+    else if (h < Q16(240)) {
+        h = h - Q16(120);
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60) - h));
+        g = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, ratio)));
+        b = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, Q16_ONE - ratio)));
+        r = q16_round(q16_mul(base, Q16_ONE - s));
     }
     else {
-        h = h - 4.188787;
-        b = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        r = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        g = LED_RGB_SCALE * i / 3 * (1 - s);
+        h = h - Q16(240);
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60) - h));
+        b = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, ratio)));
+        r = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, Q16_ONE - ratio)));
+        g = q16_round(q16_mul(base, Q16_ONE - s));
     }
 
     rgb->red = (uint8_t) r;
@@ -86,17 +110,19 @@ void led_string_fill(ws2812_pixel_t rgb) {
 void led_string_set(void) {
     ws2812_pixel_t rgb = { { 0, 0, 0, 0 } };
 
-    if (led_on) {
+    if (led_on.value.bool_value) {
         // convert HSI to RGBW
-        hsi2rgb(led_hue, led_saturation, led_brightness, &rgb);
-        //printf("h=%d,s=%d,b=%d => ", (int)led_hue, (int)led_saturation, (int)led_brightness);
-        //printf("r=%d,g=%d,b=%d,w=%d\n", rgbw.red, rgbw.green, rgbw.blue, rgbw.white);
+        hsi2rgb(q16_from_float(led_hue.value.float_value),
+                q16_from_float(led_saturation.value.float_value),
+                q16_from_int(led_brightness.value.int_value), &rgb);
+        LOG_DEBUG("h=%d,s=%d,b=%d", (int32_t)led_hue.value.float_value, (int32_t)led_saturation.value.float_value, led_brightness.value.int_value);
+        LOG_DEBUG("r=%d,g=%d,b=%d", rgb.red, rgb.green, rgb.blue);
 
         // set the inbuilt led
         gpio_write(LED_INBUILT_GPIO, LED_ON);
     }
     else {
-        // printf("off\n");
+        LOG_DEBUG("off");
         gpio_write(LED_INBUILT_GPIO, 1 - LED_ON);
     }
 
@@ -105,14 +131,7 @@ void led_string_set(void) {
 }
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 void led_init() {
@@ -126,80 +145,38 @@ void led_init() {
     led_string_set();
 }
 
+STATIC_TASK(led_identify, 128);
+TaskHandle_t led_identify_task_handle = NULL;
+
 void led_identify_task(void *_args) {
-    const ws2812_pixel_t COLOR_PINK = { { 255, 0, 127, 0 } };
-    const ws2812_pixel_t COLOR_BLACK = { { 0, 0, 0, 0 } };
-
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
-            gpio_write(LED_INBUILT_GPIO, LED_ON);
-            led_string_fill(COLOR_PINK);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            gpio_write(LED_INBUILT_GPIO, 1 - LED_ON);
-            led_string_fill(COLOR_BLACK);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        const ws2812_pixel_t COLOR_PINK = { { 255, 0, 127, 0 } };
+        const ws2812_pixel_t COLOR_BLACK = { { 0, 0, 0, 0 } };
+
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                gpio_write(LED_INBUILT_GPIO, LED_ON);
+                led_string_fill(COLOR_PINK);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+                gpio_write(LED_INBUILT_GPIO, 1 - LED_ON);
+                led_string_fill(COLOR_BLACK);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+            }
+            vTaskDelay(250 / portTICK_PERIOD_MS);
         }
-        vTaskDelay(250 / portTICK_PERIOD_MS);
-    }
-
-    led_string_set();
-    vTaskDelete(NULL);
-}
-
-void led_identify(homekit_value_t _value) {
-    // printf("LED identify\n");
-    xTaskCreate(led_identify_task, "LED identify", 128, NULL, 2, NULL);
-}
-
-homekit_value_t led_on_get() {
-    return HOMEKIT_BOOL(led_on);
-}
-
-void led_on_set(homekit_value_t value) {
-    if (value.format != homekit_format_bool) {
-        // printf("Invalid on-value format: %d\n", value.format);
-        return;
-    }
-
-    led_on = value.bool_value;
-    led_string_set();
-}
-
-homekit_value_t led_brightness_get() {
-    return HOMEKIT_INT(led_brightness);
-}
-void led_brightness_set(homekit_value_t value) {
-    if (value.format != homekit_format_int) {
-        // printf("Invalid brightness-value format: %d\n", value.format);
-        return;
-    }
-    led_brightness = value.int_value;
-    led_string_set();
-}
-
-homekit_value_t led_hue_get() {
-    return HOMEKIT_FLOAT(led_hue);
-}
 
-void led_hue_set(homekit_value_t value) {
-    if (value.format != homekit_format_float) {
-        // printf("Invalid hue-value format: %d\n", value.format);
-        return;
+        led_string_set();
     }
-    led_hue = value.float_value;
-    led_string_set();
 }
 
-homekit_value_t led_saturation_get() {
-    return HOMEKIT_FLOAT(led_saturation);
+void led_identify(homekit_value_t _value) {
+    LOG_INFO("LED identify");
+    xTaskNotifyGive(led_identify_task_handle);
 }
 
-void led_saturation_set(homekit_value_t value) {
-    if (value.format != homekit_format_float) {
-        // printf("Invalid sat-value format: %d\n", value.format);
-        return;
-    }
-    led_saturation = value.float_value;
+void led_commit(char_cache_t *cache) {
     led_string_set();
 }
 
@@ -218,26 +195,10 @@ homekit_accessory_t *accessories[] = {
         }),
         HOMEKIT_SERVICE(LIGHTBULB, .primary = true, .characteristics = (homekit_characteristic_t*[]) {
             HOMEKIT_CHARACTERISTIC(NAME, "Sample LED Strip"),
-            HOMEKIT_CHARACTERISTIC(
-                ON, true,
-                .getter = led_on_get,
-                .setter = led_on_set
-            ),
-            HOMEKIT_CHARACTERISTIC(
-                BRIGHTNESS, 100,
-                .getter = led_brightness_get,
-                .setter = led_brightness_set
-            ),
-            HOMEKIT_CHARACTERISTIC(
-                HUE, 0,
-                .getter = led_hue_get,
-                .setter = led_hue_set
-            ),
-            HOMEKIT_CHARACTERISTIC(
-                SATURATION, 0,
-                .getter = led_saturation_get,
-                .setter = led_saturation_set
-            ),
+            &led_on,
+            &led_brightness,
+            &led_hue,
+            &led_saturation,
             NULL
         }),
         NULL
@@ -252,6 +213,10 @@ homekit_server_config_t config = {
 
 void user_init(void) {
     // uart_set_baud(0, 115200);
+    logger_init(LOGGER_SINK_NONE);
+    // prints only in builds with FIXMATH_BENCH=1
+    fixmath_bench();
+    led_identify_task_handle = STATIC_TASK_CREATE(led_identify, led_identify_task, "LED identify", NULL, 2);
 
     // This example shows how to use same firmware for multiple similar accessories
     // without name conflicts. It uses the last 3 bytes of accessory's MAC address as
@@ -265,5 +230,6 @@ void user_init(void) {
 
     wifi_init();
     led_init();
+    char_cache_init();
     homekit_server_init(&config);
 }
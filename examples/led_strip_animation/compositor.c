@@ -0,0 +1,37 @@
+#include "compositor.h"
+
+
+static uint8_t blend_channel(uint8_t dst, uint8_t src, const layer_t *layer) {
+    // brightness is 0..255, turn it into 8.8 scale so 255 stays 255
+    src = ((uint16_t)src * (layer->brightness + 1)) >> 8;
+
+    uint16_t blended;
+    switch (layer->blend) {
+        case BLEND_ADD:
+            blended = dst + src;
+            if (blended > 255)
+                blended = 255;
+            break;
+        case BLEND_MULTIPLY:
+            blended = ((uint16_t)dst * (src + 1)) >> 8;
+            break;
+        case BLEND_MAX:
+            blended = (dst > src) ? dst : src;
+            break;
+        case BLEND_OVER:
+        default:
+            blended = src;
+            break;
+    }
+
+    if (layer->alpha >= ALPHA_OPAQUE)
+        return blended;
+
+    return dst + ((((int32_t)blended - dst) * layer->alpha) >> 8);
+}
+
+void compositor_blend(ws2812_pixel_t *pixel, ws2812_pixel_t color, const layer_t *layer) {
+    pixel->red = blend_channel(pixel->red, color.red, layer);
+    pixel->green = blend_channel(pixel->green, color.green, layer);
+    pixel->blue = blend_channel(pixel->blue, color.blue, layer);
+}
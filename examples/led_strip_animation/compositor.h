@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ws2812_i2s/ws2812_i2s.h>
+
+/*
+ * Every segment is composed of ordered layers. Layers are drawn
+ * directly into the frame buffer one after another, each one blended
+ * over what is already there, so no intermediate buffers are needed.
+ */
+
+typedef enum {
+    LAYER_BASE = 0,     // solid color
+    LAYER_EFFECT,       // segment's effect
+    LAYER_OVERLAY,      // solid color on top of everything, e.g. identify flash
+    LAYER_COUNT
+} layer_id_t;
+
+typedef enum {
+    BLEND_OVER = 0,     // replace
+    BLEND_ADD,          // saturating add
+    BLEND_MULTIPLY,
+    BLEND_MAX,          // lighten
+} blend_mode_t;
+
+// Alpha is 8.8 fixed point
+#define ALPHA_OPAQUE 0x100
+
+typedef struct {
+    bool enabled;
+    uint8_t blend;          // see blend_mode_t
+    uint16_t alpha;         // 0 (transparent) to ALPHA_OPAQUE
+    uint8_t brightness;     // 0 to 255, applied to layer's colors before blending
+} layer_t;
+
+/**
+    Blends a color into the pixel according to the layer's blend mode and alpha.
+*/
+void compositor_blend(ws2812_pixel_t *pixel, ws2812_pixel_t color, const layer_t *layer);
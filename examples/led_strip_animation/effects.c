@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <string.h>
+#include <esp8266.h>
+#include <espressif/esp_system.h>
+#include <palette/palette.h>
+
+#include "effects.h"
+
+// Step delay of effects at the slowest and the fastest speed, in milliseconds
+#define FX_DELAY_MAX 1000
+#define FX_DELAY_MIN 10
+
+// Weight of the newest sample in the moving average, as 1/2^n
+#define FX_STATS_SHIFT 3
+
+#define BLACK ((ws2812_pixel_t) { .color=0x000000 })
+
+
+static uint8_t scale(uint8_t x, uint8_t s) {
+    return (((uint16_t)x) * (s + 1)) >> 8;
+}
+
+static ws2812_pixel_t color_scale(ws2812_pixel_t color, uint8_t s) {
+    return (ws2812_pixel_t) {
+        .red = scale(color.red, s),
+        .green = scale(color.green, s),
+        .blue = scale(color.blue, s),
+    };
+}
+
+static uint8_t triangle(uint8_t x) {
+    return (x < 128) ? x * 2 : (255 - x) * 2;
+}
+
+static uint16_t fx_delay(led_segment_t *segment) {
+    return FX_DELAY_MAX - (uint32_t)(FX_DELAY_MAX - FX_DELAY_MIN) * segment->speed / 255;
+}
+
+
+static uint16_t fx_static(led_segment_t *segment) {
+    segment_fill(segment, segment->color);
+    return FX_DELAY_MAX;
+}
+
+static uint16_t fx_blink(led_segment_t *segment) {
+    segment_fill(segment, (segment->step & 1) ? BLACK : segment->color);
+    return fx_delay(segment);
+}
+
+static uint16_t fx_breath(led_segment_t *segment) {
+    uint8_t level = triangle(segment->step);
+    segment_fill(segment, color_scale(segment->color, level < 16 ? 16 : level));
+    return fx_delay(segment) / 16 + 1;
+}
+
+static uint16_t fx_color_wipe(led_segment_t *segment) {
+    uint32_t n = segment->step % (segment->count * 2);
+    for (int i = 0; i < segment->count; i++) {
+        bool lit = (n < segment->count) ? (i <= n) : (i > n - segment->count);
+        segment_set_pixel(segment, i, lit ? segment->color : BLACK);
+    }
+    return fx_delay(segment) / 4 + 1;
+}
+
+static uint16_t fx_scan(led_segment_t *segment) {
+    uint32_t n = segment->step % (segment->count * 2 - 1);
+    if (n >= segment->count)
+        n = segment->count * 2 - n - 2;
+
+    for (int i = 0; i < segment->count; i++) {
+        segment_set_pixel(segment, i, (i == n) ? segment->color : BLACK);
+    }
+    return fx_delay(segment) / 4 + 1;
+}
+
+static uint16_t fx_theater_chase(led_segment_t *segment) {
+    uint8_t offset = segment->step % 3;
+    for (int i = 0; i < segment->count; i++) {
+        segment_set_pixel(segment, i, (i % 3 == offset) ? segment->color : BLACK);
+    }
+    return fx_delay(segment);
+}
+
+static uint16_t fx_running_lights(led_segment_t *segment) {
+    for (int i = 0; i < segment->count; i++) {
+        uint8_t level = triangle(i * 256 * 2 / segment->count + segment->step * 4);
+        segment_set_pixel(segment, i, color_scale(segment->color, level));
+    }
+    return fx_delay(segment) / 8 + 1;
+}
+
+// state holds current level of every LED, one more is lit every step
+// until all go dark again once every count steps
+static void fx_twinkle_update(led_segment_t *segment) {
+    uint8_t *levels = segment->state;
+    if (segment->step % segment->count == 0)
+        memset(levels, 0, segment->count);
+
+    levels[hwrand() % segment->count] = 255;
+}
+
+// state holds current level of every LED
+static void fx_fire_flicker_update(led_segment_t *segment) {
+    uint8_t *levels = segment->state;
+    for (int i = 0; i < segment->count; i++) {
+        levels[i] = 255 - hwrand() % 96;
+    }
+}
+
+// draws levels kept in the state
+static void draw_levels(led_segment_t *segment) {
+    uint8_t *levels = segment->state;
+    for (int i = 0; i < segment->count; i++) {
+        segment_set_pixel(segment, i, color_scale(segment->color, levels[i]));
+    }
+}
+
+static uint16_t fx_twinkle(led_segment_t *segment) {
+    draw_levels(segment);
+    return fx_delay(segment);
+}
+
+static uint16_t fx_fire_flicker(led_segment_t *segment) {
+    draw_levels(segment);
+    return fx_delay(segment) / 8 + 1;
+}
+
+static uint16_t fx_rainbow(led_segment_t *segment) {
+    segment_fill(segment, palette_color(palette_rainbow(), segment->step));
+    return fx_delay(segment) / 16 + 1;
+}
+
+static uint16_t fx_rainbow_cycle(led_segment_t *segment) {
+    const palette_t *palette = palette_rainbow();
+    for (int i = 0; i < segment->count; i++) {
+        segment_set_pixel(segment, i, palette_color(palette, i * 256 / segment->count + segment->step));
+    }
+    return fx_delay(segment) / 16 + 1;
+}
+
+
+static const fx_effect_t fx_builtin_effects[FX_MODE_BUILTIN_COUNT] = {
+    [FX_MODE_STATIC] = { "static", fx_static, NULL, 0, 150 },
+    [FX_MODE_BLINK] = { "blink", fx_blink, NULL, 0, 150 },
+    [FX_MODE_BREATH] = { "breath", fx_breath, NULL, 0, 250 },
+    [FX_MODE_COLOR_WIPE] = { "color wipe", fx_color_wipe, NULL, 0, 200 },
+    [FX_MODE_SCAN] = { "scan", fx_scan, NULL, 0, 200 },
+    [FX_MODE_THEATER_CHASE] = { "theater chase", fx_theater_chase, NULL, 0, 300 },
+    [FX_MODE_RUNNING_LIGHTS] = { "running lights", fx_running_lights, NULL, 0, 500 },
+    [FX_MODE_TWINKLE] = { "twinkle", fx_twinkle, fx_twinkle_update, 1, 400 },
+    [FX_MODE_FIRE_FLICKER] = { "fire flicker", fx_fire_flicker, fx_fire_flicker_update, 1, 600 },
+    [FX_MODE_RAINBOW] = { "rainbow", fx_rainbow, NULL, 0, 150 },
+    [FX_MODE_RAINBOW_CYCLE] = { "rainbow cycle", fx_rainbow_cycle, NULL, 0, 700 },
+};
+
+static const fx_effect_t *fx_effects[FX_MAX_EFFECTS] = {
+    &fx_builtin_effects[FX_MODE_STATIC],
+    &fx_builtin_effects[FX_MODE_BLINK],
+    &fx_builtin_effects[FX_MODE_BREATH],
+    &fx_builtin_effects[FX_MODE_COLOR_WIPE],
+    &fx_builtin_effects[FX_MODE_SCAN],
+    &fx_builtin_effects[FX_MODE_THEATER_CHASE],
+    &fx_builtin_effects[FX_MODE_RUNNING_LIGHTS],
+    &fx_builtin_effects[FX_MODE_TWINKLE],
+    &fx_builtin_effects[FX_MODE_FIRE_FLICKER],
+    &fx_builtin_effects[FX_MODE_RAINBOW],
+    &fx_builtin_effects[FX_MODE_RAINBOW_CYCLE],
+};
+static uint8_t fx_effect_count = FX_MODE_BUILTIN_COUNT;
+
+static fx_stats_t fx_effect_stats[FX_MAX_EFFECTS];
+
+
+int fx_register(const fx_effect_t *effect) {
+    if (fx_effect_count >= FX_MAX_EFFECTS || effect->state_size > FX_MAX_STATE_SIZE)
+        return -1;
+
+    fx_effects[fx_effect_count] = effect;
+    memset(&fx_effect_stats[fx_effect_count], 0, sizeof(fx_stats_t));
+
+    return fx_effect_count++;
+}
+
+uint8_t fx_count() {
+    return fx_effect_count;
+}
+
+const fx_effect_t *fx_get(uint8_t mode) {
+    return (mode < fx_effect_count) ? fx_effects[mode] : fx_effects[FX_MODE_STATIC];
+}
+
+const fx_stats_t *fx_stats(uint8_t mode) {
+    return (mode < fx_effect_count) ? &fx_effect_stats[mode] : NULL;
+}
+
+static void fx_stats_record(uint8_t mode, uint16_t led_count, uint32_t elapsed) {
+    fx_stats_t *stats = &fx_effect_stats[mode];
+
+    // average is kept per 100 LEDs so that segments of different
+    // length can share it
+    uint32_t normalized = elapsed * 100 / led_count;
+    if (stats->steps == 0) {
+        stats->avg_us = normalized;
+    } else {
+        stats->avg_us += ((int32_t)normalized - (int32_t)stats->avg_us) >> FX_STATS_SHIFT;
+    }
+
+    stats->steps++;
+    stats->total_us += elapsed;
+    if (elapsed > stats->max_us)
+        stats->max_us = elapsed;
+}
+
+uint32_t fx_cost(uint8_t mode, uint16_t led_count) {
+    if (mode >= fx_effect_count)
+        mode = FX_MODE_STATIC;
+
+    const fx_stats_t *stats = &fx_effect_stats[mode];
+    uint32_t cost = stats->steps ? stats->avg_us : fx_effects[mode]->cost;
+
+    return cost * led_count / 100;
+}
+
+uint16_t fx_render(led_segment_t *segment) {
+    if (!segment->count)
+        return FX_DELAY_MAX;
+
+    uint8_t mode = (segment->mode < fx_effect_count) ? segment->mode : FX_MODE_STATIC;
+    const fx_effect_t *effect = fx_effects[mode];
+    if (effect->state_size && !segment->state)
+        effect = fx_effects[mode = FX_MODE_STATIC];
+
+    uint32_t start = sdk_system_get_time();
+    uint16_t delay = effect->render(segment);
+    fx_stats_record(mode, segment->count, sdk_system_get_time() - start);
+
+    return delay;
+}
+
+void fx_advance(led_segment_t *segment, uint32_t now) {
+    const fx_effect_t *effect = fx_get(segment->mode);
+
+    if (!effect->update && segment->step_delay) {
+        segment->step = now / segment->step_delay;
+    } else {
+        segment->step++;
+    }
+
+    if (!segment->count)
+        return;
+
+    if (effect->update && (!effect->state_size || segment->state))
+        effect->update(segment);
+}
+
+void fx_stats_dump() {
+    uint8_t order[FX_MAX_EFFECTS];
+    for (int i = 0; i < fx_effect_count; i++) {
+        order[i] = i;
+    }
+
+    // insertion sort by cost, most expensive first
+    for (int i = 1; i < fx_effect_count; i++) {
+        uint8_t mode = order[i];
+        uint32_t cost = fx_cost(mode, 100);
+        int j = i - 1;
+        while (j >= 0 && fx_cost(order[j], 100) < cost) {
+            order[j+1] = order[j];
+            j--;
+        }
+        order[j+1] = mode;
+    }
+
+    printf("%-16s %10s %10s %8s %8s\n", "effect", "us/100led", "steps", "max us", "total ms");
+    for (int i = 0; i < fx_effect_count; i++) {
+        const fx_stats_t *stats = &fx_effect_stats[order[i]];
+        printf("%-16s %10u %10u %8u %8u%s\n",
+               fx_effects[order[i]]->name, fx_cost(order[i], 100),
+               stats->steps, stats->max_us, stats->total_us / 1000,
+               stats->steps ? "" : " (estimated)");
+    }
+}
+
+uint8_t fx_mode_from_hue(q16_t hue) {
+    hue = q16_clamp(hue, 0, Q16(360));
+
+    uint8_t mode = hue * fx_effect_count / Q16(360);
+    return (mode < fx_effect_count) ? mode : fx_effect_count - 1;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <fixmath/fixmath.h>
+#include "segments.h"
+
+// Maximum number of effects, built-in ones included
+#define FX_MAX_EFFECTS 16
+
+// Most bytes of state per LED an effect may need
+#define FX_MAX_STATE_SIZE 1
+
+typedef enum {
+    FX_MODE_STATIC = 0,
+    FX_MODE_BLINK,
+    FX_MODE_BREATH,
+    FX_MODE_COLOR_WIPE,
+    FX_MODE_SCAN,
+    FX_MODE_THEATER_CHASE,
+    FX_MODE_RUNNING_LIGHTS,
+    FX_MODE_TWINKLE,
+    FX_MODE_FIRE_FLICKER,
+    FX_MODE_RAINBOW,
+    FX_MODE_RAINBOW_CYCLE,
+    FX_MODE_BUILTIN_COUNT
+} fx_mode_t;
+
+/**
+    Draws current step of an effect into the segment. Effect is drawn
+    whenever the segment is composed, so the function must only depend
+    on segment->step and segment->state.
+
+    @return Delay in milliseconds until the next step.
+*/
+typedef uint16_t (*fx_render_fn)(led_segment_t *segment);
+
+/**
+    Advances effect's state to segment->step.
+*/
+typedef void (*fx_update_fn)(led_segment_t *segment);
+
+typedef struct {
+    const char *name;
+    fx_render_fn render;
+    fx_update_fn update;        // optional
+
+    // Bytes of state the effect needs per LED of the segment, up to
+    // FX_MAX_STATE_SIZE, available to it as segment->state
+    uint16_t state_size;
+
+    // Estimated cost of one step in microseconds per 100 LEDs.
+    // Used until the profiler has measured the real one.
+    uint16_t cost;
+} fx_effect_t;
+
+typedef struct {
+    uint32_t steps;             // number of rendered steps
+    uint32_t total_us;          // total time spent rendering
+    uint32_t avg_us;            // moving average of one step on 100 LEDs
+    uint32_t max_us;            // slowest step
+} fx_stats_t;
+
+/**
+    Adds an effect to the registry.
+
+    @param effect Effect description, must stay valid while the effect is registered.
+    @return Mode number of the registered effect or a negative integer if registry is full.
+*/
+int fx_register(const fx_effect_t *effect);
+
+/**
+    Returns number of registered effects.
+*/
+uint8_t fx_count();
+
+const fx_effect_t *fx_get(uint8_t mode);
+
+/**
+    Moves the segment's effect to its next step. Effects without state
+    go to the step the clock is at instead, so the same effect at the
+    same speed shows the same step on every device sharing the clock.
+*/
+void fx_advance(led_segment_t *segment, uint32_t now);
+
+/**
+    Draws current step of the segment's effect into the frame buffer
+    and records how long it took.
+
+    @return Delay in milliseconds until the next step should be rendered.
+*/
+uint16_t fx_render(led_segment_t *segment);
+
+/**
+    Returns the expected time in microseconds to render one step of the
+    given effect on a segment of the given length.
+*/
+uint32_t fx_cost(uint8_t mode, uint16_t led_count);
+
+const fx_stats_t *fx_stats(uint8_t mode);
+
+/**
+    Prints all effects ranked by their measured cost.
+*/
+void fx_stats_dump();
+
+/**
+    Maps HomeKit hue angle (0 to 360) to an effect, so that the whole
+    hue circle covers all registered effects.
+*/
+uint8_t fx_mode_from_hue(q16_t hue);
@@ -1,13 +1,21 @@
 /*
-* This is an example of an rgb ws2812_i2s led strip animation using a WS2812FX library fork for freertos
+* This is an example of an rgb ws2812_i2s led strip animation split into
+* segments, each one running its own effect
 *
 * NOTE:
 *    1) the ws2812_i2s library uses hardware I2S so output pin is GPIO3 and cannot be changed.
 *    2) on some ESP8266 such as the Wemos D1 mini, GPIO3 is the same pin used for serial comms (RX pin).
 *    3) you can still print stuff to serial but transmiting data to wemos will interfere on the leds output
 * 
-* Debugging printf statements are disabled below because of note (2) - you can uncomment
-* them if your hardware supports serial comms that do not conflict with I2S on GPIO3.
+* Because of note (2) debug messages go to the deferred logger, which keeps them in RAM
+* (see logger_read()) - pass LOGGER_SINK_UART1 to logger_init() to print them on GPIO2
+* if your board does not use it for the onboard LED.
+*
+* A show controller can also stream pixels to the strip over DDP or E1.31, effects
+* stop while it streams (see components/pixel_stream, stream_send.py sends test patterns).
+*
+* Effects run on a clock shared by all devices on the network (see components/sync_clock),
+* so strips running the same effect at the same speed stay in step.
 *
 * Contributed April 2018 by https://github.com/PCSaito
 */
@@ -19,59 +27,87 @@
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
-#include <math.h>
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <static_alloc/static_alloc.h>
+#include <wifi_fast/wifi_fast.h>
+#include <trace/trace.h>
+#include <logger/logger.h>
+#include <fixmath/fixmath.h>
+#include <pixel_stream/pixel_stream.h>
+#include <sync_clock/sync_clock.h>
 #include "wifi.h"
 
-#include "WS2812FX/WS2812FX.h"
+#include "segments.h"
+#include "effects.h"
 
 #define LED_RGB_SCALE 255       // this is the scaling factor used for color conversion
 #define LED_COUNT 50            // this is the number of WS2812B leds on the strip
 #define LED_INBUILT_GPIO 2      // this is the onboard LED used to show on/off only
 
+// Initial state of every segment, as reported to HomeKit
+#define SEGMENT_ON true
+#define SEGMENT_BRIGHTNESS 33   // brightness is scaled 0 to 100
+#define SEGMENT_HUE 0           // hue is scaled 0 to 360
+#define SEGMENT_SATURATION 100  // saturation is scaled 0 to 100
+#define SEGMENT_FX_ON true
+#define SEGMENT_FX_SPEED 50     // speed is scaled 0 to 100, 50 being the slowest
+#define SEGMENT_FX_HUE 64       // effect is selected by hue, see fx_mode_from_hue()
+#define SEGMENT_FX_ALPHA 100    // opacity of the effect over segment's color, scaled 0 to 100
+
 // Global variables
-float led_hue = 0;              // hue is scaled 0 to 360
-float led_saturation = 100;      // saturation is scaled 0 to 100
-float led_brightness = 33;     // brightness is scaled 0 to 100
-bool led_on = false;            // on is boolean on or off
 bool led_on_value = (bool)0;                // this is the value to write to GPIO for led on (0 = GPIO low)
 
-float fx_hue = 64;              // hue is scaled 0 to 360
-float fx_saturation = 50;      // saturation is scaled 0 to 100
-float fx_brightness = 50;     // brightness is scaled 0 to 100
-bool fx_on = true;
+// The strip is split into segments, each one is exposed as
+// a separate light bulb with its own effect light bulb
+led_segment_t segments[] = {
+    { .start = 0, .count = 25 },
+    { .start = 25, .count = 25 },
+};
+#define SEGMENT_COUNT (sizeof(segments) / sizeof(*segments))
+
+// HomeKit values that are not kept in the segment itself
+typedef struct {
+    q16_t hue;
+    q16_t saturation;
+    bool fx_on;
+    uint8_t fx_mode;
+} segment_state_t;
+
+segment_state_t segment_states[SEGMENT_COUNT];
 
 //http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
-static void hsi2rgb(float h, float s, float i, ws2812_pixel_t* rgb) {
+static void hsi2rgb(q16_t h, q16_t s, q16_t i, ws2812_pixel_t* rgb) {
     int r, g, b;
+    q16_t ratio;
+
+    h = q16_mod(h, Q16(360));           // cycle h around to 0-360 degrees
+    s = q16_clamp(s / 100, 0, Q16_ONE); // from percentage to ratio, clamped to [0,1]
+    i = q16_clamp(i / 100, 0, Q16_ONE); // from percentage to ratio, clamped to [0,1]
+    i = q16_mul(i, q16_sqrt(i));        // shape intensity to have finer granularity near 0
+
+    q16_t base = i * LED_RGB_SCALE / 3;
 
-    while (h < 0) { h += 360.0F; };     // cycle h around to 0-360 degrees
-    while (h >= 360) { h -= 360.0F; };
-    h = 3.14159F*h / 180.0F;            // convert to radians.
-    s /= 100.0F;                        // from percentage to ratio
-    i /= 100.0F;                        // from percentage to ratio
-    s = s > 0 ? (s < 1 ? s : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i > 0 ? (i < 1 ? i : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i * sqrt(i);                    // shape intensity to have finer granularity near 0
-
-    if (h < 2.09439) {
-        r = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        g = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        b = LED_RGB_SCALE * i / 3 * (1 - s);
+    if (h < Q16(120)) {
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60) - h));
+        r = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, ratio)));
+        g = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, Q16_ONE - ratio)));
+        b = q16_round(q16_mul(base, Q16_ONE - s));
     }
-    else if (h < 4.188787) {
-        h = h - 2.09439;
-        g = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        b = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        r = LED_RGB_SCALE * i / 3 * (1 - s);
+    else if (h < Q16(240)) {
+        h = h - Q16(120);
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60) - h));
+        g = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, ratio)));
+        b = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, Q16_ONE - ratio)));
+        r = q16_round(q16_mul(base, Q16_ONE - s));
     }
     else {
-        h = h - 4.188787;
-        b = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        r = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        g = LED_RGB_SCALE * i / 3 * (1 - s);
+        h = h - Q16(240);
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60) - h));
+        b = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, ratio)));
+        r = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, Q16_ONE - ratio)));
+        g = q16_round(q16_mul(base, Q16_ONE - s));
     }
 
     rgb->red = (uint8_t) r;
@@ -81,177 +117,260 @@ static void hsi2rgb(float h, float s, float i, ws2812_pixel_t* rgb) {
 }
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 
+static void segments_overlay(bool on) {
+    for (int i = 0; i < SEGMENT_COUNT; i++) {
+        segments[i].layers[LAYER_OVERLAY].enabled = on;
+        segment_redraw(&segments[i]);
+    }
+}
+
+STATIC_TASK(led_identify, 128);
+TaskHandle_t led_identify_task_handle = NULL;
+
 void led_identify_task(void *_args) {
-    // initialise the onboard led as a secondary indicator (handy for testing)
-    gpio_enable(LED_INBUILT_GPIO, GPIO_OUTPUT);
-    
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
-            gpio_write(LED_INBUILT_GPIO, (int)led_on_value);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            gpio_write(LED_INBUILT_GPIO, 1 - (int)led_on_value);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // initialise the onboard led as a secondary indicator (handy for testing)
+        gpio_enable(LED_INBUILT_GPIO, GPIO_OUTPUT);
+
+        // flash the strip with the overlay layer, effects keep running below it
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                gpio_write(LED_INBUILT_GPIO, (int)led_on_value);
+                segments_overlay(true);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+                gpio_write(LED_INBUILT_GPIO, 1 - (int)led_on_value);
+                segments_overlay(false);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+            }
+            vTaskDelay(250 / portTICK_PERIOD_MS);
         }
-        vTaskDelay(250 / portTICK_PERIOD_MS);
+
+        gpio_write(LED_INBUILT_GPIO, 1 - (int)led_on_value);
     }
+}
 
-    gpio_write(LED_INBUILT_GPIO, 1 - (int)led_on_value);
+// Printing the traces and statistics, the effects ranked by measured
+// cost among them, takes a while, so it is done below the server
+// priority instead of in the identify callback
+STATIC_TASK(led_dump, 512);
+TaskHandle_t led_dump_task_handle = NULL;
 
-    vTaskDelete(NULL);
+void led_dump_task(void *_args) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        trace_dump();
+        pixel_stream_dump();
+        sync_clock_dump();
+        fx_stats_dump();
+    }
 }
 
 void led_identify(homekit_value_t _value) {
-    // printf("LED identify\n");
-    xTaskCreate(led_identify_task, "LED identify", 128, NULL, 2, NULL);
+    LOG_INFO("LED identify");
+    xTaskNotifyGive(led_identify_task_handle);
+    xTaskNotifyGive(led_dump_task_handle);
 }
 
-homekit_value_t led_on_get() {
-    return HOMEKIT_BOOL(led_on);
+static segment_state_t *segment_state(led_segment_t *segment) {
+    return &segment_states[segment - segments];
 }
 
-void led_on_set(homekit_value_t value) {
-    if (value.format != homekit_format_bool) {
-        // printf("Invalid on-value format: %d\n", value.format);
-        return;
-    }
+static void segment_color_update(led_segment_t *segment) {
+    segment_state_t *state = segment_state(segment);
+
+    ws2812_pixel_t rgb = { { 0, 0, 0, 0 } };
+    hsi2rgb(state->hue, state->saturation, Q16(100), &rgb);
+
+    segment->color = rgb;
+    segment_redraw(segment);
+}
 
-    led_on = value.bool_value;
-    
-    if (led_on) {
-        WS2812FX_setBrightness((uint8_t)floor(led_brightness*2.55));
-        
+static void segment_speed_update(led_segment_t *segment, int fx_speed) {
+    if (fx_speed > 50) {
+        segment->speed = (fx_speed - 50) * 51 / 10;
+        segment->reverse = true;
     } else {
-        WS2812FX_setBrightness(0);
+        segment->speed = abs(fx_speed - 51) * 51 / 10;
+        segment->reverse = false;
     }
+    segment_changed(segment);
 }
 
-homekit_value_t led_brightness_get() {
-    return HOMEKIT_INT(led_brightness);
+static void segment_brightness_update(led_segment_t *segment, int brightness) {
+    uint8_t value = brightness * 255 / 100;
+    segment->layers[LAYER_BASE].brightness = value;
+    segment->layers[LAYER_EFFECT].brightness = value;
+    segment_redraw(segment);
 }
 
-void led_brightness_set(homekit_value_t value) {
-    if (value.format != homekit_format_int) {
-        // printf("Invalid brightness-value format: %d\n", value.format);
+static void segment_mode_update(led_segment_t *segment) {
+    segment_state_t *state = segment_state(segment);
+
+    segment->layers[LAYER_EFFECT].enabled = state->fx_on;
+    segment->mode = state->fx_mode;
+    segment_changed(segment);
+}
+
+static void segment_fx_alpha_update(led_segment_t *segment, q16_t fx_alpha) {
+    segment->layers[LAYER_EFFECT].alpha = q16_to_int(fx_alpha / 100 * ALPHA_OPAQUE);
+    segment_redraw(segment);
+}
+
+void segment_on_callback(homekit_characteristic_t *_ch, homekit_value_t value, void *context) {
+    if (value.format != homekit_format_bool) {
+        LOG_WARNING("Invalid on-value format: %d", value.format);
         return;
     }
-    led_brightness = value.int_value;
-    
-    WS2812FX_setBrightness((uint8_t)floor(led_brightness*2.55));
+
+    led_segment_t *segment = context;
+    segment->on = value.bool_value;
+    segment_redraw(segment);
 }
 
-homekit_value_t led_hue_get() {
-    return HOMEKIT_FLOAT(led_hue);
+void segment_brightness_callback(homekit_characteristic_t *_ch, homekit_value_t value, void *context) {
+    if (value.format != homekit_format_int) {
+        LOG_WARNING("Invalid brightness-value format: %d", value.format);
+        return;
+    }
+
+    segment_brightness_update(context, value.int_value);
 }
 
-void led_hue_set(homekit_value_t value) {
+void segment_hue_callback(homekit_characteristic_t *_ch, homekit_value_t value, void *context) {
     if (value.format != homekit_format_float) {
-        // printf("Invalid hue-value format: %d\n", value.format);
+        LOG_WARNING("Invalid hue-value format: %d", value.format);
         return;
     }
-    led_hue = value.float_value;
-    
-    ws2812_pixel_t rgb = { { 0, 0, 0, 0 } };
-    hsi2rgb(led_hue, led_saturation, 100, &rgb);
-    
-    WS2812FX_setColor(rgb.red, rgb.green, rgb.blue);
-}
 
-homekit_value_t led_saturation_get() {
-    return HOMEKIT_FLOAT(led_saturation);
+    led_segment_t *segment = context;
+    segment_state(segment)->hue = q16_from_float(value.float_value);
+    segment_color_update(segment);
 }
 
-void led_saturation_set(homekit_value_t value) {
+void segment_saturation_callback(homekit_characteristic_t *_ch, homekit_value_t value, void *context) {
     if (value.format != homekit_format_float) {
-        // printf("Invalid sat-value format: %d\n", value.format);
+        LOG_WARNING("Invalid sat-value format: %d", value.format);
         return;
     }
-    led_saturation = value.float_value;
-    
-    ws2812_pixel_t rgb = { { 0, 0, 0, 0 } };
-    hsi2rgb(led_hue, led_saturation, 100, &rgb);
-    
-    WS2812FX_setColor(rgb.red, rgb.green, rgb.blue);
-}
 
-homekit_value_t fx_on_get() {
-    return HOMEKIT_BOOL(fx_on);
+    led_segment_t *segment = context;
+    segment_state(segment)->saturation = q16_from_float(value.float_value);
+    segment_color_update(segment);
 }
 
-void fx_on_set(homekit_value_t value) {
+void fx_on_callback(homekit_characteristic_t *_ch, homekit_value_t value, void *context) {
     if (value.format != homekit_format_bool) {
-        // printf("Invalid on-value format: %d\n", value.format);
+        LOG_WARNING("Invalid on-value format: %d", value.format);
         return;
     }
-    fx_on = value.bool_value;
-    
-    if (fx_on) {
-        WS2812FX_setMode360(fx_hue);
-    } else {
-        WS2812FX_setMode360(0);
-    }
-}
 
-homekit_value_t fx_brightness_get() {
-    return HOMEKIT_INT(fx_brightness);
+    led_segment_t *segment = context;
+    segment_state(segment)->fx_on = value.bool_value;
+    segment_mode_update(segment);
 }
 
-void fx_brightness_set(homekit_value_t value) {
+void fx_speed_callback(homekit_characteristic_t *_ch, homekit_value_t value, void *context) {
     if (value.format != homekit_format_int) {
-        // printf("Invalid brightness-value format: %d\n", value.format);
+        LOG_WARNING("Invalid brightness-value format: %d", value.format);
         return;
     }
-    fx_brightness = value.int_value;
-    
-    if (fx_brightness > 50) {
-        uint8_t fx_speed = fx_brightness - 50;
-        WS2812FX_setSpeed(fx_speed*5.1);
-        WS2812FX_setInverted(true);
-    } else {
-        uint8_t fx_speed = abs(fx_brightness - 51);
-        WS2812FX_setSpeed(fx_speed*5.1);
-        WS2812FX_setInverted(false);
-    }
-}
 
-homekit_value_t fx_hue_get() {
-    return HOMEKIT_FLOAT(fx_hue);
+    segment_speed_update(context, value.int_value);
 }
 
-void fx_hue_set(homekit_value_t value) {
+void fx_hue_callback(homekit_characteristic_t *_ch, homekit_value_t value, void *context) {
     if (value.format != homekit_format_float) {
-        // printf("Invalid hue-value format: %d\n", value.format);
+        LOG_WARNING("Invalid hue-value format: %d", value.format);
         return;
     }
-    fx_hue = value.float_value;
-    
-    WS2812FX_setMode360(fx_hue);
-}
 
-homekit_value_t fx_saturation_get() {
-    return HOMEKIT_FLOAT(fx_saturation);
+    led_segment_t *segment = context;
+    segment_state(segment)->fx_mode = fx_mode_from_hue(q16_from_float(value.float_value));
+    segment_mode_update(segment);
 }
 
-void fx_saturation_set(homekit_value_t value) {
+void fx_alpha_callback(homekit_characteristic_t *_ch, homekit_value_t value, void *context) {
     if (value.format != homekit_format_float) {
-        // printf("Invalid hue-value format: %d\n", value.format);
+        LOG_WARNING("Invalid sat-value format: %d", value.format);
         return;
     }
-    fx_saturation = value.float_value;    
+
+    segment_fx_alpha_update(context, q16_from_float(value.float_value));
+}
+
+void segments_setup() {
+    for (int i = 0; i < SEGMENT_COUNT; i++) {
+        led_segment_t *segment = &segments[i];
+        segment_state_t *state = &segment_states[i];
+
+        state->hue = Q16(SEGMENT_HUE);
+        state->saturation = Q16(SEGMENT_SATURATION);
+        state->fx_on = SEGMENT_FX_ON;
+        state->fx_mode = fx_mode_from_hue(Q16(SEGMENT_FX_HUE));
+
+        segment->on = SEGMENT_ON;
+        segment->layers[LAYER_BASE] = (layer_t) {
+            .enabled = true, .blend = BLEND_OVER, .alpha = ALPHA_OPAQUE,
+        };
+        segment->layers[LAYER_EFFECT] = (layer_t) {
+            .enabled = SEGMENT_FX_ON, .blend = BLEND_OVER,
+        };
+        segment->layers[LAYER_OVERLAY] = (layer_t) {
+            .enabled = false, .blend = BLEND_ADD, .alpha = ALPHA_OPAQUE, .brightness = 255,
+        };
+        segment->overlay_color = (ws2812_pixel_t) { { 255, 255, 255, 0 } };
+
+        segment_brightness_update(segment, SEGMENT_BRIGHTNESS);
+        segment_fx_alpha_update(segment, Q16(SEGMENT_FX_ALPHA));
+        segment_color_update(segment);
+        segment_speed_update(segment, SEGMENT_FX_SPEED);
+        segment_mode_update(segment);
+    }
+
+    segments_init(segments, SEGMENT_COUNT, LED_COUNT);
+}
+
+// Effects stop while a show controller streams pixels
+static void stream_hold(bool hold, void *_context) {
+    segments_hold(hold);
 }
 
+#define SEGMENT_CALLBACK(fn, index) \
+    .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(fn, .context=&segments[index])
+
+// Every segment is a light bulb for its color and brightness
+// plus another light bulb for its effect
+#define SEGMENT_SERVICES(index, segment_name) \
+        HOMEKIT_SERVICE(LIGHTBULB, .primary = (index == 0), .characteristics = (homekit_characteristic_t*[]) { \
+            HOMEKIT_CHARACTERISTIC(NAME, segment_name), \
+            HOMEKIT_CHARACTERISTIC(ON, SEGMENT_ON, SEGMENT_CALLBACK(segment_on_callback, index)), \
+            HOMEKIT_CHARACTERISTIC(BRIGHTNESS, SEGMENT_BRIGHTNESS, SEGMENT_CALLBACK(segment_brightness_callback, index)), \
+            HOMEKIT_CHARACTERISTIC(HUE, SEGMENT_HUE, SEGMENT_CALLBACK(segment_hue_callback, index)), \
+            HOMEKIT_CHARACTERISTIC(SATURATION, SEGMENT_SATURATION, SEGMENT_CALLBACK(segment_saturation_callback, index)), \
+            NULL \
+        }), \
+        HOMEKIT_SERVICE(LIGHTBULB, .characteristics = (homekit_characteristic_t*[]) { \
+            HOMEKIT_CHARACTERISTIC(NAME, segment_name " FX"), \
+            HOMEKIT_CHARACTERISTIC(ON, SEGMENT_FX_ON, SEGMENT_CALLBACK(fx_on_callback, index)), \
+            HOMEKIT_CHARACTERISTIC(BRIGHTNESS, SEGMENT_FX_SPEED, SEGMENT_CALLBACK(fx_speed_callback, index)), \
+            HOMEKIT_CHARACTERISTIC(HUE, SEGMENT_FX_HUE, SEGMENT_CALLBACK(fx_hue_callback, index)), \
+            HOMEKIT_CHARACTERISTIC(SATURATION, SEGMENT_FX_ALPHA, SEGMENT_CALLBACK(fx_alpha_callback, index)), \
+            NULL \
+        })
+
 homekit_characteristic_t name = HOMEKIT_CHARACTERISTIC_(NAME, "Chihiro");
 
+homekit_value_t led_current_get() {
+    return HOMEKIT_UINT32(segments_power_limit()->current_ma);
+}
+
 homekit_accessory_t *accessories[] = {
     HOMEKIT_ACCESSORY(.id = 1, .category = homekit_accessory_category_lightbulb, .services = (homekit_service_t*[]) {
         HOMEKIT_SERVICE(ACCESSORY_INFORMATION, .characteristics = (homekit_characteristic_t*[]) {
@@ -261,56 +380,11 @@ homekit_accessory_t *accessories[] = {
             HOMEKIT_CHARACTERISTIC(MODEL, "LEDStripFX"),
             HOMEKIT_CHARACTERISTIC(FIRMWARE_REVISION, "0.1"),
             HOMEKIT_CHARACTERISTIC(IDENTIFY, led_identify),
+            HOMEKIT_CHARACTERISTIC(CUSTOM_POWER_CURRENT, .getter=led_current_get),
             NULL
         }),
-        HOMEKIT_SERVICE(LIGHTBULB, .primary = true, .characteristics = (homekit_characteristic_t*[]) {
-            HOMEKIT_CHARACTERISTIC(NAME, "Chihiro"),
-            HOMEKIT_CHARACTERISTIC(
-                ON, true,
-            .getter = led_on_get,
-            .setter = led_on_set
-                ),
-            HOMEKIT_CHARACTERISTIC(
-                BRIGHTNESS, 100,
-            .getter = led_brightness_get,
-            .setter = led_brightness_set
-                ),
-            HOMEKIT_CHARACTERISTIC(
-                HUE, 0,
-            .getter = led_hue_get,
-            .setter = led_hue_set
-                ),
-            HOMEKIT_CHARACTERISTIC(
-                SATURATION, 0,
-            .getter = led_saturation_get,
-            .setter = led_saturation_set
-                ),
-            NULL
-        }),
-        HOMEKIT_SERVICE(LIGHTBULB, .primary = true, .characteristics = (homekit_characteristic_t*[]) {
-            HOMEKIT_CHARACTERISTIC(NAME, "Chihiro FX"),
-            HOMEKIT_CHARACTERISTIC(
-                ON, true,
-            .getter = fx_on_get,
-            .setter = fx_on_set
-                ),
-            HOMEKIT_CHARACTERISTIC(
-                BRIGHTNESS, 100,
-            .getter = fx_brightness_get,
-            .setter = fx_brightness_set
-                ),
-            HOMEKIT_CHARACTERISTIC(
-                HUE, 0,
-            .getter = fx_hue_get,
-            .setter = fx_hue_set
-                ),
-            HOMEKIT_CHARACTERISTIC(
-                SATURATION, 0,
-            .getter = fx_saturation_get,
-            .setter = fx_saturation_set
-                ),
-            NULL
-        }),
+        SEGMENT_SERVICES(0, "Chihiro"),
+        SEGMENT_SERVICES(1, "Chihiro 2"),
         NULL
     }),
     NULL
@@ -323,6 +397,9 @@ homekit_server_config_t config = {
 
 void user_init(void) {
     // uart_set_baud(0, 115200);
+    logger_init(LOGGER_SINK_NONE);
+    led_identify_task_handle = STATIC_TASK_CREATE(led_identify, led_identify_task, "LED identify", NULL, 2);
+    led_dump_task_handle = STATIC_TASK_CREATE(led_dump, led_dump_task, "LED dump", NULL, 1);
 
     // This example shows how to use same firmware for multiple similar accessories
     // without name conflicts. It uses the last 3 bytes of accessory's MAC address as
@@ -335,8 +412,12 @@ void user_init(void) {
     name.value = HOMEKIT_STRING(name_value);
 
     wifi_init();
-    WS2812FX_init(LED_COUNT);
+    sync_clock_init();
+    segments_setup();
+    segments_start();
+    pixel_stream_init(segments_frame_buffer(), stream_hold, NULL);
     homekit_server_init(&config);
-    
-    led_identify(HOMEKIT_INT(led_brightness));
+
+    // blink once at boot, there is nothing to dump yet
+    xTaskNotifyGive(led_identify_task_handle);
 }
\ No newline at end of file
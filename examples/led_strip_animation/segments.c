@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <trace/trace.h>
+#include <frame_buffer/frame_buffer.h>
+#include <sync_clock/sync_clock.h>
+#include <static_alloc/static_alloc.h>
+
+#include "segments.h"
+#include "effects.h"
+
+#define FRAME_DELAY (1000 / SEGMENTS_FPS / portTICK_PERIOD_MS)
+
+// Trace events
+#define TRACE_FRAME 0
+#define TRACE_FRAME_PUSH 1
+
+
+static led_segment_t *segments = NULL;
+static uint8_t segment_count = 0;
+static uint16_t led_count = 0;
+
+static frame_buffer_t frames;
+static ws2812_pixel_t *pixels = NULL;   // back buffer while a frame is rendered
+static power_limit_t power_limit;
+
+static volatile bool held = false;
+
+// Effect state of all segments, each one uses the part of its LEDs
+static uint8_t effect_states[SEGMENTS_MAX_LEDS * FX_MAX_STATE_SIZE];
+
+
+void segment_set_pixel(led_segment_t *segment, uint16_t index, ws2812_pixel_t color) {
+    if (index >= segment->count)
+        return;
+
+    if (segment->reverse)
+        index = segment->count - index - 1;
+
+    compositor_blend(&pixels[segment->start + index], color, &segment->layers[segment->layer]);
+}
+
+void segment_fill(led_segment_t *segment, ws2812_pixel_t color) {
+    for (int i = 0; i < segment->count; i++) {
+        segment_set_pixel(segment, i, color);
+    }
+}
+
+void segment_changed(led_segment_t *segment) {
+    segment->changed = true;
+}
+
+void segment_redraw(led_segment_t *segment) {
+    segment->dirty = true;
+}
+
+static void segment_reset(led_segment_t *segment, uint32_t now) {
+    segment->changed = false;
+    segment->dirty = true;
+    segment->step = 0;
+    segment->next_step_time = now;
+    segment->step_delay = 0;
+
+    if (segment->state)
+        memset(segment->state, 0, segment->state_size);
+}
+
+// Minimal delay between steps that keeps segment's effect within
+// its share of the CPU budget
+static uint16_t segment_min_delay(led_segment_t *segment) {
+    uint32_t cost = fx_cost(segment->mode, segment->count);
+    return cost * segment_count * 100 / SEGMENTS_CPU_BUDGET / 1000;
+}
+
+// Draws all enabled layers of the segment straight into the frame buffer
+static void segment_compose(led_segment_t *segment, uint32_t now) {
+    memset(&pixels[segment->start], 0, segment->count * sizeof(ws2812_pixel_t));
+    if (!segment->on)
+        return;
+
+    for (segment->layer = 0; segment->layer < LAYER_COUNT; segment->layer++) {
+        if (!segment->layers[segment->layer].enabled)
+            continue;
+
+        switch (segment->layer) {
+            case LAYER_BASE:
+                segment_fill(segment, segment->color);
+                break;
+            case LAYER_EFFECT: {
+                uint16_t delay = fx_render(segment);
+
+                uint16_t min_delay = segment_min_delay(segment);
+                if (delay < min_delay)
+                    delay = min_delay;
+
+                // Steps start on multiples of their delay in shared time,
+                // so they line up on all devices
+                segment->step_delay = delay;
+                if ((int32_t)(now - segment->next_step_time) >= 0)
+                    segment->next_step_time = (now / delay + 1) * delay;
+                break;
+            }
+            case LAYER_OVERLAY:
+                segment_fill(segment, segment->overlay_color);
+                break;
+        }
+    }
+}
+
+static bool segment_render(led_segment_t *segment, uint32_t now) {
+    bool restarted = segment->changed;
+    if (restarted)
+        segment_reset(segment, now);
+
+    // the shared clock goes back when it is stepped to a new leader
+    bool clock_stepped = (int32_t)(segment->next_step_time - now) > segment->step_delay;
+
+    if (segment->on && segment->layers[LAYER_EFFECT].enabled &&
+            ((int32_t)(now - segment->next_step_time) >= 0 || clock_stepped)) {
+        // freshly restarted effect shows its first step
+        if (!restarted)
+            fx_advance(segment, now);
+        segment->dirty = true;
+    }
+
+    if (!segment->dirty)
+        return false;
+
+    segment->dirty = false;
+    segment_compose(segment, now);
+
+    return true;
+}
+
+STATIC_TASK(segments, 256);
+
+static void segments_task(void *_args) {
+    TickType_t last_wake_time = xTaskGetTickCount();
+
+    while (1) {
+        if (held) {
+            vTaskDelayUntil(&last_wake_time, FRAME_DELAY);
+            continue;
+        }
+
+        // effects run on the clock shared with other devices
+        uint32_t now = sync_clock_ms();
+
+        // All segments render into the same buffer, so the whole
+        // strip is updated with one transfer no matter how many
+        // segments changed during this frame. Segments that did not
+        // change are kept from the previous frame.
+        TRACE_BEGIN(TRACE_FRAME);
+        pixels = frame_buffer_begin(&frames, true);
+        if (held) {
+            // held while waiting for the buffer
+            frame_buffer_end(&frames);
+            TRACE_END(TRACE_FRAME);
+            continue;
+        }
+
+        bool dirty = false;
+        for (int i = 0; i < segment_count; i++) {
+            dirty |= segment_render(&segments[i], now);
+        }
+
+        // frames are sent while brightness comes back after dimming
+        if (dirty || power_limit_recovering(&power_limit)) {
+            TRACE_BEGIN(TRACE_FRAME_PUSH);
+            frame_buffer_show(&frames);
+            TRACE_END(TRACE_FRAME_PUSH);
+        } else {
+            frame_buffer_end(&frames);
+        }
+        TRACE_END(TRACE_FRAME);
+
+        vTaskDelayUntil(&last_wake_time, FRAME_DELAY);
+    }
+}
+
+int segments_init(led_segment_t *_segments, uint8_t _segment_count, uint16_t _led_count) {
+    for (int i = 0; i < _segment_count; i++) {
+        if (_segments[i].start + _segments[i].count > _led_count)
+            return -1;
+    }
+
+    if (frame_buffer_init(&frames, _led_count, PIXEL_RGB, NULL))
+        return -1;
+
+    power_limit_init(&power_limit, SEGMENTS_POWER_BUDGET);
+    frame_buffer_set_limit(&frames, &power_limit);
+
+    segments = _segments;
+    segment_count = _segment_count;
+    led_count = _led_count;
+
+    for (int i = 0; i < segment_count; i++) {
+        led_segment_t *segment = &segments[i];
+        if (segment->start + segment->count <= SEGMENTS_MAX_LEDS) {
+            segment->state = &effect_states[segment->start * FX_MAX_STATE_SIZE];
+            segment->state_size = segment->count * FX_MAX_STATE_SIZE;
+        } else {
+            segment->state = NULL;
+            segment->state_size = 0;
+        }
+        segment_changed(segment);
+    }
+
+    trace_name(TRACE_FRAME, "frame");
+    trace_name(TRACE_FRAME_PUSH, "frame push");
+
+    frame_buffer_begin(&frames, false);
+    frame_buffer_show(&frames);
+
+    return 0;
+}
+
+void segments_start() {
+    STATIC_TASK_CREATE(segments, segments_task, "Segments", NULL, 2);
+}
+
+const power_limit_t *segments_power_limit() {
+    return &power_limit;
+}
+
+frame_buffer_t *segments_frame_buffer() {
+    return &frames;
+}
+
+void segments_hold(bool hold) {
+    if (hold == held)
+        return;
+
+    // Whoever held the strip drew over all segments
+    if (!hold) {
+        for (int i = 0; i < segment_count; i++) {
+            segment_redraw(&segments[i]);
+        }
+    }
+
+    held = hold;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ws2812_i2s/ws2812_i2s.h>
+#include <power_limit/power_limit.h>
+#include <frame_buffer/frame_buffer.h>
+
+#include "compositor.h"
+
+/*
+ * Segments split one physical strip into several logical strips.
+ * Every segment runs its own effect with its own speed and color,
+ * but all of them are rendered into one shared frame buffer, which
+ * is pushed to the strip with a single DMA transfer per frame.
+ *
+ * Segment's picture is composed of a solid color base layer, an effect
+ * layer and an overlay layer, see compositor.h.
+ */
+
+// Frame rate of the renderer task
+#define SEGMENTS_FPS 50
+
+// Share of CPU time, in percent, that effects of all segments may use
+// together. Segments whose effect is more expensive than their share
+// allows are rendered at a lower frame rate.
+#ifndef SEGMENTS_CPU_BUDGET
+#define SEGMENTS_CPU_BUDGET 30
+#endif
+
+// LEDs that have room for effect state. Segments past it fall back to
+// the static effect when their effect needs state.
+#ifndef SEGMENTS_MAX_LEDS
+#define SEGMENTS_MAX_LEDS 300
+#endif
+
+// Current the whole strip may draw, in milliamps, 0 for no limit
+#ifndef SEGMENTS_POWER_BUDGET
+#define SEGMENTS_POWER_BUDGET 2000
+#endif
+
+typedef struct {
+    uint16_t start;             // index of the first LED of the segment
+    uint16_t count;             // number of LEDs in the segment
+
+    bool on;                    // segment stays dark while off, whatever its layers are
+    layer_t layers[LAYER_COUNT];
+
+    ws2812_pixel_t color;       // color of the base layer, also used by effects
+    ws2812_pixel_t overlay_color;
+
+    uint8_t mode;               // effect, see fx_mode_t
+    uint8_t speed;              // 0 (slowest) to 255 (fastest)
+    bool reverse;               // run effect towards the start of the segment
+
+    // renderer state
+    bool changed;
+    bool dirty;
+    uint8_t layer;              // layer being drawn
+    uint32_t step;
+    uint32_t next_step_time;
+    uint16_t step_delay;        // delay of the current step, 0 until it is drawn
+    void *state;
+    uint16_t state_size;
+} led_segment_t;
+
+/**
+    Allocates the frame buffer and initializes the strip.
+
+    @param segments Segment table. Segments should not overlap and must fit into led_count.
+    @param segment_count Number of segments in the table.
+    @param led_count Total number of LEDs on the strip.
+    @return A negative integer if this method fails.
+*/
+int segments_init(led_segment_t *segments, uint8_t segment_count, uint16_t led_count);
+
+/**
+    Starts the renderer task.
+*/
+void segments_start();
+
+/**
+    Power limiter of the strip, see current_ma for the estimated current.
+*/
+const power_limit_t *segments_power_limit();
+
+/**
+    Frame buffer of the strip.
+*/
+frame_buffer_t *segments_frame_buffer();
+
+/**
+    Stops rendering, so another owner can draw on the whole strip
+    through the frame buffer. The renderer finishes the frame it is
+    on. Once released, all segments are drawn again.
+*/
+void segments_hold(bool hold);
+
+/**
+    Restarts the segment's effect on the next frame. Call after changing
+    the segment's effect.
+*/
+void segment_changed(led_segment_t *segment);
+
+/**
+    Redraws the segment on the next frame. Call after changing
+    segment's colors or layers.
+*/
+void segment_redraw(led_segment_t *segment);
+
+/**
+    Blends a color into the segment's pixel using the layer being drawn.
+*/
+void segment_set_pixel(led_segment_t *segment, uint16_t index, ws2812_pixel_t color);
+void segment_fill(led_segment_t *segment, ws2812_pixel_t color);
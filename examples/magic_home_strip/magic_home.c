@@ -17,11 +17,12 @@
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
-#include <math.h> 
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <static_alloc/static_alloc.h>
 #include <wifi_config.h>
+#include <fixmath/fixmath.h>
 
 #include "multipwm.h"
 
@@ -48,40 +49,42 @@ rgb_color_t current_color = { { 0, 0, 0, 0 } };
 rgb_color_t target_color = { { 0, 0, 0, 0 } };
 
 // Global variables
-float led_hue = 0;              // hue is scaled 0 to 360
-float led_saturation = 59;      // saturation is scaled 0 to 100
-float led_brightness = 100;     // brightness is scaled 0 to 100
+q16_t led_hue = Q16(0);         // hue is scaled 0 to 360
+q16_t led_saturation = Q16(59); // saturation is scaled 0 to 100
+q16_t led_brightness = Q16(100);// brightness is scaled 0 to 100
 bool led_on = false;            // on is boolean on or off
 
 //http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
-static void hsi2rgb(float h, float s, float i, rgb_color_t* rgb) {
+static void hsi2rgb(q16_t h, q16_t s, q16_t i, rgb_color_t* rgb) {
     int r, g, b;
+    q16_t ratio;
 
-    while (h < 0) { h += 360.0F; };     // cycle h around to 0-360 degrees
-    while (h >= 360) { h -= 360.0F; };
-    h = 3.14159F*h / 180.0F;            // convert to radians.
-    s /= 100.0F;                        // from percentage to ratio
-    i /= 100.0F;                        // from percentage to ratio
-    s = s > 0 ? (s < 1 ? s : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i > 0 ? (i < 1 ? i : 1) : 0;    // clamp s and i to interval [0,1]
-    //i = i * sqrt(i);                    // shape intensity to have finer granularity near 0
-
-    if (h < 2.09439) {
-        r = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        g = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        b = LED_RGB_SCALE * i / 3 * (1 - s);
+    h = q16_mod(h, Q16(360));           // cycle h around to 0-360 degrees
+    s = q16_clamp(s / 100, 0, Q16_ONE); // from percentage to ratio, clamped to [0,1]
+    i = q16_clamp(i / 100, 0, Q16_ONE); // from percentage to ratio, clamped to [0,1]
+    //i = q16_mul(i, q16_sqrt(i));      // shape intensity to have finer granularity near 0
+
+    q16_t base = i * LED_RGB_SCALE / 3;
+
+    if (h < Q16(120)) {
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60) - h));
+        r = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, ratio)));
+        g = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, Q16_ONE - ratio)));
+        b = q16_round(q16_mul(base, Q16_ONE - s));
     }
-    else if (h < 4.188787) {
-        h = h - 2.09439;
-        g = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        b = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        r = LED_RGB_SCALE * i / 3 * (1 - s);
+    else if (h < Q16(240)) {
+        h = h - Q16(120);
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60) - h));
+        g = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, ratio)));
+        b = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, Q16_ONE - ratio)));
+        r = q16_round(q16_mul(base, Q16_ONE - s));
     }
     else {
-        h = h - 4.188787;
-        b = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        r = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        g = LED_RGB_SCALE * i / 3 * (1 - s);
+        h = h - Q16(240);
+        ratio = q16_div(q16_cos(h), q16_cos(Q16(60) - h));
+        b = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, ratio)));
+        r = q16_round(q16_mul(base, Q16_ONE + q16_mul(s, Q16_ONE - ratio)));
+        g = q16_round(q16_mul(base, Q16_ONE - s));
     }
 
     rgb->red = (uint8_t) r;
@@ -89,32 +92,37 @@ static void hsi2rgb(float h, float s, float i, rgb_color_t* rgb) {
     rgb->blue = (uint8_t) b;
 }
 
+STATIC_TASK(led_identify, 128);
+TaskHandle_t led_identify_task_handle = NULL;
+
 void led_identify_task(void *_args) {
-    printf("LED identify\n");
-    
-    rgb_color_t color = target_color;
-    rgb_color_t black_color = { { 0, 0, 0, 0 } };
-    rgb_color_t white_color = { { 128, 128, 128, 128 } };
-    
-    for (int i=0; i<3; i++) {
-        for (int j=0; j<2; j++) {
-            target_color = white_color;
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            
-            target_color = black_color;
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-        }
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-        vTaskDelay(250 / portTICK_PERIOD_MS);
-    }
+        printf("LED identify\n");
 
-    target_color = color;
+        rgb_color_t color = target_color;
+        rgb_color_t black_color = { { 0, 0, 0, 0 } };
+        rgb_color_t white_color = { { 128, 128, 128, 128 } };
 
-    vTaskDelete(NULL);
+        for (int i=0; i<3; i++) {
+            for (int j=0; j<2; j++) {
+                target_color = white_color;
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+
+                target_color = black_color;
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+            }
+
+            vTaskDelay(250 / portTICK_PERIOD_MS);
+        }
+
+        target_color = color;
+    }
 }
 
 void led_identify(homekit_value_t _value) {
-    xTaskCreate(led_identify_task, "LED identify", 128, NULL, 2, NULL);
+    xTaskNotifyGive(led_identify_task_handle);
 }
 
 homekit_value_t led_on_get() {
@@ -131,7 +139,7 @@ void led_on_set(homekit_value_t value) {
 }
 
 homekit_value_t led_brightness_get() {
-    return HOMEKIT_INT(led_brightness);
+    return HOMEKIT_INT(q16_round(led_brightness));
 }
 
 void led_brightness_set(homekit_value_t value) {
@@ -139,11 +147,11 @@ void led_brightness_set(homekit_value_t value) {
         // printf("Invalid brightness-value format: %d\n", value.format);
         return;
     }
-    led_brightness = value.int_value;
+    led_brightness = q16_from_int(value.int_value);
 }
 
 homekit_value_t led_hue_get() {
-    return HOMEKIT_FLOAT(led_hue);
+    return HOMEKIT_FLOAT(q16_to_float(led_hue));
 }
 
 void led_hue_set(homekit_value_t value) {
@@ -151,11 +159,11 @@ void led_hue_set(homekit_value_t value) {
         // printf("Invalid hue-value format: %d\n", value.format);
         return;
     }
-    led_hue = value.float_value;
+    led_hue = q16_from_float(value.float_value);
 }
 
 homekit_value_t led_saturation_get() {
-    return HOMEKIT_FLOAT(led_saturation);
+    return HOMEKIT_FLOAT(q16_to_float(led_saturation));
 }
 
 void led_saturation_set(homekit_value_t value) {
@@ -163,7 +171,7 @@ void led_saturation_set(homekit_value_t value) {
         // printf("Invalid sat-value format: %d\n", value.format);
         return;
     }
-    led_saturation = value.float_value;
+    led_saturation = q16_from_float(value.float_value);
 }
 
 homekit_characteristic_t name = HOMEKIT_CHARACTERISTIC_(NAME, "LED Strip");
@@ -213,7 +221,9 @@ homekit_server_config_t config = {
     .password = "190-11-978"    //changed tobe valid
 };
 
-IRAM void multipwm_task(void *pvParameters) {
+STATIC_TASK(multipwm, 256);
+
+void multipwm_task(void *pvParameters) {
     const TickType_t xPeriod = pdMS_TO_TICKS(LPF_INTERVAL);
     TickType_t xLastWakeTime = xTaskGetTickCount();
     
@@ -258,6 +268,7 @@ void on_wifi_ready() {
 
 void user_init(void) {
     //uart_set_baud(0, 115200);
+    led_identify_task_handle = STATIC_TASK_CREATE(led_identify, led_identify_task, "LED identify", NULL, 2);
     
     // This example shows how to use same firmware for multiple similar accessories
     // without name conflicts. It uses the last 3 bytes of accessory's MAC address as
@@ -271,5 +282,5 @@ void user_init(void) {
 
     wifi_config_init("MagicHome Led Strip", NULL, on_wifi_ready);
     
-    xTaskCreate(multipwm_task, "multipwm", 256, NULL, 2, NULL);
+    STATIC_TASK_CREATE(multipwm, multipwm_task, "multipwm", NULL, 2);
 }
@@ -29,6 +29,9 @@
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
+#include <static_alloc/static_alloc.h>
+#include <journal/journal.h>
+#include <relay/relay.h>
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
@@ -42,49 +45,67 @@ const int relay_gpio = 12;
 const int led_gpio = 13;
 // The GPIO pin that is oconnected to the button on the Sonoff Basic.
 const int button_gpio = 0;
+// The Sonoff Basic has no zero-cross detector. On boards that have one,
+// set its GPIO and the relay's operate time in microseconds.
+#define ZERO_CROSS_GPIO RELAY_NO_ZERO_CROSS
+#define RELAY_LEAD_US 0
+
+int switch_relay = -1;
+
+// Journal key of the relay state
+#define JOURNAL_SWITCH_ON 0
 
 void switch_on_callback(homekit_characteristic_t *_ch, homekit_value_t on, void *context);
 void button_callback(uint8_t gpio, button_event_t event);
 
 void relay_write(bool on) {
-    gpio_write(relay_gpio, on ? 1 : 0);
+    relay_set(switch_relay, on);
 }
 
 void led_write(bool on) {
     gpio_write(led_gpio, on ? 0 : 1);
 }
 
-void reset_configuration_task() {
-    //Flash the LED first before we start the reset
-    for (int i=0; i<3; i++) {
-        led_write(true);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-        led_write(false);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+STATIC_TASK(reset_configuration, 256);
+TaskHandle_t reset_configuration_task_handle = NULL;
+
+void reset_configuration_task(void *_args) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        //Flash the LED first before we start the reset
+        for (int i=0; i<3; i++) {
+            led_write(true);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            led_write(false);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+        }
+
+        printf("Resetting Wifi Config\n");
+
+        wifi_config_reset();
+
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+
+        printf("Resetting HomeKit Config\n");
+
+        homekit_server_reset();
+
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+
+        printf("Resetting saved state\n");
+
+        journal_reset();
+
+        printf("Restarting\n");
+
+        sdk_system_restart();
     }
-    
-    printf("Resetting Wifi Config\n");
-    
-    wifi_config_reset();
-    
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-    
-    printf("Resetting HomeKit Config\n");
-    
-    homekit_server_reset();
-    
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-    
-    printf("Restarting\n");
-    
-    sdk_system_restart();
-    
-    vTaskDelete(NULL);
 }
 
 void reset_configuration() {
     printf("Resetting Sonoff configuration\n");
-    xTaskCreate(reset_configuration_task, "Reset configuration", 256, NULL, 2, NULL);
+    xTaskNotifyGive(reset_configuration_task_handle);
 }
 
 homekit_characteristic_t switch_on = HOMEKIT_CHARACTERISTIC_(
@@ -94,12 +115,13 @@ homekit_characteristic_t switch_on = HOMEKIT_CHARACTERISTIC_(
 void gpio_init() {
     gpio_enable(led_gpio, GPIO_OUTPUT);
     led_write(false);
-    gpio_enable(relay_gpio, GPIO_OUTPUT);
-    relay_write(switch_on.value.bool_value);
+    relay_init(ZERO_CROSS_GPIO, RELAY_LEAD_US);
+    switch_relay = relay_create(relay_gpio, switch_on.value.bool_value);
 }
 
 void switch_on_callback(homekit_characteristic_t *_ch, homekit_value_t on, void *context) {
     relay_write(switch_on.value.bool_value);
+    journal_save(JOURNAL_SWITCH_ON, &switch_on);
 }
 
 void button_callback(uint8_t gpio, button_event_t event) {
@@ -109,6 +131,7 @@ void button_callback(uint8_t gpio, button_event_t event) {
             switch_on.value.bool_value = !switch_on.value.bool_value;
             relay_write(switch_on.value.bool_value);
             homekit_characteristic_notify(&switch_on, switch_on.value);
+            journal_save(JOURNAL_SWITCH_ON, &switch_on);
             break;
         case button_event_long_press:
             reset_configuration();
@@ -118,27 +141,32 @@ void button_callback(uint8_t gpio, button_event_t event) {
     }
 }
 
+STATIC_TASK(switch_identify, 128);
+TaskHandle_t switch_identify_task_handle = NULL;
+
 void switch_identify_task(void *_args) {
-    // We identify the Sonoff by Flashing it's LED.
-    for (int i=0; i<3; i++) {
-        for (int j=0; j<2; j++) {
-            led_write(true);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            led_write(false);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // We identify the Sonoff by Flashing it's LED.
+        for (int i=0; i<3; i++) {
+            for (int j=0; j<2; j++) {
+                led_write(true);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+                led_write(false);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+            }
+
+            vTaskDelay(250 / portTICK_PERIOD_MS);
         }
 
-        vTaskDelay(250 / portTICK_PERIOD_MS);
+        led_write(false);
     }
-
-    led_write(false);
-
-    vTaskDelete(NULL);
 }
 
 void switch_identify(homekit_value_t _value) {
     printf("Switch identify\n");
-    xTaskCreate(switch_identify_task, "Switch identify", 128, NULL, 2, NULL);
+    xTaskNotifyGive(switch_identify_task_handle);
 }
 
 homekit_characteristic_t name = HOMEKIT_CHARACTERISTIC_(NAME, "Sonoff Switch");
@@ -186,11 +214,22 @@ void create_accessory_name() {
     name.value = HOMEKIT_STRING(name_value);
 }
 
+// Tasks are created once and sleep until they are notified
+static void tasks_init() {
+    reset_configuration_task_handle = STATIC_TASK_CREATE(reset_configuration, reset_configuration_task, "Reset configuration", NULL, 2);
+    switch_identify_task_handle = STATIC_TASK_CREATE(switch_identify, switch_identify_task, "Switch identify", NULL, 2);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
+    tasks_init();
 
     create_accessory_name();
-    
+
+    // Relay comes back in the state it had before reboot
+    journal_init();
+    journal_restore(JOURNAL_SWITCH_ON, &switch_on);
+
     wifi_config_init("sonoff-switch", NULL, on_wifi_ready);
     gpio_init();
 
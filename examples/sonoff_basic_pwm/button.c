@@ -1,4 +1,5 @@
 #include <string.h>
+#include <esp8266.h>
 #include <esplibs/libmain.h>
 #include "button.h"
 
@@ -20,8 +21,23 @@ typedef struct _button {
 
 button_t *buttons = NULL;
 
+// Buttons are allocated from a fixed pool instead of the heap
+#ifndef BUTTON_MAX_COUNT
+#define BUTTON_MAX_COUNT 2
+#endif
 
-static button_t *button_find_by_gpio(const uint8_t gpio_num) {
+static button_t button_pool[BUTTON_MAX_COUNT];
+
+static button_t *button_alloc() {
+    for (int i = 0; i < BUTTON_MAX_COUNT; i++) {
+        if (!button_pool[i].callback)
+            return &button_pool[i];
+    }
+    return NULL;
+}
+
+
+static IRAM button_t *button_find_by_gpio(const uint8_t gpio_num) {
     button_t *button = buttons;
     while (button && button->gpio_num != gpio_num)
         button = button->next;
@@ -30,7 +46,7 @@ static button_t *button_find_by_gpio(const uint8_t gpio_num) {
 }
 
 
-void button_intr_callback(uint8_t gpio) {
+IRAM void button_intr_callback(uint8_t gpio) {
     button_t *button = button_find_by_gpio(gpio);
     if (!button)
         return;
@@ -59,7 +75,10 @@ int button_create(const uint8_t gpio_num, bool pressed_value, uint16_t long_pres
     if (button)
         return -1;
 
-    button = malloc(sizeof(button_t));
+    button = button_alloc();
+    if (!button)
+        return -1;
+
     memset(button, 0, sizeof(*button));
     button->gpio_num = gpio_num;
     button->callback = callback;
@@ -99,11 +118,13 @@ void button_delete(const uint8_t gpio_num) {
                 b->next = b->next->next;
                 break;
             }
+            b = b->next;
         }
     }
 
     if (button) {
         gpio_set_interrupt(gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
+        memset(button, 0, sizeof(*button));
     }
 }
 
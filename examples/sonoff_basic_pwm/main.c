@@ -30,9 +30,12 @@ modified to do pulse-width-modulation (PWM) of LED
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
+#include <static_alloc/static_alloc.h>
+#include <boot_profile/boot_profile.h>
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <wifi_fast/wifi_fast.h>
 #include <wifi_config.h>
 #include "wifi.h"
 
@@ -54,8 +57,12 @@ const int pwm_gpio = 13;
 
 const bool dev = true;
 
-float bri;
-bool on;
+float bri = 100;
+bool on = false;
+
+// Set once PWM runs, controllers can use the accessory before
+static volatile bool light_ready = false;
+
 uint8_t pins[1];
 //void toggle_callback(uint8_t gpio);  // as this needed
 
@@ -64,40 +71,40 @@ void led_write(bool on) {
 }
 
 
-void reset_configuration_task() {
-    //Flash the LED first before we start the reset
-    for (int i=0; i<3; i++) {
-        led_write(true);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-        led_write(false);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+STATIC_TASK(reset_configuration, 256);
+TaskHandle_t reset_configuration_task_handle = NULL;
+
+void reset_configuration_task(void *_args) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        //Flash the LED first before we start the reset
+        for (int i=0; i<3; i++) {
+            led_write(true);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            led_write(false);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+        }
+        printf("Resetting Wifi Config\n");
+        wifi_config_reset();
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        printf("Resetting HomeKit Config\n");
+        homekit_server_reset();
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+
+        printf("Restarting\n");
+        sdk_system_restart();
     }
-    printf("Resetting Wifi Config\n");
-    wifi_config_reset();
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-    printf("Resetting HomeKit Config\n");
-    homekit_server_reset();
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-     
-    printf("Restarting\n");
-    sdk_system_restart();
-    vTaskDelete(NULL);
 }
 
 void reset_configuration() {
     printf("Resetting Sonoff configuration\n");
-    xTaskCreate(reset_configuration_task, "Reset configuration", 256, NULL, 2, NULL);
+    xTaskNotifyGive(reset_configuration_task_handle);
 }
 
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 
@@ -109,34 +116,41 @@ void gpio_init() {
 }
 
 
-void lightSET_task(void *pvParameters) {
-    int w;
-    if (on) {
-        w = (UINT16_MAX - UINT16_MAX*bri/100);
-        pwm_set_duty(w);
-        printf("ON  %3d [%5d]\n", (int)bri , w);
-    } else {
-        printf("OFF\n");
-        pwm_set_duty(UINT16_MAX);
+STATIC_TASK(lightSET, 256);
+TaskHandle_t lightSET_task_handle = NULL;
+
+void lightSET_task(void *_args) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!light_ready)
+            continue;
+
+        int w;
+        if (on) {
+            w = (UINT16_MAX - UINT16_MAX*bri/100);
+            pwm_set_duty(w);
+            printf("ON  %3d [%5d]\n", (int)bri , w);
+        } else {
+            printf("OFF\n");
+            pwm_set_duty(UINT16_MAX);
+        }
     }
-    vTaskDelete(NULL);
 }
 
 
 void lightSET() {
-    xTaskCreate(lightSET_task, "Light Set", 256, NULL, 2, NULL);
+    xTaskNotifyGive(lightSET_task_handle);
 }
 
 
 void light_init() {
     printf("light_init:\n");
-    on=false;
-    bri=100;
-    printf("on = false  bri = 100 %%\n");
     pwm_set_freq(1000);
     printf("PWMpwm_set_freq = 1000 Hz  pwm_set_duty = 0 = 0%%\n");
     pwm_set_duty(UINT16_MAX);
     pwm_start();
+    // applies whatever controllers or the button set meanwhile
+    light_ready = true;
     lightSET();
 }
 
@@ -164,34 +178,42 @@ void light_bri_set(homekit_value_t value) {
 }
 
 
+STATIC_TASK(light_identify, 256);
+TaskHandle_t light_identify_task_handle = NULL;
+
 void light_identify_task(void *_args) {
-    //Identify Sonoff by Pulsing LED.
-    for (int j=0; j<3; j++) {
-        for (int j=0; j<2; j++) {
-            for (int i=0; i<=40; i++) {
-                int w;
-                float b;
-                w = (UINT16_MAX - UINT16_MAX*i/20);
-                if(i>20) {
-                    w = (UINT16_MAX - UINT16_MAX*abs(i-40)/20);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!light_ready)
+            continue;
+
+        //Identify Sonoff by Pulsing LED.
+        for (int j=0; j<3; j++) {
+            for (int j=0; j<2; j++) {
+                for (int i=0; i<=40; i++) {
+                    int w;
+                    float b;
+                    w = (UINT16_MAX - UINT16_MAX*i/20);
+                    if(i>20) {
+                        w = (UINT16_MAX - UINT16_MAX*abs(i-40)/20);
+                    }
+                    b = 100.0*(UINT16_MAX-w)/UINT16_MAX;
+                    pwm_set_duty(w);
+                    printf("Light_Identify: i = %2d b = %3.0f w = %5d\n",i, b, UINT16_MAX);
+                    vTaskDelay(20 / portTICK_PERIOD_MS);
                 }
-                b = 100.0*(UINT16_MAX-w)/UINT16_MAX;
-                pwm_set_duty(w);
-                printf("Light_Identify: i = %2d b = %3.0f w = %5d\n",i, b, UINT16_MAX);
-                vTaskDelay(20 / portTICK_PERIOD_MS);
             }
+            vTaskDelay(500 / portTICK_PERIOD_MS);
         }
-    vTaskDelay(500 / portTICK_PERIOD_MS);
+        pwm_set_duty(0);
+        lightSET();
     }
-    pwm_set_duty(0);
-    lightSET();
-    vTaskDelete(NULL);
 }
 
 
 void light_identify(homekit_value_t _value) {
     printf("Light Identify\n");
-    xTaskCreate(light_identify_task, "Light identify", 256, NULL, 2, NULL);
+    xTaskNotifyGive(light_identify_task_handle);
 }
 
 
@@ -280,18 +302,31 @@ void create_accessory_name() {
 }
 
 
+// Tasks are created once and sleep until they are notified
+static void tasks_init() {
+    reset_configuration_task_handle = STATIC_TASK_CREATE(reset_configuration, reset_configuration_task, "Reset configuration", NULL, 2);
+    lightSET_task_handle = STATIC_TASK_CREATE(lightSET, lightSET_task, "Light Set", NULL, 2);
+    light_identify_task_handle = STATIC_TASK_CREATE(light_identify, light_identify_task, "Light identify", NULL, 2);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
+    boot_profile_init();
+    tasks_init();
     create_accessory_name();
+    boot_profile_mark("name");
 
 /*
     wifi_init();                                                   //testing
     homekit_server_init(&config);                                  //testing
  */
     wifi_config_init("Sonoff Dimmer", NULL, on_wifi_ready);        //release
-    
+    boot_profile_mark("wifi init");
+
     gpio_init();
-    light_init();
+    // PWM is set up while WiFi associates
+    boot_profile_async("light", light_init, 512);
+    boot_profile_watch_wifi();
 
     if (button_create(button_gpio, 0, 4000, button_callback)) {
         printf("Failed to initialize button\n");
@@ -1,4 +1,5 @@
 #include <string.h>
+#include <esp8266.h>
 #include <esplibs/libmain.h>
 #include "toggle.h"
 
@@ -17,8 +18,23 @@ typedef struct _toggle {
 
 toggle_t *toggles = NULL;
 
+// Toggles are allocated from a fixed pool instead of the heap
+#ifndef TOGGLE_MAX_COUNT
+#define TOGGLE_MAX_COUNT 2
+#endif
 
-static toggle_t *toggle_find_by_gpio(const uint8_t gpio_num) {
+static toggle_t toggle_pool[TOGGLE_MAX_COUNT];
+
+static toggle_t *toggle_alloc() {
+    for (int i = 0; i < TOGGLE_MAX_COUNT; i++) {
+        if (!toggle_pool[i].callback)
+            return &toggle_pool[i];
+    }
+    return NULL;
+}
+
+
+static IRAM toggle_t *toggle_find_by_gpio(const uint8_t gpio_num) {
     toggle_t *toggle = toggles;
     while (toggle && toggle->gpio_num != gpio_num)
         toggle = toggle->next;
@@ -30,7 +46,7 @@ static toggle_t *toggle_find_by_gpio(const uint8_t gpio_num) {
 
 
 
-void toggle_intr_callback(uint8_t gpio) {
+IRAM void toggle_intr_callback(uint8_t gpio) {
     toggle_t *toggle = toggle_find_by_gpio(gpio);
     if (!toggle)
         return;
@@ -57,7 +73,10 @@ int toggle_create(const uint8_t gpio_num, toggle_callback_fn callback) {
     if (toggle)
         return -1;
 
-    toggle = malloc(sizeof(toggle_t));
+    toggle = toggle_alloc();
+    if (!toggle)
+        return -1;
+
     memset(toggle, 0, sizeof(*toggle));
     toggle->gpio_num = gpio_num;
     toggle->callback = callback;
@@ -97,11 +116,13 @@ void toggle_delete(const uint8_t gpio_num) {
                 b->next = b->next->next;
                 break;
             }
+            b = b->next;
         }
     }
 
     if (toggle) {
         gpio_set_interrupt(gpio_num, GPIO_INTTYPE_EDGE_ANY, NULL);
+        memset(toggle, 0, sizeof(*toggle));
     }
 }
 
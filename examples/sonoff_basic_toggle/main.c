@@ -35,6 +35,7 @@
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
+#include <static_alloc/static_alloc.h>
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
@@ -69,28 +70,34 @@ void led_write(bool on) {
     gpio_write(led_gpio, on ? 0 : 1);
 }
 
-void reset_configuration_task() {
-    //Flash the LED first before we start the reset
-    for (int i=0; i<3; i++) {
-        led_write(true);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-        led_write(false);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+STATIC_TASK(reset_configuration, 256);
+TaskHandle_t reset_configuration_task_handle = NULL;
+
+void reset_configuration_task(void *_args) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        //Flash the LED first before we start the reset
+        for (int i=0; i<3; i++) {
+            led_write(true);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            led_write(false);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+        }
+        printf("Resetting Wifi Config\n");
+        wifi_config_reset();
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        printf("Resetting HomeKit Config\n");
+        homekit_server_reset();
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        printf("Restarting\n");
+        sdk_system_restart();
     }
-    printf("Resetting Wifi Config\n");
-    wifi_config_reset();
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-    printf("Resetting HomeKit Config\n");
-    homekit_server_reset();
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-    printf("Restarting\n");
-    sdk_system_restart();
-    vTaskDelete(NULL);
 }
 
 void reset_configuration() {
     printf("Resetting Sonoff configuration\n");
-    xTaskCreate(reset_configuration_task, "Reset configuration", 256, NULL, 2, NULL);
+    xTaskNotifyGive(reset_configuration_task_handle);
 }
 
 homekit_characteristic_t switch_on = HOMEKIT_CHARACTERISTIC_(
@@ -138,24 +145,30 @@ void toggle_callback(uint8_t gpio) {
 //
 
 
+STATIC_TASK(switch_identify, 128);
+TaskHandle_t switch_identify_task_handle = NULL;
+
 void switch_identify_task(void *_args) {
-    // We identify the Sonoff by Flashing it's LED.
-    for (int i=0; i<3; i++) {
-        for (int j=0; j<2; j++) {
-            led_write(true);
-            vTaskDelay(200 / portTICK_PERIOD_MS);
-            led_write(false);
-            vTaskDelay(200 / portTICK_PERIOD_MS);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // We identify the Sonoff by Flashing it's LED.
+        for (int i=0; i<3; i++) {
+            for (int j=0; j<2; j++) {
+                led_write(true);
+                vTaskDelay(200 / portTICK_PERIOD_MS);
+                led_write(false);
+                vTaskDelay(200 / portTICK_PERIOD_MS);
+            }
+            vTaskDelay(500 / portTICK_PERIOD_MS);
         }
-        vTaskDelay(500 / portTICK_PERIOD_MS);
+        led_write(false);
     }
-    led_write(false);
-    vTaskDelete(NULL);
 }
 
 void switch_identify(homekit_value_t _value) {
     printf("Switch identify\n");
-    xTaskCreate(switch_identify_task, "Switch identify", 128, NULL, 2, NULL);
+    xTaskNotifyGive(switch_identify_task_handle);
 }
 
 homekit_characteristic_t name = HOMEKIT_CHARACTERISTIC_(NAME, "Sonoff Switch");
@@ -205,8 +218,15 @@ void create_accessory_name() {
 }
 
 
+// Tasks are created once and sleep until they are notified
+static void tasks_init() {
+    reset_configuration_task_handle = STATIC_TASK_CREATE(reset_configuration, reset_configuration_task, "Reset configuration", NULL, 2);
+    switch_identify_task_handle = STATIC_TASK_CREATE(switch_identify, switch_identify_task, "Switch identify", NULL, 2);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
+    tasks_init();
     create_accessory_name();
     wifi_config_init("Sonoff Basic", NULL, on_wifi_ready);
     gpio_init();
@@ -1,5 +1,6 @@
 #include <string.h>
 #include <esplibs/libmain.h>
+#include <static_alloc/static_alloc.h>
 #include "toggle.h"
 
 #define LPF_SHIFT 3  // divide by 8
@@ -22,6 +23,23 @@ typedef struct _toggle {
 toggle_t *toggles = NULL;
 TaskHandle_t task_handle = NULL;
 
+STATIC_TASK(toggle_service, 255);
+
+// Toggles are allocated from a fixed pool instead of the heap
+#ifndef TOGGLE_MAX_COUNT
+#define TOGGLE_MAX_COUNT 2
+#endif
+
+static toggle_t toggle_pool[TOGGLE_MAX_COUNT];
+
+static toggle_t *toggle_alloc() {
+    for (int i = 0; i < TOGGLE_MAX_COUNT; i++) {
+        if (!toggle_pool[i].callback)
+            return &toggle_pool[i];
+    }
+    return NULL;
+}
+
 static toggle_t *toggle_find_by_gpio(const uint8_t gpio_num) {
     toggle_t *toggle = toggles;
     while (toggle && toggle->gpio_num != gpio_num)
@@ -56,18 +74,19 @@ void toggleService(void *_args) {
 
 int toggle_create(const uint8_t gpio_num, toggle_callback_fn callback) {
     if (task_handle == NULL) {
-        BaseType_t created = xTaskCreate(toggleService, "toggleService", 255, NULL, 2, &task_handle);
-        if (created != pdPASS) {
-            task_handle = NULL;   
+        task_handle = STATIC_TASK_CREATE(toggle_service, toggleService, "toggleService", NULL, 2);
+        if (!task_handle)
             return -1;
-        }
     }
     
     toggle_t *toggle = toggle_find_by_gpio(gpio_num);
     if (toggle)
         return -1;
 
-    toggle = malloc(sizeof(toggle_t));
+    toggle = toggle_alloc();
+    if (!toggle)
+        return -1;
+
     memset(toggle, 0, sizeof(*toggle));
     toggle->gpio_num = gpio_num;
     toggle->callback = callback;
@@ -90,15 +109,23 @@ void toggle_delete(const uint8_t gpio_num) {
     if (!toggles)
         return;
 
+    toggle_t *toggle = NULL;
     if (toggles->gpio_num == gpio_num) {
+        toggle = toggles;
         toggles = toggles->next;
     } else {
         toggle_t *b = toggles;
         while (b->next) {
             if (b->next->gpio_num == gpio_num) {
+                toggle = b->next;
                 b->next = b->next->next;
                 break;
             }
+            b = b->next;
         }
     }
+
+    if (toggle) {
+        memset(toggle, 0, sizeof(*toggle));
+    }
 }
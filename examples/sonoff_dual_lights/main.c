@@ -25,9 +25,13 @@
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
+#include <static_alloc/static_alloc.h>
+#include <journal/journal.h>
+#include <relay/relay.h>
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <wifi_fast/wifi_fast.h>
 // #include <wifi_config.h>
 
 #include "toggle.h"
@@ -35,14 +39,7 @@
 
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 // The GPIO pin that is connected to the relay on the Sonoff Dual R2
@@ -52,47 +49,65 @@ const int relay1_gpio = 5;
 const int led_gpio = 13;
 // The GPIO pin that is oconnected to the button on the Sonoff Dual R2
 const int button_gpio = 9;
+// The Sonoff Dual R2 has no zero-cross detector. On boards that have one,
+// set its GPIO and the relays' operate time in microseconds.
+#define ZERO_CROSS_GPIO RELAY_NO_ZERO_CROSS
+#define RELAY_LEAD_US 0
 
+// Relay numbers given by the scheduler
+int relay0 = -1;
+int relay1 = -1;
 
+// Journal key of the lamp state
+#define JOURNAL_LAMP_STATE 0
+
+
+// Both relays switching at once would double the inrush current,
+// so the scheduler staggers them
 void relay_write(int relay, bool on) {
-    gpio_write(relay, on ? 1 : 0);
+    relay_set(relay, on);
 }
 
 void led_write(bool on) {
     gpio_write(led_gpio, on ? 0 : 1);
 }
 
-void reset_configuration_task() {
-    //Flash the LED first before we start the reset
-    for (int i=0; i<3; i++) {
-        led_write(true);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-        led_write(false);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-    }
+STATIC_TASK(reset_configuration, 256);
+TaskHandle_t reset_configuration_task_handle = NULL;
 
-    // printf("Resetting Wifi Config\n");
+void reset_configuration_task(void *_args) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-    // wifi_config_reset();
+        //Flash the LED first before we start the reset
+        for (int i=0; i<3; i++) {
+            led_write(true);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            led_write(false);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+        }
+
+        // printf("Resetting Wifi Config\n");
 
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+        // wifi_config_reset();
 
-    printf("Resetting HomeKit Config\n");
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
 
-    homekit_server_reset();
+        printf("Resetting HomeKit Config\n");
 
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+        homekit_server_reset();
 
-    printf("Restarting\n");
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
 
-    sdk_system_restart();
+        printf("Restarting\n");
 
-    vTaskDelete(NULL);
+        sdk_system_restart();
+    }
 }
 
 void reset_configuration() {
     printf("Resetting Sonoff configuration\n");
-    xTaskCreate(reset_configuration_task, "Reset configuration", 256, NULL, 2, NULL);
+    xTaskNotifyGive(reset_configuration_task_handle);
 }
 
 
@@ -114,14 +129,15 @@ homekit_characteristic_t bottom_light_on = HOMEKIT_CHARACTERISTIC_(
 
 void lamp_state_set(int state) {
     lamp_state = state % 4;
+    journal_set(JOURNAL_LAMP_STATE, &lamp_state, sizeof(lamp_state));
     bool top_on = (state & 1) != 0;
     bool bottom_on = (state & 2) != 0;
 
     printf("Setting state %d, top = %s, bottom = %s\n",
            lamp_state, (top_on ? "on" : "off"), (bottom_on ? "on" : "off"));
 
-    relay_write(relay0_gpio, top_on);
-    relay_write(relay1_gpio, bottom_on);
+    relay_write(relay0, top_on);
+    relay_write(relay1, bottom_on);
 
     if (top_on != top_light_on.value.bool_value) {
         top_light_on.value = HOMEKIT_BOOL(top_on);
@@ -156,40 +172,44 @@ void gpio_init() {
     gpio_enable(led_gpio, GPIO_OUTPUT);
     led_write(false);
 
-    gpio_enable(relay0_gpio, GPIO_OUTPUT);
-    gpio_enable(relay1_gpio, GPIO_OUTPUT);
-    relay_write(relay0_gpio, true);
-    relay_write(relay1_gpio, true);
+    relay_init(ZERO_CROSS_GPIO, RELAY_LEAD_US);
+    relay0 = relay_create(relay0_gpio, true);
+    relay1 = relay_create(relay1_gpio, true);
 }
 
 void toggle_callback(uint8_t gpio) {
     lamp_state_set(lamp_state+1);
 }
 
-void lamp_identify_task(void *_args) {
-    // We identify the Sonoff by turning top light on
-    // and flashing with bottom light
-    relay_write(relay0_gpio, true);
+STATIC_TASK(lamp_identify, 128);
+TaskHandle_t lamp_identify_task_handle = NULL;
 
-    for (int i=0; i<3; i++) {
-        for (int j=0; j<2; j++) {
-            relay_write(relay1_gpio, true);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            relay_write(relay1_gpio, false);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+void lamp_identify_task(void *_args) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // We identify the Sonoff by turning top light on
+        // and flashing with bottom light
+        relay_write(relay0, true);
+
+        for (int i=0; i<3; i++) {
+            for (int j=0; j<2; j++) {
+                relay_write(relay1, true);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+                relay_write(relay1, false);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+            }
+
+            vTaskDelay(250 / portTICK_PERIOD_MS);
         }
 
-        vTaskDelay(250 / portTICK_PERIOD_MS);
+        relay_write(relay1, true);
     }
-
-    relay_write(relay1_gpio, true);
-
-    vTaskDelete(NULL);
 }
 
 void lamp_identify(homekit_value_t _value) {
     printf("Lamp identify\n");
-    xTaskCreate(lamp_identify_task, "Lamp identify", 128, NULL, 2, NULL);
+    xTaskNotifyGive(lamp_identify_task_handle);
 }
 
 homekit_characteristic_t name = HOMEKIT_CHARACTERISTIC_(NAME, "Dual Lamp");
@@ -242,13 +262,26 @@ void create_accessory_name() {
     name.value = HOMEKIT_STRING(name_value);
 }
 
+// Tasks are created once and sleep until they are notified
+static void tasks_init() {
+    reset_configuration_task_handle = STATIC_TASK_CREATE(reset_configuration, reset_configuration_task, "Reset configuration", NULL, 2);
+    lamp_identify_task_handle = STATIC_TASK_CREATE(lamp_identify, lamp_identify_task, "Lamp identify", NULL, 2);
+}
+
 void user_init(void) {
     uart_set_baud(0, 115200);
+    tasks_init();
 
     create_accessory_name();
 
     gpio_init();
 
+    // Lights come back in the state they had before reboot
+    journal_init();
+    int state = lamp_state;
+    journal_get(JOURNAL_LAMP_STATE, &state, sizeof(state));
+    lamp_state_set(state);
+
     // wifi_config_init("dual lamp", NULL, on_wifi_ready);
     wifi_init();
     on_wifi_ready();
@@ -8,6 +8,8 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <static_alloc/static_alloc.h>
+#include <wifi_fast/wifi_fast.h>
 #include "wifi.h"
 
 #include <dht/dht.h>
@@ -19,14 +21,7 @@
 
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 
@@ -38,6 +33,8 @@ homekit_characteristic_t temperature = HOMEKIT_CHARACTERISTIC_(CURRENT_TEMPERATU
 homekit_characteristic_t humidity    = HOMEKIT_CHARACTERISTIC_(CURRENT_RELATIVE_HUMIDITY, 0);
 
 
+STATIC_TASK(temperature_sensor, 256);
+
 void temperature_sensor_task(void *_args) {
     gpio_set_pullup(SENSOR_PIN, false, false);
 
@@ -62,7 +59,7 @@ void temperature_sensor_task(void *_args) {
 }
 
 void temperature_sensor_init() {
-    xTaskCreate(temperature_sensor_task, "Temperatore Sensor", 256, NULL, 2, NULL);
+    STATIC_TASK_CREATE(temperature_sensor, temperature_sensor_task, "Temperatore Sensor", NULL, 2);
 }
 
 
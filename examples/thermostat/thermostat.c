@@ -33,6 +33,11 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <static_alloc/static_alloc.h>
+#include <wifi_fast/wifi_fast.h>
+#include <telemetry/telemetry.h>
+#include <journal/journal.h>
+#include <logger/logger.h>
 #include "wifi.h"
 
 #include <dht/dht.h>
@@ -47,21 +52,20 @@
 #define HEATER_FAN_DELAY 30000
 #define COOLER_FAN_DELAY 0
 
+// Journal keys of the settings
+#define JOURNAL_TARGET_TEMPERATURE 0
+#define JOURNAL_TARGET_STATE 1
+#define JOURNAL_COOLING_THRESHOLD 2
+#define JOURNAL_HEATING_THRESHOLD 3
+
 
 static void wifi_init() {
-    struct sdk_station_config wifi_config = {
-        .ssid = WIFI_SSID,
-        .password = WIFI_PASSWORD,
-    };
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&wifi_config);
-    sdk_wifi_station_connect();
+    wifi_fast_connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 
 void thermostat_identify(homekit_value_t _value) {
-    printf("Thermostat identify\n");
+    LOG_INFO("Thermostat identify");
 }
 
 
@@ -110,10 +114,12 @@ void fanOff() {
 
 
 void update_state();
+void save_settings();
 
 
 void on_update(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
     update_state();
+    save_settings();
 }
 
 
@@ -174,6 +180,23 @@ void update_state() {
 }
 
 
+void save_settings() {
+    journal_save(JOURNAL_TARGET_TEMPERATURE, &target_temperature);
+    journal_save(JOURNAL_TARGET_STATE, &target_state);
+    journal_save(JOURNAL_COOLING_THRESHOLD, &cooling_threshold);
+    journal_save(JOURNAL_HEATING_THRESHOLD, &heating_threshold);
+}
+
+void restore_settings() {
+    journal_restore(JOURNAL_TARGET_TEMPERATURE, &target_temperature);
+    journal_restore(JOURNAL_TARGET_STATE, &target_state);
+    journal_restore(JOURNAL_COOLING_THRESHOLD, &cooling_threshold);
+    journal_restore(JOURNAL_HEATING_THRESHOLD, &heating_threshold);
+}
+
+
+STATIC_TASK(temperature_sensor, 256);
+
 void temperature_sensor_task(void *_args) {
     sdk_os_timer_setfn(&fan_timer, fan_alarm, NULL);
 
@@ -194,7 +217,10 @@ void temperature_sensor_task(void *_args) {
             &humidity_value, &temperature_value
         );
         if (success) {
-            printf("Got readings: temperature %g, humidity %g\n", temperature_value, humidity_value);
+            // the logger stores integers, readings are logged in tenths
+            // of a degree and of a percent
+            LOG_INFO("Got readings: temperature %d/10 C, humidity %d/10 %%",
+                     (int32_t)(temperature_value * 10), (int32_t)(humidity_value * 10));
             current_temperature.value = HOMEKIT_FLOAT(temperature_value);
             current_humidity.value = HOMEKIT_FLOAT(humidity_value);
 
@@ -203,7 +229,7 @@ void temperature_sensor_task(void *_args) {
 
             update_state();
         } else {
-            printf("Couldnt read data from sensor\n");
+            LOG_WARNING("Couldnt read data from sensor");
         }
 
         vTaskDelay(TEMPERATURE_POLL_PERIOD / portTICK_PERIOD_MS);
@@ -211,7 +237,7 @@ void temperature_sensor_task(void *_args) {
 }
 
 void thermostat_init() {
-    xTaskCreate(temperature_sensor_task, "Thermostat", 256, NULL, 2, NULL);
+    STATIC_TASK_CREATE(temperature_sensor, temperature_sensor_task, "Thermostat", NULL, 2);
 }
 
 
@@ -224,6 +250,7 @@ homekit_accessory_t *accessories[] = {
             HOMEKIT_CHARACTERISTIC(MODEL, "MyThermostat"),
             HOMEKIT_CHARACTERISTIC(FIRMWARE_REVISION, "0.1"),
             HOMEKIT_CHARACTERISTIC(IDENTIFY, thermostat_identify),
+            HOMEKIT_CHARACTERISTIC(CUSTOM_TELEMETRY),
             NULL
         }),
         HOMEKIT_SERVICE(THERMOSTAT, .primary=true, .characteristics=(homekit_characteristic_t*[]) {
@@ -251,6 +278,10 @@ homekit_server_config_t config = {
 void user_init(void) {
     uart_set_baud(0, 115200);
 
+    logger_init(LOGGER_SINK_UART0);
+    telemetry_init();
+    journal_init();
+    restore_settings();
     wifi_init();
     thermostat_init();
     homekit_server_init(&config);
@@ -21,6 +21,7 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <static_alloc/static_alloc.h>
 #include <wifi_config.h>
 
 
@@ -46,26 +47,31 @@ void led_on_callback(homekit_characteristic_t *_ch, homekit_value_t on, void *co
     led_write(led_on.value.bool_value);
 }
 
+STATIC_TASK(led_identify, 128);
+TaskHandle_t led_identify_task_handle = NULL;
+
 void led_identify_task(void *_args) {
-    for (int i=0; i<3; i++) {
-        for (int j=0; j<2; j++) {
-            led_write(true);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            led_write(false);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (int i=0; i<3; i++) {
+            for (int j=0; j<2; j++) {
+                led_write(true);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+                led_write(false);
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+            }
+
+            vTaskDelay(250 / portTICK_PERIOD_MS);
         }
 
-        vTaskDelay(250 / portTICK_PERIOD_MS);
+        led_write(led_on.value.bool_value);
     }
-
-    led_write(led_on.value.bool_value);
-
-    vTaskDelete(NULL);
 }
 
 void led_identify(homekit_value_t _value) {
     printf("LED identify\n");
-    xTaskCreate(led_identify_task, "LED identify", 128, NULL, 2, NULL);
+    xTaskNotifyGive(led_identify_task_handle);
 }
 
 
@@ -101,6 +107,7 @@ void on_wifi_ready() {
 
 void user_init(void) {
     uart_set_baud(0, 115200);
+    led_identify_task_handle = STATIC_TASK_CREATE(led_identify, led_identify_task, "LED identify", NULL, 2);
 
     wifi_config_init("my-accessory", NULL, on_wifi_ready);
     led_init();
@@ -0,0 +1,280 @@
+/*
+ * Runs char_cache.c with a scripted controller in simulated time.
+ * Requests write characteristics at a given rate, the hardware side
+ * changes a value that is sent to a given number of subscribed
+ * controllers. Prints p50/p99 of write to hardware latency and the
+ * throughput of writes, commits and notifications.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include "../components/char_cache/char_cache.c"
+
+#include "test.h"
+
+// Simulated costs, in microseconds
+#define WRITE_US 200            // server handling one characteristic write
+#define COMMIT_US 500           // updating the hardware
+#define SEND_US 400             // one notification to one controller
+
+#define RUN_US 20000000
+
+// Nothing is sent this long before the end, so every write is committed
+#define SETTLE_US 100000
+
+#define MAX_SAMPLES 100000
+
+
+typedef struct {
+    const char *name;
+    uint32_t request_us;        // a request every, 0 for none
+    uint8_t batch;              // characteristics written by a request
+    uint32_t update_us;         // a hardware side change every, 0 for none
+    uint8_t fan_out;            // controllers subscribed to it
+} load_t;
+
+static load_t load;
+
+
+// Simulated time in microseconds, handlers of events move it on by
+// their cost
+static uint64_t now_us;
+static uint64_t end_us;
+static jmp_buf task_exit;
+
+uint32_t sdk_system_get_time() {
+    return now_us;
+}
+
+static uint32_t random_state = 1;
+
+static uint32_t random_below(uint32_t limit) {
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 8) % (limit + 1);
+}
+
+
+static void light_commit(char_cache_t *cache);
+
+static char_cache_t light_cache;
+static homekit_characteristic_t light[3];     // hue, saturation, brightness
+static homekit_characteristic_t power;        // changed by a button
+
+static uint32_t requests;
+static uint32_t updates;
+static uint32_t sent;                         // notifications to controllers
+
+// Write to hardware latency of every write
+static uint64_t written_at[3];
+static bool pending[3];
+static uint32_t samples[MAX_SAMPLES];
+static uint32_t sample_count;
+
+// The library calls the change callbacks of notified characteristics
+void homekit_characteristic_notify(homekit_characteristic_t *ch, homekit_value_t value) {
+    now_us += (uint64_t)load.fan_out * SEND_US;
+    sent += load.fan_out;
+    char_cache_changed(ch, value, &light_cache);
+}
+
+static void request() {
+    requests++;
+    for (int i = 0; i < load.batch; i++) {
+        now_us += WRITE_US;
+        if (!pending[i]) {
+            pending[i] = true;
+            written_at[i] = now_us;
+        }
+        light[i].value = HOMEKIT_FLOAT(requests);
+        char_cache_changed(&light[i], light[i].value, &light_cache);
+    }
+}
+
+static void update() {
+    updates++;
+    char_cache_update(&light_cache, &power, HOMEKIT_BOOL(updates & 1));
+}
+
+
+// Runs requests and updates due up to until, or until the commit task
+// is notified
+static uint64_t next_request;
+static uint64_t next_update;
+static uint32_t notifications;
+
+static uint64_t next_after(uint32_t interval) {
+    // a quarter of the interval early or late
+    return now_us + interval - interval / 4 + random_below(interval / 2);
+}
+
+static void run_until(uint64_t until, bool wake) {
+    while (!(wake && notifications)) {
+        uint64_t next = until;
+        if (load.request_us && next_request < next && next_request < end_us - SETTLE_US)
+            next = next_request;
+        if (load.update_us && next_update < next && next_update < end_us - SETTLE_US)
+            next = next_update;
+
+        if (next > now_us)
+            now_us = next < end_us ? next : end_us;
+        if (now_us >= end_us)
+            longjmp(task_exit, 1);
+        if (next == until)
+            return;
+
+        if (next == next_request) {
+            next_request = next_after(load.request_us);
+            request();
+        } else {
+            next_update = next_after(load.update_us);
+            update();
+        }
+    }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    notifications++;
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    uint64_t until = (ticks == portMAX_DELAY) ? UINT64_MAX :
+                     now_us + (uint64_t)ticks * portTICK_PERIOD_MS * 1000;
+    run_until(until, true);
+
+    uint32_t value = notifications;
+    notifications = clear_on_exit ? 0 : (value ? value - 1 : 0);
+    return value;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    run_until(now_us + (uint64_t)ticks * portTICK_PERIOD_MS * 1000, false);
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                               void *params, UBaseType_t priority,
+                               StackType_t *stack, StaticTask_t *task_buffer) {
+    return task_buffer;
+}
+
+// Requests keep coming while the hardware is updated
+static void light_commit(char_cache_t *cache) {
+    uint64_t written[3];
+    bool committed[3];
+    for (int i = 0; i < 3; i++) {
+        committed[i] = char_cache_dirty(cache, &light[i]);
+        if (committed[i]) {
+            written[i] = written_at[i];
+            pending[i] = false;
+        }
+    }
+
+    run_until(now_us + COMMIT_US, false);
+
+    for (int i = 0; i < 3; i++) {
+        if (committed[i] && sample_count < MAX_SAMPLES)
+            samples[sample_count++] = now_us - written[i];
+    }
+}
+
+
+static int by_value(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(uint8_t percent) {
+    if (!sample_count)
+        return 0;
+    return samples[(sample_count - 1) * percent / 100];
+}
+
+static double per_second(uint32_t count) {
+    return count * 1000000.0 / RUN_US;
+}
+
+static void run(load_t scenario) {
+    load = scenario;
+    now_us = 0;
+    end_us = RUN_US;
+    next_request = load.request_us;
+    next_update = load.update_us;
+    notifications = 0;
+    requests = updates = sent = 0;
+    sample_count = 0;
+    memset(pending, 0, sizeof(pending));
+
+    caches = NULL;
+    light_cache = (char_cache_t) CHAR_CACHE_(light_commit);
+    char_cache_init();
+
+    if (!setjmp(task_exit))
+        char_cache_commit_task(NULL);
+
+    qsort(samples, sample_count, sizeof(samples[0]), by_value);
+    printf("    %s: %u writes every %u ms", load.name, load.batch, load.request_us / 1000);
+    if (load.update_us)
+        printf(", an update to %u controllers every %u ms", load.fan_out, load.update_us / 1000);
+    printf("\n");
+    printf("        write to hardware p50 %u us, p99 %u us, max %u us\n",
+           percentile(50), percentile(99), sample_count ? samples[sample_count - 1] : 0);
+    printf("        notify time p50 %u us, p99 %u us\n",
+           char_cache_percentile(&light_cache.notify_time, 50),
+           char_cache_percentile(&light_cache.notify_time, 99));
+    printf("        %.1f writes/s, %.1f commits/s, %.1f notifies/s, %.1f notifications/s\n",
+           per_second(light_cache.writes), per_second(light_cache.commits),
+           per_second(light_cache.notifies), per_second(sent));
+}
+
+
+static void test_one_commit_per_request() {
+    run((load_t) { "phone", 1000000, 3, 0, 0 });
+
+    // hue, saturation and brightness end up in one hardware update
+    CHECK(light_cache.writes == requests * 3);
+    CHECK(light_cache.commits == requests);
+    CHECK(sample_count == requests * 3);
+
+    // the commit delay, a tick of slack and the update itself
+    CHECK(percentile(99) <= CHAR_CACHE_COMMIT_DELAY_MS * 1000 + 10000 + COMMIT_US + 2 * WRITE_US);
+}
+
+static void test_slider_drag() {
+    run((load_t) { "slider drag", 50000, 1, 0, 0 });
+    CHECK(light_cache.commits == requests);
+
+    // writes faster than the commit delay are coalesced
+    run((load_t) { "fast slider drag", 10000, 1, 0, 0 });
+    CHECK(light_cache.writes == requests);
+    CHECK(light_cache.commits < requests / 2);
+    CHECK(percentile(99) <= 2 * (CHAR_CACHE_COMMIT_DELAY_MS * 1000 + 10000 + COMMIT_US));
+}
+
+static void test_fan_out() {
+    run((load_t) { "button, 4 controllers", 1000000, 3, 200000, 4 });
+
+    // updates are sent, not committed back to hardware
+    CHECK(light_cache.notifies == updates);
+    CHECK(sent == updates * 4);
+    CHECK(light_cache.writes == requests * 3);
+    CHECK(light_cache.commits == requests);
+    CHECK(char_cache_percentile(&light_cache.notify_time, 99) >= 4 * SEND_US);
+
+    run((load_t) { "busy, 8 controllers", 20000, 3, 50000, 8 });
+    CHECK(light_cache.notifies == updates);
+    CHECK(light_cache.writes == requests * 3);
+    CHECK(light_cache.commits <= requests);
+
+    char_cache_stats_dump();
+}
+
+
+int main() {
+    RUN(test_one_commit_per_request);
+    RUN(test_slider_drag);
+    RUN(test_fan_out);
+
+    return test_result();
+}
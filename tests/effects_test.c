@@ -0,0 +1,246 @@
+/*
+ * Renders every effect of led_strip_animation on the host and ranks
+ * them by time per step, next to the estimates the renderer starts
+ * with. The bench calls the effects directly, without fx_render()
+ * timing each call and without the compositor. Also checks effects stay in their segment and that effects
+ * without state draw the same picture for the same step.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../examples/led_strip_animation/effects.c"
+
+#include "test.h"
+
+#define LED_COUNT 100
+#define STEPS 200000
+#define RUNS 5                  // the fastest run is kept
+
+// Pixels around the segment that no effect may touch
+#define GUARD 8
+#define GUARD_COLOR 0x5A5A5A
+
+
+static ws2812_pixel_t pixels[GUARD + LED_COUNT + GUARD];
+
+// The bench stores pixels as they are, blending costs the same for
+// every effect
+static bool blend = true;
+
+// segments.c without the renderer
+void segment_set_pixel(led_segment_t *segment, uint16_t index, ws2812_pixel_t color) {
+    if (index >= segment->count)
+        return;
+
+    if (segment->reverse)
+        index = segment->count - index - 1;
+
+    if (!blend) {
+        pixels[segment->start + index] = color;
+        return;
+    }
+    compositor_blend(&pixels[segment->start + index], color, &segment->layers[segment->layer]);
+}
+
+void segment_fill(led_segment_t *segment, ws2812_pixel_t color) {
+    for (int i = 0; i < segment->count; i++) {
+        segment_set_pixel(segment, i, color);
+    }
+}
+
+uint32_t sdk_system_get_time() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static uint32_t random_state = 1;
+
+uint32_t hwrand() {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 8;
+}
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+
+static uint8_t state[LED_COUNT];
+
+static led_segment_t segment_for(uint8_t mode, bool reverse) {
+    led_segment_t segment = {
+        .start = GUARD,
+        .count = LED_COUNT,
+        .on = true,
+        .color = { .color = 0xFF8020 },
+        .mode = mode,
+        .speed = 128,
+        .reverse = reverse,
+        .layer = LAYER_EFFECT,
+        .state = fx_get(mode)->state_size ? state : NULL,
+        .state_size = fx_get(mode)->state_size * LED_COUNT,
+    };
+    segment.layers[LAYER_EFFECT] = (layer_t) { true, BLEND_OVER, ALPHA_OPAQUE, 255 };
+    memset(state, 0, sizeof(state));
+    return segment;
+}
+
+static void clear_pixels() {
+    for (int i = 0; i < sizeof(pixels) / sizeof(pixels[0]); i++) {
+        pixels[i].color = GUARD_COLOR;
+    }
+}
+
+static bool guards_untouched() {
+    for (int i = 0; i < GUARD; i++) {
+        if (pixels[i].color != GUARD_COLOR || pixels[GUARD + LED_COUNT + i].color != GUARD_COLOR)
+            return false;
+    }
+    return true;
+}
+
+
+static void test_effects_stay_in_segment() {
+    for (uint8_t mode = 0; mode < fx_count(); mode++) {
+        for (int reverse = 0; reverse < 2; reverse++) {
+            led_segment_t segment = segment_for(mode, reverse);
+            clear_pixels();
+
+            for (int step = 0; step < LED_COUNT * 3; step++) {
+                fx_advance(&segment, step * 10);
+                fx_render(&segment);
+            }
+
+            if (!guards_untouched())
+                printf("    %s draws outside of its segment\n", fx_get(mode)->name);
+            CHECK(guards_untouched());
+        }
+    }
+}
+
+static void test_same_step_same_picture() {
+    static ws2812_pixel_t first[sizeof(pixels) / sizeof(pixels[0])];
+
+    for (uint8_t mode = 0; mode < fx_count(); mode++) {
+        if (fx_get(mode)->update)
+            continue;
+
+        led_segment_t segment = segment_for(mode, false);
+        for (uint32_t step = 0; step < 600; step += 7) {
+            segment.step = step;
+            clear_pixels();
+            fx_render(&segment);
+            memcpy(first, pixels, sizeof(pixels));
+
+            // another step in between does not change it
+            segment.step = step + 1;
+            fx_render(&segment);
+            segment.step = step;
+            clear_pixels();
+            fx_render(&segment);
+
+            CHECK(!memcmp(first, pixels, sizeof(pixels)));
+        }
+    }
+}
+
+static void test_stats_count_steps() {
+    for (uint8_t mode = 0; mode < fx_count(); mode++) {
+        uint32_t before = fx_stats(mode)->steps;
+        led_segment_t segment = segment_for(mode, false);
+        for (int i = 0; i < 10; i++) {
+            fx_advance(&segment, i * 10);
+            fx_render(&segment);
+        }
+        CHECK(fx_stats(mode)->steps == before + 10);
+    }
+}
+
+static void test_hue_covers_all_modes() {
+    CHECK(fx_mode_from_hue(0) == 0);
+    CHECK(fx_mode_from_hue(Q16(360)) == fx_count() - 1);
+
+    uint8_t last = 0;
+    for (int hue = 0; hue <= 360; hue++) {
+        uint8_t mode = fx_mode_from_hue(Q16(hue));
+        CHECK(mode == last || mode == last + 1);
+        last = mode;
+    }
+    CHECK(last == fx_count() - 1);
+}
+
+
+typedef struct {
+    uint8_t mode;
+    uint32_t ns;                // one step on 100 LEDs
+} ranking_t;
+
+static int by_cost(const void *a, const void *b) {
+    const ranking_t *x = a, *y = b;
+    return (x->ns < y->ns) - (x->ns > y->ns);
+}
+
+// A step is what the renderer does for an effect, update and draw
+static uint64_t bench_run(uint8_t mode) {
+    const fx_effect_t *effect = fx_get(mode);
+    led_segment_t segment = segment_for(mode, false);
+    clear_pixels();
+
+    uint64_t start = now_ns();
+    for (uint32_t step = 0; step < STEPS; step++) {
+        segment.step = step;
+        if (effect->update)
+            effect->update(&segment);
+        effect->render(&segment);
+    }
+    return now_ns() - start;
+}
+
+static void bench() {
+    ranking_t ranking[FX_MAX_EFFECTS];
+    uint8_t count = fx_count();
+
+    blend = false;
+    for (uint8_t mode = 0; mode < count; mode++) {
+        uint64_t fastest = UINT64_MAX;
+        for (int run = 0; run < RUNS; run++) {
+            uint64_t elapsed = bench_run(mode);
+            if (elapsed < fastest)
+                fastest = elapsed;
+        }
+
+        ranking[mode].mode = mode;
+        ranking[mode].ns = fastest * 100 / LED_COUNT / STEPS;
+    }
+    blend = true;
+
+    qsort(ranking, count, sizeof(ranking[0]), by_cost);
+
+    // estimates are ranked too, to see if the order matches
+    printf("    %-16s %12s %14s\n", "effect", "host ns/100", "estimate us");
+    for (int i = 0; i < count; i++) {
+        const fx_effect_t *effect = fx_get(ranking[i].mode);
+        int estimate_rank = 1;
+        for (int j = 0; j < count; j++) {
+            if (fx_get(j)->cost > effect->cost)
+                estimate_rank++;
+        }
+        printf("    %-16s %12u %9u (#%d)\n", effect->name, ranking[i].ns, effect->cost, estimate_rank);
+    }
+}
+
+
+int main() {
+    RUN(test_effects_stay_in_segment);
+    RUN(test_same_step_same_picture);
+    RUN(test_stats_count_steps);
+    RUN(test_hue_covers_all_modes);
+    RUN(bench);
+
+    return test_result();
+}
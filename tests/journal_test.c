@@ -0,0 +1,302 @@
+/*
+ * Runs journal.c against a simulated flash: values survive reboots and
+ * power cuts, failed writes are retried, slider drags are debounced.
+ * Prints how many bytes of flash each change costs.
+ */
+#include <stdio.h>
+#include <setjmp.h>
+
+#define JOURNAL_FLASH_ADDR 0x10000
+
+#include "../components/journal/journal.c"
+
+#include "test.h"
+
+#define FLASH_SIZE (JOURNAL_SECTORS * SECTOR_SIZE)
+
+
+// NOR flash: erasing sets all bits, writing can only clear them
+static uint8_t flash[FLASH_SIZE];
+static uint32_t flash_bytes_written = 0;
+static int flash_writes_left = -1;          // fail writes once it is 0
+
+bool spiflash_read(uint32_t addr, uint8_t *buf, uint32_t size) {
+    addr -= JOURNAL_FLASH_ADDR;
+    if (addr + size > FLASH_SIZE)
+        return false;
+
+    memcpy(buf, flash + addr, size);
+    return true;
+}
+
+bool spiflash_write(uint32_t addr, uint8_t *buf, uint32_t size) {
+    addr -= JOURNAL_FLASH_ADDR;
+    if (addr + size > FLASH_SIZE || flash_writes_left == 0)
+        return false;
+
+    if (flash_writes_left > 0)
+        flash_writes_left--;
+
+    for (uint32_t i = 0; i < size; i++) {
+        flash[addr + i] &= buf[i];
+    }
+    flash_bytes_written += size;
+    return true;
+}
+
+bool spiflash_erase_sector(uint32_t addr) {
+    addr -= JOURNAL_FLASH_ADDR;
+    if (addr % SECTOR_SIZE || addr >= FLASH_SIZE)
+        return false;
+
+    memset(flash + addr, 0xFF, SECTOR_SIZE);
+    return true;
+}
+
+
+// The writer task is run by the test, vTaskDelay() moves time on and
+// plays the scenario of journal_set calls
+static TickType_t ticks = 0;
+static jmp_buf task_exit;
+static void (*scenario)(TickType_t now) = NULL;
+static TickType_t scenario_end = 0;
+
+TickType_t xTaskGetTickCount() {
+    return ticks;
+}
+
+void vTaskDelay(TickType_t delay) {
+    for (TickType_t i = 0; i < delay; i++) {
+        ticks++;
+        if (ticks >= scenario_end)
+            longjmp(task_exit, 1);
+        scenario(ticks);
+    }
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                               void *params, UBaseType_t priority,
+                               StackType_t *stack, StaticTask_t *task_buffer) {
+    return task_buffer;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *mutex_buffer) {
+    return mutex_buffer;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return pdTRUE;
+}
+
+static void run_task(void (*play)(TickType_t now), uint32_t ms) {
+    scenario = play;
+    scenario_end = ticks + ms / portTICK_PERIOD_MS;
+    if (!setjmp(task_exit))
+        journal_task(NULL);
+}
+
+
+// RAM is lost, flash is kept
+static void reboot() {
+    memset(entries, 0, sizeof(entries));
+    memset(&stats, 0, sizeof(stats));
+    pending = false;
+    sector = 0;
+    sequence = 0;
+    next_record = 0;
+
+    journal_init();
+}
+
+static void format() {
+    memset(flash, 0, sizeof(flash));
+    flash_bytes_written = 0;
+    flash_writes_left = -1;
+    reboot();
+    journal_reset();
+}
+
+static int get_int(uint8_t key) {
+    int value = -1;
+    journal_get(key, &value, sizeof(value));
+    return value;
+}
+
+static void set_int(uint8_t key, int value) {
+    journal_set(key, &value, sizeof(value));
+}
+
+
+static void test_survives_reboot() {
+    format();
+    CHECK(get_int(1) == -1);
+
+    set_int(1, 42);
+    set_int(2, 7);
+    journal_flush();
+    reboot();
+
+    CHECK(get_int(1) == 42);
+    CHECK(get_int(2) == 7);
+}
+
+static void test_compaction() {
+    format();
+
+    // fills every sector several times over
+    int rounds = RECORDS_PER_SECTOR * JOURNAL_SECTORS * 3;
+    for (int i = 0; i < rounds; i++) {
+        set_int(i % 3, i);
+        set_int(10, 1000);
+        journal_flush();
+    }
+    uint32_t changes = stats.changes;
+    uint32_t erases = stats.erases;
+    reboot();
+
+    for (int key = 0; key < 3; key++) {
+        int last = rounds - 1 - (rounds - 1 - key) % 3;
+        CHECK(get_int(key) == last);
+    }
+    CHECK(get_int(10) == 1000);
+
+    // every change is one record, plus the sectors erased for them
+    uint32_t written = flash_bytes_written + erases * SECTOR_SIZE;
+    printf("    %u changes, %u bytes written, %u sectors erased\n",
+           changes, flash_bytes_written, erases);
+    printf("    write amplification %.2f (%u byte values)\n",
+           (double)written / (changes * JOURNAL_VALUE_SIZE), JOURNAL_VALUE_SIZE);
+}
+
+static void test_failed_write_is_retried() {
+    format();
+
+    set_int(1, 1);
+    set_int(2, 2);
+    flash_writes_left = 1;
+    journal_flush();
+    CHECK(pending);
+
+    flash_writes_left = -1;
+    journal_flush();
+    CHECK(!pending);
+    reboot();
+
+    CHECK(get_int(1) == 1);
+    CHECK(get_int(2) == 2);
+}
+
+static void test_failed_compaction_is_retried() {
+    format();
+
+    for (int i = 0; i < RECORDS_PER_SECTOR; i++) {
+        set_int(1, i);
+        journal_flush();
+    }
+
+    set_int(2, 2);
+    flash_writes_left = 0;
+    journal_flush();
+    CHECK(pending);
+
+    flash_writes_left = -1;
+    journal_flush();
+    reboot();
+
+    CHECK(get_int(1) == RECORDS_PER_SECTOR - 1);
+    CHECK(get_int(2) == 2);
+}
+
+static void test_power_cut() {
+    format();
+
+    set_int(1, 1);
+    journal_flush();
+    set_int(1, 2);
+    journal_flush();
+
+    // cut the last record in half
+    uint32_t addr = record_addr(next_record - 1) - JOURNAL_FLASH_ADDR;
+    memset(flash + addr + RECORD_SIZE / 2, 0xFF, RECORD_SIZE / 2);
+    reboot();
+
+    CHECK(get_int(1) == 1);
+
+    // new records go after the broken one
+    set_int(1, 3);
+    journal_flush();
+    reboot();
+    CHECK(get_int(1) == 3);
+}
+
+
+static void slider_drag(TickType_t now) {
+    // a value every 100 ms for 5 s
+    if (now * portTICK_PERIOD_MS <= 5000 && now % (100 / portTICK_PERIOD_MS) == 0)
+        set_int(1, now);
+}
+
+static void test_debounce() {
+    format();
+    ticks = 0;
+
+    run_task(slider_drag, 5000 + JOURNAL_DEBOUNCE_MS + 1000);
+    printf("    slider drag: %u changes, %u records\n", stats.changes, stats.records);
+    CHECK(stats.changes == 50);
+    CHECK(stats.records == 1);
+    CHECK(!pending);
+
+    reboot();
+    CHECK(get_int(1) == 5000 / portTICK_PERIOD_MS);
+}
+
+static void keeps_changing(TickType_t now) {
+    if (now % (500 / portTICK_PERIOD_MS) == 0)
+        set_int(1, now);
+}
+
+static void test_max_delay() {
+    format();
+    ticks = 0;
+
+    // never settles, written every JOURNAL_MAX_DELAY_MS
+    run_task(keeps_changing, 3 * JOURNAL_MAX_DELAY_MS + 2000);
+    printf("    constant changes: %u changes, %u records\n", stats.changes, stats.records);
+    CHECK(stats.records == 3);
+}
+
+static void flash_comes_back(TickType_t now) {
+    if (now == 1)
+        set_int(1, 1);
+    if (now * portTICK_PERIOD_MS == JOURNAL_DEBOUNCE_MS + 1000)
+        flash_writes_left = -1;
+}
+
+static void test_retry() {
+    format();
+    ticks = 0;
+
+    // flash comes back after the first attempt failed
+    flash_writes_left = 0;
+    run_task(flash_comes_back, 3 * JOURNAL_DEBOUNCE_MS + 1000);
+    CHECK(stats.records == 1);
+    CHECK(!pending);
+}
+
+
+int main() {
+    RUN(test_survives_reboot);
+    RUN(test_compaction);
+    RUN(test_failed_write_is_retried);
+    RUN(test_failed_compaction_is_retried);
+    RUN(test_power_cut);
+    RUN(test_debounce);
+    RUN(test_max_delay);
+    RUN(test_retry);
+
+    return test_result();
+}
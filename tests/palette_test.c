@@ -0,0 +1,199 @@
+/*
+ * Compares fire palette lookups with heat_color(), the 16 color
+ * interpolation the fireplace used before, for speed and output.
+ * Also checks blending and rotation of palettes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../components/palette/palette.c"
+
+#include "test.h"
+
+#define LOOKUPS 20000000
+
+
+// fireplace.c before palettes
+static ws2812_pixel_t heat_colors[16] = {
+    { .color=0x000000 },
+    { .color=0x330000 },
+    { .color=0x660000 },
+    { .color=0x990000 },
+    { .color=0xcc0000 },
+    { .color=0xff0000 },
+    { .color=0xff3300 },
+    { .color=0xff6600 },
+    { .color=0xff9900 },
+    { .color=0xffcc00 },
+    { .color=0xffff00 },
+    { .color=0xffff33 },
+    { .color=0xffff66 },
+    { .color=0xffff99 },
+    { .color=0xffffcc },
+    { .color=0xffffff },
+};
+
+static int min(int a, int b) {
+    return (a > b) ? b : a;
+}
+
+static uint8_t scale(uint8_t x, uint8_t s) {
+    return (((uint16_t)x) * s) >> 8;
+}
+
+static ws2812_pixel_t heat_color(uint8_t index) {
+    ws2812_pixel_t lo_color = heat_colors[index >> 4];
+    if (!(index & 0xf))
+        return lo_color;
+
+    ws2812_pixel_t hi_color = heat_colors[min((index >> 4) + 1, 15)];
+    uint8_t s2 = (index & 0xf) << 4;
+    uint8_t s1 = 255 - s2;
+
+    return (ws2812_pixel_t) {
+        .red = scale(lo_color.red, s1) + scale(hi_color.red, s2),
+        .green = scale(lo_color.green, s1) + scale(hi_color.green, s2),
+        .blue = scale(lo_color.blue, s1) + scale(hi_color.blue, s2),
+    };
+}
+
+
+static double now_ns() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Sums the colors so the lookups are not optimized away
+static volatile uint32_t sink;
+
+static double bench_heat_color() {
+    uint32_t sum = 0;
+    double start = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+        sum += heat_color(i * 7).color;
+    }
+    double elapsed = now_ns() - start;
+    sink = sum;
+    return elapsed / LOOKUPS;
+}
+
+static double bench_palette() {
+    const palette_t *fire = palette_fire();
+    uint32_t sum = 0;
+    double start = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+        sum += palette_color(fire, i * 7).color;
+    }
+    double elapsed = now_ns() - start;
+    sink = sum;
+    return elapsed / LOOKUPS;
+}
+
+static int channel_difference(ws2812_pixel_t a, ws2812_pixel_t b) {
+    int red = abs(a.red - b.red), green = abs(a.green - b.green), blue = abs(a.blue - b.blue);
+    return (red > green) ? ((red > blue) ? red : blue) : ((green > blue) ? green : blue);
+}
+
+
+static void test_speed() {
+    double heat_ns = bench_heat_color();
+    double palette_ns = bench_palette();
+
+    // host numbers, only the ratio carries over to the ESP8266
+    printf("    heat_color() %.2f ns, palette lookup %.2f ns per pixel (%.1fx)\n",
+           heat_ns, palette_ns, heat_ns / palette_ns);
+    CHECK(palette_ns < heat_ns);
+}
+
+static void test_fire_matches_heat_color() {
+    const palette_t *fire = palette_fire();
+
+    int worst = 0, worst_index = 0;
+    long total = 0;
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        int difference = channel_difference(palette_color(fire, i), heat_color(i));
+        total += difference;
+        if (difference > worst) {
+            worst = difference;
+            worst_index = i;
+        }
+    }
+
+    printf("    largest channel difference %d at %d, %.1f on average\n",
+           worst, worst_index, (double)total / PALETTE_SIZE);
+
+    // the ends and the full red and yellow stops are the same colors
+    CHECK(palette_color(fire, 0).color == heat_color(0).color);
+    CHECK(palette_color(fire, 80).color == heat_color(80).color);
+    CHECK(palette_color(fire, 160).color == heat_color(160).color);
+    CHECK(palette_color(fire, 255).color == 0xffffff);
+}
+
+static void test_build() {
+    static const palette_stop_t stops[] = {
+        PALETTE_STOP(0, 0x000000),
+        PALETTE_STOP(128, 0xff8000),
+        PALETTE_STOP(200, 0x0000ff),
+    };
+    palette_t palette;
+
+    CHECK(palette_build(&palette, stops, 3) == 0);
+    CHECK(palette_color(&palette, 0).color == 0x000000);
+    CHECK(palette_color(&palette, 128).color == 0xff8000);
+    CHECK(palette_color(&palette, 200).color == 0x0000ff);
+    CHECK(palette_color(&palette, 255).color == 0x0000ff);
+
+    // red rises steadily up to the second stop
+    for (int i = 1; i <= 128; i++) {
+        CHECK(palette_color(&palette, i).red >= palette_color(&palette, i - 1).red);
+    }
+
+    static const palette_stop_t unsorted[] = {
+        PALETTE_STOP(100, 0x000000),
+        PALETTE_STOP(50, 0xffffff),
+    };
+    CHECK(palette_build(&palette, unsorted, 2) < 0);
+    CHECK(palette_build(&palette, stops, 0) < 0);
+}
+
+static void test_blend() {
+    palette_t blended;
+
+    palette_blend(&blended, palette_fire(), palette_rainbow(), 0);
+    CHECK(!memcmp(&blended, palette_fire(), sizeof(blended)));
+
+    palette_blend(&blended, palette_fire(), palette_rainbow(), 255);
+    CHECK(!memcmp(&blended, palette_rainbow(), sizeof(blended)));
+
+    palette_blend(&blended, palette_fire(), palette_rainbow(), 128);
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        ws2812_pixel_t a = palette_color(palette_fire(), i), b = palette_color(palette_rainbow(), i);
+        ws2812_pixel_t mid = { .red = (a.red + b.red) / 2, .green = (a.green + b.green) / 2,
+                               .blue = (a.blue + b.blue) / 2 };
+        CHECK(channel_difference(palette_color(&blended, i), mid) <= 1);
+    }
+}
+
+static void test_rotate() {
+    palette_t rotated = *palette_rainbow();
+
+    palette_rotate(&rotated, 100);
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        CHECK(palette_color(&rotated, i).color ==
+              palette_color(palette_rainbow(), (i + PALETTE_SIZE - 100) % PALETTE_SIZE).color);
+    }
+}
+
+
+int main() {
+    RUN(test_fire_matches_heat_color);
+    RUN(test_build);
+    RUN(test_blend);
+    RUN(test_rotate);
+    RUN(test_speed);
+
+    return test_result();
+}
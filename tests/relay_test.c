@@ -0,0 +1,316 @@
+/*
+ * Runs relay.c against a simulated 50 and 60 Hz zero-cross signal and
+ * FRC1 timer, in simulated time, with detector jitter and interrupt
+ * latency. Prints how far from the crossing the contacts close.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include "../components/relay/relay.c"
+
+#include "test.h"
+
+#define ZERO_CROSS_GPIO 4
+#define RELAY_A_GPIO 12
+#define RELAY_B_GPIO 13
+#define LEAD_US 4000
+
+// system time wraps around early on
+#define BOOT_US (0xFFFFFFFF - 2000000)
+
+// first crossing, mains is not in phase with anything
+#define PHASE_US 3217
+
+
+// Simulated time in microseconds, the system time runs off it
+static uint64_t now_us;
+
+uint32_t sdk_system_get_time() {
+    return BOOT_US + now_us;
+}
+
+static uint32_t random_state = 1;
+
+static uint32_t random_below(uint32_t limit) {
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 8) % (limit + 1);
+}
+
+
+typedef struct {
+    uint32_t hz;
+    uint32_t jitter_us;         // largest delay of a detector pulse
+    uint32_t latency_us;        // largest delay of an interrupt handler
+    bool on;
+} mains_t;
+
+static mains_t mains;
+static uint32_t next_crossing;  // index of the next crossing to detect
+static uint64_t zero_cross_due;
+
+static uint64_t crossing_us(uint32_t k) {
+    return PHASE_US + (uint64_t)k * 500000 / mains.hz;
+}
+
+static void detect_next() {
+    zero_cross_due = crossing_us(next_crossing) +
+                     random_below(mains.jitter_us) + random_below(mains.latency_us);
+}
+
+static gpio_interrupt_handler_t zero_cross_interrupt;
+static _xt_isr timer_interrupt;
+
+void _xt_isr_attach(uint8_t i, _xt_isr func, void *arg) {
+    timer_interrupt = func;
+}
+
+void gpio_set_interrupt(const uint8_t gpio_num, const gpio_inttype_t int_type,
+                        gpio_interrupt_handler_t handler) {
+    zero_cross_interrupt = handler;
+}
+
+void gpio_enable(const uint8_t gpio_num, const gpio_direction_t direction) {
+}
+
+// FRC1 counts down from the timeout, its handler runs late under load
+static bool timer_running;
+static bool timer_interrupts;
+static uint64_t timer_due;
+
+void timer_set_interrupts(const timer_frc_t frc, bool enable) {
+    timer_interrupts = enable;
+}
+
+void timer_set_run(const timer_frc_t frc, const bool run) {
+    timer_running = run;
+}
+
+void timer_set_reload(const timer_frc_t frc, const bool reload) {
+}
+
+bool timer_set_timeout(const timer_frc_t frc, uint32_t us) {
+    timer_due = now_us + us + random_below(mains.latency_us);
+    return true;
+}
+
+
+// Contacts close LEAD_US after the coil is switched. Range of that
+// minus the nearest crossing.
+static bool measuring;
+static uint32_t writes;
+static int64_t min_error_us;
+static int64_t max_error_us;
+
+// Shortest time between switching two different relays
+static uint8_t last_gpio;
+static uint64_t last_write_us;
+static uint64_t min_gap_us;
+
+void gpio_write(const uint8_t gpio_num, const bool set) {
+    if (!measuring)
+        return;
+
+    writes++;
+    if (mains.on) {
+        uint64_t closes = now_us + LEAD_US;
+        uint32_t k = (closes - PHASE_US) * mains.hz / 500000;
+        int64_t before = closes - crossing_us(k);
+        int64_t after = closes - crossing_us(k + 1);
+        int64_t error = before < -after ? before : after;
+
+        if (error < min_error_us)
+            min_error_us = error;
+        if (error > max_error_us)
+            max_error_us = error;
+    }
+
+    if (last_write_us && gpio_num != last_gpio && now_us - last_write_us < min_gap_us)
+        min_gap_us = now_us - last_write_us;
+    last_gpio = gpio_num;
+    last_write_us = now_us;
+}
+
+
+// Runs interrupt handlers up to the next event before until
+static void advance_one(uint64_t until) {
+    uint64_t next = until;
+    int event = 0;
+    if (mains.on && zero_cross_due < next) {
+        next = zero_cross_due;
+        event = 1;
+    }
+    if (timer_running && timer_interrupts && timer_due < next) {
+        next = timer_due;
+        event = 2;
+    }
+
+    now_us = next;
+    if (event == 1) {
+        next_crossing++;
+        detect_next();
+        zero_cross_interrupt(ZERO_CROSS_GPIO);
+    } else if (event == 2) {
+        timer_interrupt(NULL);
+    }
+}
+
+static uint32_t notifications;
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken) {
+    notifications++;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    uint64_t deadline = now_us + (uint64_t)ticks * portTICK_PERIOD_MS * 1000;
+    while (!notifications && now_us < deadline)
+        advance_one(deadline);
+
+    uint32_t value = notifications;
+    notifications = clear_on_exit ? 0 : (value ? value - 1 : 0);
+    return value;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                               void *params, UBaseType_t priority,
+                               StackType_t *stack, StaticTask_t *task_buffer) {
+    return task_buffer;
+}
+
+
+// The scheduler task is run by the test, vTaskDelay() moves time on
+// and plays the scenario of relay_set calls
+static jmp_buf task_exit;
+static uint64_t task_end_us;
+static void (*scenario)(uint32_t now_ms);
+
+void vTaskDelay(TickType_t ticks) {
+    for (TickType_t i = 0; i < ticks; i++) {
+        uint64_t until = now_us + portTICK_PERIOD_MS * 1000;
+        while (now_us < until)
+            advance_one(until);
+
+        if (now_us >= task_end_us)
+            longjmp(task_exit, 1);
+        scenario(now_us / 1000);
+    }
+}
+
+static void run_task(void (*play)(uint32_t now_ms), uint32_t ms) {
+    scenario = play;
+    task_end_us = now_us + ms * 1000ULL;
+    if (!setjmp(task_exit))
+        relay_task(NULL);
+}
+
+
+// Scenarios start after the half period settled
+static uint32_t next_toggle_ms;
+
+static void start(mains_t signal) {
+    now_us = 0;
+    next_toggle_ms = 1000;
+    mains = signal;
+    next_crossing = 0;
+    detect_next();
+    notifications = 0;
+    timer_running = false;
+    timer_interrupts = false;
+
+    relay_count = 0;
+    last_crossing = 0;
+    half_period_us = DEFAULT_HALF_PERIOD_US;
+    armed = false;
+    scheduled = false;
+    memset(&stats, 0, sizeof(stats));
+
+    measuring = false;
+    relay_init(ZERO_CROSS_GPIO, LEAD_US);
+    relay_create(RELAY_A_GPIO, false);
+    relay_create(RELAY_B_GPIO, false);
+
+    measuring = true;
+    writes = 0;
+    min_error_us = INT64_MAX;
+    max_error_us = INT64_MIN;
+    last_write_us = 0;
+    min_gap_us = UINT64_MAX;
+}
+
+// Flips the first relay every 200 ms after the first second
+static void toggle_one(uint32_t now_ms) {
+    if (now_ms >= next_toggle_ms) {
+        relay_set(0, !relay_get(0));
+        next_toggle_ms += 200;
+    }
+}
+
+// Flips both at once every 500 ms
+static void toggle_both(uint32_t now_ms) {
+    if (now_ms >= next_toggle_ms) {
+        relay_set(0, !relay_get(0));
+        relay_set(1, !relay_get(1));
+        next_toggle_ms += 500;
+    }
+}
+
+
+static void switch_on_crossings(const char *name, mains_t signal) {
+    start(signal);
+    run_task(toggle_one, 11000);
+
+    const relay_stats_t *s = relay_stats();
+    printf("    %s: %u Hz, jitter %u us, latency %u us: %u switches, "
+           "error %+lld to %+lld us, timer late by %u us at most\n",
+           name, signal.hz, signal.jitter_us, signal.latency_us, s->switches,
+           (long long)min_error_us, (long long)max_error_us, s->max_error_us);
+
+    CHECK(s->switches == 50 && writes == 50);
+    CHECK(s->zero_cross_timeouts == 0);
+    CHECK(s->max_error_us <= signal.latency_us);
+
+    // the measured half period settles within the jitter
+    int32_t half_period = 500000 / signal.hz;
+    CHECK(abs((int32_t)s->half_period_us - half_period) <= (int32_t)signal.jitter_us);
+
+    // late by the detector and both handlers, never early
+    CHECK(min_error_us >= -(int32_t)signal.jitter_us);
+    CHECK(max_error_us <= signal.jitter_us * 2 + signal.latency_us * 2);
+}
+
+static void test_zero_cross() {
+    switch_on_crossings("quiet", (mains_t) { 50, 100, 5, true });
+    switch_on_crossings("quiet", (mains_t) { 60, 100, 5, true });
+    switch_on_crossings("under load", (mains_t) { 50, 100, 200, true });
+    switch_on_crossings("under load", (mains_t) { 60, 100, 200, true });
+}
+
+static void test_stagger() {
+    start((mains_t) { 50, 100, 50, true });
+    run_task(toggle_both, 11000);
+
+    printf("    two relays switched %llu ms apart at least\n",
+           (unsigned long long)min_gap_us / 1000);
+    CHECK(relay_stats()->switches == 40 && writes == 40);
+    CHECK(min_gap_us >= RELAY_STAGGER_MS * 1000);
+}
+
+static void test_no_mains() {
+    start((mains_t) { 50, 0, 0, false });
+    run_task(toggle_one, 3000);
+
+    // switched anyway after waiting for a crossing and a half
+    const relay_stats_t *s = relay_stats();
+    CHECK(s->switches == 10 && writes == 10);
+    CHECK(s->zero_cross_timeouts == 10);
+}
+
+
+int main() {
+    RUN(test_zero_cross);
+    RUN(test_stagger);
+    RUN(test_no_mains);
+
+    return test_result();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Just enough of FreeRTOS for components built on the host by tests/.
+// Each test defines the functions it uses.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uint32_t TickType_t;
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t StackType_t;
+
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *TimerHandle_t;
+
+typedef struct { uint8_t data[96]; } StaticTask_t;
+typedef struct { uint8_t data[80]; } StaticQueue_t;
+typedef struct { uint8_t data[48]; } StaticTimer_t;
+typedef StaticQueue_t StaticSemaphore_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 10
+
+#define configGENERATE_RUN_TIME_STATS 0
+
+// tests run everything on one thread
+#define taskENTER_CRITICAL() do {} while (0)
+#define taskEXIT_CRITICAL() do {} while (0)
+
+#define IRAM
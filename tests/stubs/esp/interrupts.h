@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+#define INUM_TIMER_FRC1 9
+
+typedef void (*_xt_isr)(void *arg);
+
+void _xt_isr_attach(uint8_t i, _xt_isr func, void *arg);
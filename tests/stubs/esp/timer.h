@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    FRC1 = 0,
+    FRC2 = 1,
+} timer_frc_t;
+
+void timer_set_interrupts(const timer_frc_t frc, bool enable);
+void timer_set_run(const timer_frc_t frc, const bool run);
+void timer_set_reload(const timer_frc_t frc, const bool reload);
+bool timer_set_timeout(const timer_frc_t frc, uint32_t us);
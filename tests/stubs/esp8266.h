@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef IRAM
+#define IRAM
+#endif
+
+typedef enum {
+    GPIO_INPUT,
+    GPIO_OUTPUT,
+} gpio_direction_t;
+
+typedef enum {
+    GPIO_INTTYPE_NONE = 0,
+    GPIO_INTTYPE_EDGE_POS = 1,
+    GPIO_INTTYPE_EDGE_NEG = 2,
+    GPIO_INTTYPE_EDGE_ANY = 3,
+} gpio_inttype_t;
+
+typedef void (*gpio_interrupt_handler_t)(uint8_t gpio_num);
+
+void gpio_enable(const uint8_t gpio_num, const gpio_direction_t direction);
+void gpio_write(const uint8_t gpio_num, const bool set);
+void gpio_set_interrupt(const uint8_t gpio_num, const gpio_inttype_t int_type,
+                        gpio_interrupt_handler_t handler);
+
+uint32_t hwrand(void);
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "esp_sta.h"
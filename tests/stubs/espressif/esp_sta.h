@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct sdk_station_config {
+    uint8_t ssid[32];
+    uint8_t password[64];
+    uint8_t bssid_set;
+    uint8_t bssid[6];
+};
+
+enum {
+    STATION_IDLE = 0,
+    STATION_CONNECTING,
+    STATION_WRONG_PASSWORD,
+    STATION_NO_AP_FOUND,
+    STATION_CONNECT_FAIL,
+    STATION_GOT_IP,
+};
+
+struct sdk_scan_config {
+    uint8_t *ssid;
+    uint8_t *bssid;
+    uint8_t channel;
+    uint8_t show_hidden;
+};
+
+struct sdk_bss_info {
+    struct {
+        struct sdk_bss_info *stqe_next;
+    } next;
+    uint8_t bssid[6];
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t channel;
+    int8_t rssi;
+};
+
+typedef enum {
+    SCAN_OK = 0,
+    SCAN_FAIL,
+    SCAN_PENDING,
+    SCAN_BUSY,
+    SCAN_CANCEL,
+} sdk_scan_status_t;
+
+typedef void (*sdk_scan_done_cb_t)(void *arg, sdk_scan_status_t status);
+
+bool sdk_wifi_station_set_config(struct sdk_station_config *config);
+bool sdk_wifi_station_connect(void);
+bool sdk_wifi_station_disconnect(void);
+bool sdk_wifi_station_dhcpc_start(void);
+bool sdk_wifi_station_dhcpc_stop(void);
+uint8_t sdk_wifi_station_get_connect_status(void);
+bool sdk_wifi_station_scan(struct sdk_scan_config *config, sdk_scan_done_cb_t cb);
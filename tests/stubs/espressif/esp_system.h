@@ -0,0 +1,5 @@
+#pragma once
+
+#include <stdint.h>
+
+uint32_t sdk_system_get_time(void);
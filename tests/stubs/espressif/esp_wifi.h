@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STATION_IF 0
+
+#define STATION_MODE 1
+
+typedef struct {
+    uint32_t addr;
+} ip4_addr_t;
+
+struct ip_info {
+    ip4_addr_t ip;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+};
+
+bool sdk_wifi_get_macaddr(uint8_t if_index, uint8_t *macaddr);
+bool sdk_wifi_set_opmode(uint8_t opmode);
+bool sdk_wifi_set_channel(uint8_t channel);
+uint8_t sdk_wifi_get_channel(void);
+bool sdk_wifi_get_ip_info(uint8_t if_index, struct ip_info *info);
+bool sdk_wifi_set_ip_info(uint8_t if_index, struct ip_info *info);
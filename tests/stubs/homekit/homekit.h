@@ -0,0 +1,5 @@
+#pragma once
+
+#include "types.h"
+
+void homekit_characteristic_notify(homekit_characteristic_t *ch, homekit_value_t value);
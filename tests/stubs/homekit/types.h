@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+
+typedef enum {
+    homekit_format_bool,
+    homekit_format_uint8,
+    homekit_format_uint16,
+    homekit_format_uint32,
+    homekit_format_uint64,
+    homekit_format_int,
+    homekit_format_float,
+    homekit_format_string,
+} homekit_format_t;
+
+typedef struct {
+    homekit_format_t format;
+    bool is_null;
+    union {
+        bool bool_value;
+        int int_value;
+        float float_value;
+    };
+} homekit_value_t;
+
+typedef struct {
+    homekit_format_t format;
+    homekit_value_t value;
+} homekit_characteristic_t;
+
+#define HOMEKIT_BOOL(v) ((homekit_value_t) {.format=homekit_format_bool, .bool_value=(v)})
+#define HOMEKIT_FLOAT(v) ((homekit_value_t) {.format=homekit_format_float, .float_value=(v)})
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "udp.h"
+
+typedef void (*tcpip_callback_fn)(void *ctx);
+
+#define LOCK_TCPIP_CORE() do {} while (0)
+#define UNLOCK_TCPIP_CORE() do {} while (0)
+
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include "pbuf.h"
+
+typedef int8_t err_t;
+typedef uint16_t u16_t;
+typedef struct { uint32_t addr; } ip_addr_t;
+
+#define ERR_OK 0
+#define SOF_BROADCAST 0x20
+
+extern const ip_addr_t ip_addr_any;
+extern const ip_addr_t ip_addr_broadcast;
+#define IP_ADDR_ANY (&ip_addr_any)
+#define IP_ADDR_BROADCAST (&ip_addr_broadcast)
+
+struct udp_pcb;
+
+typedef void (*udp_recv_fn)(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                            const ip_addr_t *addr, u16_t port);
+
+struct udp_pcb {
+    uint8_t so_options;
+    udp_recv_fn recv;
+    void *recv_arg;
+};
+
+#define ip_set_option(pcb, option) ((pcb)->so_options |= (option))
+
+struct udp_pcb *udp_new(void);
+void udp_remove(struct udp_pcb *pcb);
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *addr, u16_t port);
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg);
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
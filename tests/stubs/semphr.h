@@ -0,0 +1,7 @@
+#pragma once
+
+#include "queue.h"
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *mutex_buffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
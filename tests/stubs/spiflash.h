@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+bool spiflash_read(uint32_t addr, uint8_t *buf, uint32_t size);
+bool spiflash_write(uint32_t addr, uint8_t *buf, uint32_t size);
+bool spiflash_erase_sector(uint32_t addr);
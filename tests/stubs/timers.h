@@ -0,0 +1,10 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+TimerHandle_t xTimerCreateStatic(const char *name, TickType_t period, UBaseType_t auto_reload,
+                                 void *id, TimerCallbackFunction_t callback,
+                                 StaticTimer_t *timer_buffer);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef union {
+    struct {
+        uint8_t blue;
+        uint8_t green;
+        uint8_t red;
+        uint8_t white;
+    };
+    uint32_t color;
+} ws2812_pixel_t;
+
+typedef enum {
+    PIXEL_RGB = 12,
+    PIXEL_RGBW = 16,
+} pixeltype_t;
@@ -0,0 +1,309 @@
+/*
+ * Runs sync_clock.c as one device next to a simulated leader, in
+ * simulated time, with beacon delays, jitter and clock drift. Prints
+ * how far the shared clock is from the leader's.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+// the smallest simulated delay is made up for
+#define SYNC_CLOCK_DELAY_US 500
+
+#include "../components/sync_clock/sync_clock.c"
+
+#include "test.h"
+
+#define NODE 0x50000000
+#define LOWER_NODE 0x10000000
+#define HIGHER_NODE 0x90000000
+
+#define SETTLE_US (SYNC_CLOCK_WINDOW * 1000000ULL + 4000000)
+
+
+// Simulated time in microseconds, the device clock runs off it
+static uint64_t true_us;
+static uint32_t boot_us;
+static int32_t drift_ppm;
+
+uint32_t sdk_system_get_time() {
+    return boot_us + true_us + (int64_t)true_us * drift_ppm / 1000000;
+}
+
+// Ticks are counted from boot, they do not wrap with the system time
+TickType_t xTaskGetTickCount() {
+    return (true_us + (int64_t)true_us * drift_ppm / 1000000) / 1000 / portTICK_PERIOD_MS;
+}
+
+bool sdk_wifi_get_macaddr(uint8_t if_index, uint8_t *macaddr) {
+    uint8_t mac[6] = { 0x5c, 0xcf, (uint8_t)(NODE >> 24), (uint8_t)(NODE >> 16),
+                       (uint8_t)(NODE >> 8), (uint8_t)NODE };
+    memcpy(macaddr, mac, sizeof(mac));
+    return true;
+}
+
+static TimerCallbackFunction_t timer_callback;
+
+TimerHandle_t xTimerCreateStatic(const char *name, TickType_t period, UBaseType_t auto_reload,
+                                 void *id, TimerCallbackFunction_t callback,
+                                 StaticTimer_t *timer_buffer) {
+    timer_callback = callback;
+    return timer_buffer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks) {
+    return pdPASS;
+}
+
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx) {
+    function(ctx);
+    return ERR_OK;
+}
+
+const ip_addr_t ip_addr_any = { 0 };
+const ip_addr_t ip_addr_broadcast = { 0xFFFFFFFF };
+
+static struct udp_pcb test_pcb;
+static uint32_t beacons_sent;
+
+struct udp_pcb *udp_new() {
+    memset(&test_pcb, 0, sizeof(test_pcb));
+    return &test_pcb;
+}
+
+void udp_remove(struct udp_pcb *pcb) {
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *addr, u16_t port) {
+    return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg) {
+    pcb->recv = recv;
+    pcb->recv_arg = recv_arg;
+}
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    beacons_sent++;
+    return ERR_OK;
+}
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, uint16_t length, pbuf_type type) {
+    struct pbuf *p = malloc(sizeof(struct pbuf) + length);
+    p->payload = p + 1;
+    p->len = p->tot_len = length;
+    return p;
+}
+
+uint8_t pbuf_free(struct pbuf *p) {
+    free(p);
+    return 1;
+}
+
+uint16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, uint16_t len, uint16_t offset) {
+    if (offset >= p->len)
+        return 0;
+    if (len > p->len - offset)
+        len = p->len - offset;
+    memcpy(dataptr, (uint8_t *)p->payload + offset, len);
+    return len;
+}
+
+
+typedef struct {
+    uint32_t node;
+    int64_t offset_us;          // its clock minus simulated time
+    bool active;
+} leader_t;
+
+typedef struct {
+    uint32_t delay_us;          // smallest delay of a beacon
+    uint32_t jitter_us;         // largest extra delay
+} network_t;
+
+static uint32_t random_state = 1;
+
+static uint32_t random_below(uint32_t limit) {
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 8) % (limit + 1);
+}
+
+static void deliver(const leader_t *leader, uint64_t sent_us) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, BEACON_SIZE, PBUF_RAM);
+    uint8_t *beacon = p->payload;
+    memset(beacon, 0, BEACON_SIZE);
+    put_u32(beacon + BEACON_MAGIC, SYNC_MAGIC);
+    beacon[BEACON_VERSION] = SYNC_VERSION;
+    put_u32(beacon + BEACON_NODE, leader->node);
+
+    uint64_t time = sent_us + leader->offset_us;
+    put_u32(beacon + BEACON_TIME, time >> 32);
+    put_u32(beacon + BEACON_TIME + 4, time);
+
+    test_pcb.recv(test_pcb.recv_arg, &test_pcb, p, IP_ADDR_BROADCAST, SYNC_CLOCK_PORT);
+}
+
+// Range of the shared clock minus the leader's since checks started,
+// checked every 100 ms
+static int64_t min_error_us;
+static int64_t max_error_us;
+static uint64_t checks_from_us;
+
+// Runs the device and up to two leaders for a while. Leaders send
+// 300 and 600 ms after the device's timer fires.
+static void run(uint64_t duration_us, const network_t *network, leader_t *a, leader_t *b) {
+    leader_t *leaders[] = { a, b };
+    uint64_t end = true_us + duration_us;
+
+    while (true_us < end) {
+        uint64_t next = (true_us / 100000 + 1) * 100000;
+
+        for (int i = 0; i < 2; i++) {
+            leader_t *leader = leaders[i];
+            if (!leader || !leader->active)
+                continue;
+
+            // a beacon sent in this period arrives in it
+            uint64_t sent = (true_us / 1000000) * 1000000 + 300000 * (i + 1);
+            if (sent >= true_us && sent < next) {
+                true_us = sent + network->delay_us + random_below(network->jitter_us);
+                deliver(leader, sent);
+            }
+        }
+
+        true_us = next;
+        if (true_us % 1000000 == 0)
+            timer_callback(NULL);
+
+        if (true_us >= checks_from_us && a && a->active && !state.leading) {
+            int64_t error = (int64_t)(sync_clock_us() - (true_us + a->offset_us));
+            if (error < min_error_us)
+                min_error_us = error;
+            if (error > max_error_us)
+                max_error_us = error;
+        }
+    }
+}
+
+static void start(int32_t drift, uint32_t boot) {
+    true_us = 0;
+    drift_ppm = drift;
+    boot_us = boot;
+    beacons_sent = 0;
+    window_reset();
+
+    sync_clock_init();
+}
+
+static void check_from(uint64_t from_us) {
+    min_error_us = INT64_MAX;
+    max_error_us = INT64_MIN;
+    checks_from_us = from_us;
+}
+
+
+static void follow(const char *name, network_t network, int32_t drift) {
+    // system time wraps around early on
+    start(drift, 0xFFFFFFFF - 5000000);
+
+    leader_t leader = { .node = LOWER_NODE, .offset_us = 123456789, .active = true };
+    check_from(SETTLE_US);
+    run(120000000, &network, &leader, NULL);
+
+    sync_clock_stats_t stats = sync_clock_stats();
+    printf("    %s: delay %u us + up to %u us, drift %+d ppm: error %+lld to %+lld us\n",
+           name, network.delay_us, network.jitter_us, drift,
+           (long long)min_error_us, (long long)max_error_us);
+
+    CHECK(!stats.leading && stats.leader == LOWER_NODE);
+    CHECK(stats.steps == 1);
+    CHECK(beacons_sent == 0);
+}
+
+static void test_follows_leader() {
+    follow("quiet network", (network_t) { 500, 3000 }, 0);
+    CHECK(min_error_us > -1000 && max_error_us < 1000);
+
+    // a fast clock is ahead by up to the drift over the window, as the
+    // largest samples are the oldest ones
+    follow("fast clock", (network_t) { 500, 3000 }, 50);
+    CHECK(min_error_us > -1000 && max_error_us < 1500);
+
+    // a slow one falls behind between beacons
+    follow("slow clock", (network_t) { 500, 3000 }, -50);
+    CHECK(min_error_us > -1500 && max_error_us < 1000);
+
+    follow("busy network", (network_t) { 500, 10000 }, 0);
+    CHECK(min_error_us > -2000 && max_error_us < 1000);
+
+    follow("busy network, slow clock", (network_t) { 500, 10000 }, -50);
+    CHECK(min_error_us > -4000 && max_error_us < 1000);
+}
+
+static void test_uncompensated_delay() {
+    // followers lag by what SYNC_CLOCK_DELAY_US does not cover
+    follow("slower network", (network_t) { 2500, 3000 }, 0);
+    CHECK(max_error_us < -1900 && min_error_us > -3000);
+}
+
+static void test_takes_over() {
+    start(20, 1000);
+    network_t network = { 500, 3000 };
+    leader_t leader = { .node = LOWER_NODE, .offset_us = -5000000, .active = true };
+    run(SETTLE_US, &network, &leader, NULL);
+
+    int64_t before = sync_clock_us() - (true_us + leader.offset_us);
+    leader.active = false;
+    run(SYNC_CLOCK_TIMEOUT_MS * 1000 + 2000000, &network, &leader, NULL);
+
+    sync_clock_stats_t stats = sync_clock_stats();
+    CHECK(stats.leading && stats.leader == NODE);
+    CHECK(beacons_sent > 0);
+
+    // goes on from where it was, only off by its own drift since
+    int64_t after = sync_clock_us() - (true_us + leader.offset_us);
+    printf("    clock moved %+lld us while taking over\n", (long long)(after - before));
+    CHECK(llabs(after - before) < 1000);
+}
+
+static void test_lower_id_leads() {
+    start(0, 1000);
+    network_t network = { 500, 0 };
+
+    // nobody else at first
+    run(SYNC_CLOCK_TIMEOUT_MS * 1000 + 2000000, &network, NULL, NULL);
+    CHECK(sync_clock_stats().leading);
+
+    leader_t lower = { .node = LOWER_NODE, .offset_us = 777000000, .active = true };
+    run(5000000, &network, &lower, NULL);
+
+    sync_clock_stats_t stats = sync_clock_stats();
+    CHECK(!stats.leading && stats.leader == LOWER_NODE);
+    CHECK(stats.steps == 1);
+    CHECK(llabs((int64_t)(sync_clock_us() - (true_us + lower.offset_us))) < 1000);
+}
+
+static void test_higher_id_ignored() {
+    start(0, 1000);
+    network_t network = { 500, 0 };
+    leader_t leader = { .node = LOWER_NODE, .offset_us = 1000000, .active = true };
+    leader_t higher = { .node = HIGHER_NODE, .offset_us = 9000000, .active = true };
+
+    check_from(5000000);
+    run(30000000, &network, &leader, &higher);
+
+    sync_clock_stats_t stats = sync_clock_stats();
+    CHECK(stats.leader == LOWER_NODE);
+    CHECK(stats.steps == 1);
+    CHECK(min_error_us > -1000 && max_error_us < 1000);
+}
+
+
+int main() {
+    RUN(test_follows_leader);
+    RUN(test_uncompensated_delay);
+    RUN(test_takes_over);
+    RUN(test_lower_id_leads);
+    RUN(test_higher_id_ignored);
+
+    return test_result();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdio.h>
+
+static int test_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("    %s:%d: %s failed\n", __FILE__, __LINE__, #condition); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define RUN(test) \
+    do { \
+        int failures = test_failures; \
+        printf("%s\n", #test); \
+        test(); \
+        printf("    %s\n", (test_failures == failures) ? "ok" : "FAILED"); \
+    } while (0)
+
+static inline int test_result() {
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,409 @@
+/*
+ * Runs wifi_fast.c against a simulated station and flash, in simulated
+ * time: which way it connects after a reboot, when it falls back to a
+ * full scan and what it keeps in the cache. Prints time to an address.
+ */
+#include <stdio.h>
+#include <setjmp.h>
+
+#define WIFI_FAST_FLASH_ADDR 0x20000
+#define WIFI_FAST_STATIC_IP 1
+
+#include "../components/wifi_fast/wifi_fast.c"
+
+#include "test.h"
+
+#define SECTOR_SIZE 4096
+
+// Times of the simulated station
+#define FULL_SCAN_MS 2000
+#define CHANNEL_SCAN_MS 100
+#define JOIN_MS 300
+#define DHCP_MS 1000
+
+// Gives up on tasks that never finish
+#define TASK_LIMIT_MS 60000
+
+
+static uint8_t flash[SECTOR_SIZE];
+static uint32_t erases;
+
+bool spiflash_read(uint32_t addr, uint8_t *buf, uint32_t size) {
+    addr -= WIFI_FAST_FLASH_ADDR;
+    if (addr + size > SECTOR_SIZE)
+        return false;
+
+    memcpy(buf, flash + addr, size);
+    return true;
+}
+
+bool spiflash_write(uint32_t addr, uint8_t *buf, uint32_t size) {
+    addr -= WIFI_FAST_FLASH_ADDR;
+    if (addr + size > SECTOR_SIZE)
+        return false;
+
+    for (uint32_t i = 0; i < size; i++) {
+        flash[addr + i] &= buf[i];
+    }
+    return true;
+}
+
+bool spiflash_erase_sector(uint32_t addr) {
+    if (addr != WIFI_FAST_FLASH_ADDR)
+        return false;
+
+    memset(flash, 0xFF, SECTOR_SIZE);
+    erases++;
+    return true;
+}
+
+
+typedef struct {
+    const char *ssid;
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+    bool on;
+} access_point_t;
+
+static access_point_t access_points[] = {
+    { "home", { 0x02, 0, 0, 0, 0, 1 }, 6, -60, true },
+    { "home", { 0x02, 0, 0, 0, 0, 2 }, 11, -75, true },
+    { "home", { 0x02, 0, 0, 0, 0, 3 }, 1, -50, false },
+    { "neighbour", { 0x02, 0, 0, 0, 0, 4 }, 6, -40, true },
+};
+
+#define ACCESS_POINT_COUNT (sizeof(access_points) / sizeof(access_points[0]))
+
+#define LEASE_IP 0x0A01A8C0
+
+
+static uint32_t now_ms;
+
+uint32_t sdk_system_get_time() {
+    return now_ms * 1000;
+}
+
+// The station joins an access point some time after connect is called
+static struct sdk_station_config config;
+static uint8_t channel;
+static bool dhcp;
+static struct ip_info static_info;
+static const access_point_t *joining;
+static uint32_t got_ip_at;
+static uint32_t scans;
+
+static void station_reset() {
+    memset(&config, 0, sizeof(config));
+    channel = 1;
+    dhcp = true;
+    memset(&static_info, 0, sizeof(static_info));
+    joining = NULL;
+    scans = 0;
+}
+
+static bool matches(const access_point_t *ap, const uint8_t *ssid) {
+    return ap->on && !strncmp(ap->ssid, (const char *)ssid, 32);
+}
+
+bool sdk_wifi_set_opmode(uint8_t opmode) {
+    return true;
+}
+
+bool sdk_wifi_station_set_config(struct sdk_station_config *station_config) {
+    config = *station_config;
+    return true;
+}
+
+bool sdk_wifi_set_channel(uint8_t _channel) {
+    channel = _channel;
+    return true;
+}
+
+uint8_t sdk_wifi_get_channel() {
+    return channel;
+}
+
+bool sdk_wifi_station_dhcpc_start() {
+    dhcp = true;
+    return true;
+}
+
+bool sdk_wifi_station_dhcpc_stop() {
+    dhcp = false;
+    return true;
+}
+
+bool sdk_wifi_set_ip_info(uint8_t if_index, struct ip_info *info) {
+    static_info = *info;
+    return true;
+}
+
+bool sdk_wifi_get_ip_info(uint8_t if_index, struct ip_info *info) {
+    if (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        return false;
+
+    if (dhcp) {
+        info->ip.addr = LEASE_IP;
+        info->netmask.addr = 0x00FFFFFF;
+        info->gw.addr = 0x0101A8C0;
+    } else {
+        *info = static_info;
+    }
+    return true;
+}
+
+// A known access point on the current channel is joined right away,
+// anything else takes a scan of all channels first
+bool sdk_wifi_station_connect() {
+    const access_point_t *best = NULL;
+    for (int i = 0; i < ACCESS_POINT_COUNT; i++) {
+        const access_point_t *ap = &access_points[i];
+        if (!matches(ap, config.ssid))
+            continue;
+        if (config.bssid_set && memcmp(ap->bssid, config.bssid, 6))
+            continue;
+        if (!best || ap->rssi > best->rssi)
+            best = ap;
+    }
+
+    joining = best;
+    if (!joining)
+        return true;
+
+    uint32_t time = JOIN_MS;
+    if (!config.bssid_set || joining->channel != channel)
+        time += FULL_SCAN_MS;
+    if (dhcp)
+        time += DHCP_MS;
+
+    channel = joining->channel;
+    got_ip_at = now_ms + time;
+    return true;
+}
+
+bool sdk_wifi_station_disconnect() {
+    joining = NULL;
+    return true;
+}
+
+uint8_t sdk_wifi_station_get_connect_status() {
+    if (!joining)
+        return STATION_NO_AP_FOUND;
+    return now_ms >= got_ip_at ? STATION_GOT_IP : STATION_CONNECTING;
+}
+
+// Results come after vTaskDelay() moved time on
+static sdk_scan_done_cb_t scan_cb;
+static uint32_t scan_done_at;
+static uint8_t scan_ssid[32];
+static uint8_t scan_channel;
+
+bool sdk_wifi_station_scan(struct sdk_scan_config *scan_config, sdk_scan_done_cb_t cb) {
+    scans++;
+    memcpy(scan_ssid, scan_config->ssid, sizeof(scan_ssid));
+    scan_channel = scan_config->channel;
+    scan_done_at = now_ms + CHANNEL_SCAN_MS;
+    scan_cb = cb;
+    return true;
+}
+
+static void scan_finish() {
+    struct sdk_bss_info results[ACCESS_POINT_COUNT + 1];
+    memset(results, 0, sizeof(results));
+
+    // the first entry is the list head
+    struct sdk_bss_info *last = &results[0];
+    for (int i = 0; i < ACCESS_POINT_COUNT; i++) {
+        const access_point_t *ap = &access_points[i];
+        if (!matches(ap, scan_ssid) || (scan_channel && ap->channel != scan_channel))
+            continue;
+
+        struct sdk_bss_info *bss = last + 1;
+        memcpy(bss->bssid, ap->bssid, 6);
+        bss->channel = ap->channel;
+        bss->rssi = ap->rssi;
+        last->next.stqe_next = bss;
+        last = bss;
+    }
+
+    sdk_scan_done_cb_t cb = scan_cb;
+    scan_cb = NULL;
+    cb(&results[0], SCAN_OK);
+}
+
+
+static TaskFunction_t task_function;
+static jmp_buf task_exit;
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                       void *params, UBaseType_t priority, TaskHandle_t *task) {
+    task_function = function;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+}
+
+void vTaskDelay(TickType_t ticks) {
+    now_ms += ticks * portTICK_PERIOD_MS;
+    if (scan_cb && now_ms >= scan_done_at)
+        scan_finish();
+    if (now_ms >= TASK_LIMIT_MS)
+        longjmp(task_exit, 1);
+}
+
+
+// Connects after a reboot, RAM is lost and flash is kept. Returns the
+// time it took to get an address.
+static uint32_t boot(const char *ssid) {
+    now_ms = 0;
+    station_reset();
+    memset(&cache, 0, sizeof(cache));
+    state = WIFI_FAST_IDLE;
+
+    CHECK(wifi_fast_connect(ssid, "secret") == 0);
+    CHECK(!wifi_fast_connected());
+    if (!setjmp(task_exit))
+        task_function(NULL);
+
+    return got_ip_at;
+}
+
+static bool cache_is(const access_point_t *ap) {
+    wifi_cache_t stored;
+    memcpy(&stored, flash, sizeof(stored));
+    return stored.magic == WIFI_FAST_MAGIC &&
+           stored.checksum == cache_checksum(&stored) &&
+           stored.bssid_valid && !memcmp(stored.bssid, ap->bssid, 6) &&
+           stored.channel == ap->channel &&
+           stored.ip == LEASE_IP;
+}
+
+// Connects with erased flash, the third access point is off
+static uint32_t first_boot() {
+    memset(flash, 0xFF, sizeof(flash));
+    erases = 0;
+    for (int i = 0; i < ACCESS_POINT_COUNT; i++)
+        access_points[i].on = i != 2;
+
+    return boot("home");
+}
+
+
+static void test_first_boot_scans() {
+    uint32_t ms = first_boot();
+    printf("    no cache: IP after %u ms\n", ms);
+    CHECK(wifi_fast_connected());
+    CHECK(ms == FULL_SCAN_MS + JOIN_MS + DHCP_MS);
+
+    // the strongest access point of the network, found by one lookup
+    CHECK(cache_is(&access_points[0]));
+    CHECK(scans == 1);
+    CHECK(erases == 1);
+}
+
+static void test_cached_connect() {
+    first_boot();
+    erases = 0;
+
+    uint32_t ms = boot("home");
+    printf("    cached: IP after %u ms\n", ms);
+    CHECK(wifi_fast_connected());
+    CHECK(ms == JOIN_MS);
+
+    // nothing changed, no lookup and the flash is left alone
+    CHECK(scans == 0);
+    CHECK(erases == 0);
+    CHECK(cache_is(&access_points[0]));
+}
+
+static void test_access_point_gone() {
+    first_boot();
+
+    // the cached one is off, the other one is found by the full scan
+    access_points[0].on = false;
+    uint32_t ms = boot("home");
+    printf("    cached access point gone: IP after %u ms\n", ms);
+    CHECK(wifi_fast_connected());
+    CHECK(ms == WIFI_FAST_DIRECT_TIMEOUT_MS + FULL_SCAN_MS + JOIN_MS + DHCP_MS);
+    CHECK(cache_is(&access_points[1]));
+
+    // and is the cached one from now on
+    erases = 0;
+    ms = boot("home");
+    CHECK(ms == JOIN_MS);
+    CHECK(erases == 0);
+}
+
+static void test_access_point_moved() {
+    first_boot();
+
+    // found on another channel, slower but without the fallback
+    access_points[0].channel = 3;
+    uint32_t ms = boot("home");
+    printf("    cached access point on another channel: IP after %u ms\n", ms);
+    CHECK(ms == FULL_SCAN_MS + JOIN_MS);
+    CHECK(cache_is(&access_points[0]));
+
+    ms = boot("home");
+    CHECK(ms == JOIN_MS);
+    access_points[0].channel = 6;
+}
+
+static void test_other_network() {
+    first_boot();
+
+    // the cache of another network is not used, nor kept
+    uint32_t ms = boot("neighbour");
+    CHECK(ms == FULL_SCAN_MS + JOIN_MS + DHCP_MS);
+    CHECK(cache_is(&access_points[3]));
+}
+
+static void test_forget() {
+    first_boot();
+
+    wifi_fast_forget();
+    uint32_t ms = boot("home");
+    CHECK(ms == FULL_SCAN_MS + JOIN_MS + DHCP_MS);
+    CHECK(cache_is(&access_points[0]));
+}
+
+static void test_broken_cache() {
+    first_boot();
+
+    // a bit flipped by a power cut in the middle of a write
+    flash[offsetof(wifi_cache_t, channel)] ^= 0x04;
+    uint32_t ms = boot("home");
+    CHECK(ms == FULL_SCAN_MS + JOIN_MS + DHCP_MS);
+    CHECK(cache_is(&access_points[0]));
+}
+
+static void test_too_long() {
+    station_reset();
+    task_function = NULL;
+
+    // 32 characters of SSID and 64 of password do not fit with the zero
+    CHECK(wifi_fast_connect("0123456789abcdef0123456789abcdef", "secret") < 0);
+    CHECK(wifi_fast_connect("home", "0123456789abcdef0123456789abcdef"
+                                    "0123456789abcdef0123456789abcdef") < 0);
+    CHECK(task_function == NULL);
+
+    CHECK(wifi_fast_connect("0123456789abcdef0123456789abcde", "0123456789abcdef0123456789abcdef"
+                                                               "0123456789abcde") == 0);
+    CHECK(task_function != NULL);
+}
+
+
+int main() {
+    RUN(test_first_boot_scans);
+    RUN(test_cached_connect);
+    RUN(test_access_point_gone);
+    RUN(test_access_point_moved);
+    RUN(test_other_network);
+    RUN(test_forget);
+    RUN(test_broken_cache);
+    RUN(test_too_long);
+
+    return test_result();
+}